@@ -1,25 +1,177 @@
 #ifndef BUS_H
 #define BUS_H
 
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include "heat.h"
 
 
 class Memory;
+class Page_Pool;
+class Rom_Image;
 
+/*
+    the 64kb address space is split into 256 pages of 256 bytes
+    each page points straight at the memory backing it, pages with a trap flag set
+    go through the slow path instead so untouched pages cost nothing
+
+    a shared bus maps a rom image other buses are also using and starts every ram page out on one
+    zero page, a page is copied out of the pool the first time it's written
+*/
 class Bus
 {
 
 public:
+    static constexpr std::size_t page_size  = 0x100;
+    static constexpr std::size_t page_count = 0x100;
+    static constexpr std::size_t ram_pages  = 0x80; // $0000 - $7FFF, rom above
+
+    enum class Access : std::uint8_t
+    {
+        read,
+        write,
+    };
+
+    enum Page_Flag : std::uint8_t
+    {
+        writable   = 1 << 0,
+        watch_read  = 1 << 1,
+        watch_write = 1 << 2,
+        count_read  = 1 << 3,
+        count_write = 1 << 4,
+        copy_on_write = 1 << 5,
+    };
+
+    static constexpr std::uint8_t read_traps  = watch_read | count_read;
+    static constexpr std::uint8_t write_traps = watch_write | count_write;
+
+    /* called on the cpu thread for accesses to trapped pages, for reads old_value == new_value */
+    using trap_cb = std::function <void(const Access, const std::uint16_t address, const std::uint8_t old_value, const std::uint8_t new_value)>;
+
     Bus (Memory& _rom, Memory& _ram);
     ~Bus ();
 
-    void write (const std::uint16_t address, const std::uint8_t data);
-    std::uint8_t   read  (const std::uint16_t address);
+    void write (const std::uint16_t address, const std::uint8_t data)
+    {
+        Page& page = pages[address >> 8];
+        if ((page.flags.load(std::memory_order_relaxed) & (writable | write_traps)) == writable)
+        {
+            page.data.load(std::memory_order_relaxed)[address & 0xFF] = data;
+            // only the cpu thread writes through here so this doesn't need a locked add
+            page.generation.store(page.generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+        else
+            write_slow (address, data);
+    }
+
+    std::uint8_t read (const std::uint16_t address)
+    {
+        const Page& page = pages[address >> 8];
+        if (!(page.flags.load(std::memory_order_relaxed) & read_traps))
+            return page.data.load(std::memory_order_relaxed)[address & 0xFF];
+        return read_slow (address);
+    }
+
+    /* read without side effects or traps, for the debugger */
+    std::uint8_t peek (const std::uint16_t address) const;
+
+    /* write without traps, also reaches rom, for the debugger and editors */
+    void poke (const std::uint16_t address, const std::uint8_t data);
+
+    /* the 256 bytes currently mapped at a page, open bus pages read as zero */
+    std::span <const std::uint8_t> page_data (const std::uint8_t page) const;
+
+    /* replace a whole page at once with a single generation bump, for restoring states. false if nothing backs it */
+    bool load_page (const std::uint8_t page, std::span <const std::uint8_t, page_size> data);
+
+    /* bumped on every write to a page, lets readers skip pages that haven't changed */
+    std::uint32_t generation (const std::uint8_t page) const {return pages[page].generation.load(std::memory_order_acquire);}
+
+    /*
+        switch to a shared rom image, no image leaves rom as open bus. ram comes from pool from now on
+        and the rom and ram the bus was made with are never mapped again
+    */
+    void map_shared (std::shared_ptr <const Rom_Image> _image, std::shared_ptr <Page_Pool> _pool);
+
+    /*
+        make this bus a copy of a shared parent: same image, bank and page generations, and the parent's
+        ram pages held by both until either side writes one. runs on the parent's cpu thread, after that
+        the two buses have nothing to do with each other and can run on different threads
+    */
+    void fork_from (Bus& parent);
+
+    bool shared () const {return pool != nullptr;}
+    const std::shared_ptr <Page_Pool>& page_pool () const {return pool;}
+
+    /* ram pages a shared bus holds from the pool, forks may be holding some of them too */
+    std::size_t private_pages () const;
+
+    /*
+        rebuild the page table, needs calling whenever rom or ram is reloaded
+        on a shared bus every private page goes back to the pool and ram reads as zero again
+        roms up to 32kb sit at $8000, bigger ones are split into 16kb banks with the selected bank
+        at $8000 - $BFFF and the last bank fixed at $C000 - $FFFF, any write to rom selects a bank
+    */
+    void map ();
+
+    static constexpr std::size_t bank_size = 0x4000;
+
+    std::size_t bank_count () const {return banks;}
+    std::size_t bank () const {return current_bank.load(std::memory_order_relaxed);}
+    void select_bank (const std::size_t bank);
+
+    void set_trap (const std::uint8_t page, const Page_Flag flag, const bool value);
+    void set_trap_handler (trap_cb handler);
+
+    /* access counting for the heatmap, while off no page is trapped for it so it costs nothing, the map is made on first use */
+    void set_heat (const bool enabled);
+    bool heat_enabled () const {return counting.load(std::memory_order_relaxed);}
+    Heat_Map& heat ();
+
+    /* the bus can't tell an opcode fetch from any other read so the cpu loop reports them */
+    void count_execute (const std::uint16_t address)
+    {
+        if (counting.load(std::memory_order_acquire))
+            heat_map->touch (Heat_Map::Kind::execute, address);
+    }
 
 private:
+    struct Page
+    {
+        std::atomic <std::uint8_t*> data; // only changes on map and bank switches
+        std::atomic <std::uint8_t> flags;
+        std::atomic <std::uint32_t> generation;
+    };
+
     Memory& rom;
     Memory& ram;
+
+    std::array <Page, page_count> pages;
+    trap_cb trap_handler;
+    std::unique_ptr <Heat_Map> heat_map;
+    std::atomic <bool> counting;
+    std::size_t banks;
+    std::atomic <std::size_t> current_bank;
+
+    std::shared_ptr <const Rom_Image> image;
+    std::shared_ptr <Page_Pool> pool;
+    std::array <std::uint8_t*, ram_pages> owned; // references into pool, null while a page is still the zero page
+
+    std::span <const std::uint8_t> rom_contents ();
+    void map_rom_page (const std::size_t page);
+
+    /* null for pages that can't be written, a shared page gets copied first */
+    std::uint8_t* writable_memory (const std::size_t page);
+    std::uint8_t* own_page (const std::size_t page);
+    void release_pages ();
+
+    std::uint8_t read_slow  (const std::uint16_t address);
+    void         write_slow (const std::uint16_t address, const std::uint8_t data);
 };
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,65 @@
+#ifndef HEAT_H
+#define HEAT_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/*
+    per address read / write / execute counters for the heatmap
+    counters saturate instead of wrapping and decay() fades them so the map shows recent traffic,
+    the cpu thread bumps them and the gui thread decays and reads them, relaxed atomics are enough for that
+*/
+class Heat_Map
+{
+public:
+    enum class Kind : std::uint8_t
+    {
+        read,
+        write,
+        execute,
+    };
+
+    static constexpr std::size_t size = 0x10000;
+
+    void touch (const Kind kind, const std::uint16_t address)
+    {
+        auto& counter = counters[static_cast <std::size_t> (kind)][address];
+        const std::uint16_t value = counter.load(std::memory_order_relaxed);
+        if (value != UINT16_MAX)
+            counter.store(value + 1, std::memory_order_relaxed);
+    }
+
+    std::uint16_t get (const Kind kind, const std::uint16_t address) const
+    {
+        return counters[static_cast <std::size_t> (kind)][address].load(std::memory_order_relaxed);
+    }
+
+    /* takes 1 / 2^shift off every counter, rounding up so they always reach 0 */
+    void decay (const unsigned shift)
+    {
+        for (auto& kind : counters)
+        {
+            for (auto& counter : kind)
+            {
+                const std::uint16_t value = counter.load(std::memory_order_relaxed);
+                if (value != 0)
+                    counter.store(value - ((value + (1u << shift) - 1) >> shift), std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void clear ()
+    {
+        for (auto& kind : counters)
+        {
+            for (auto& counter : kind)
+                counter.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    std::array <std::array <std::atomic <std::uint16_t>, size>, 3> counters {};
+};
+
+#endif
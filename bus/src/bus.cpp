@@ -1,30 +1,293 @@
 #include "bus.h"
 #include "mem.h"
+#include "page_pool.h"
+#include "rom_image.h"
+#include <algorithm>
+#include <cstring>
 
 
-// static constexpr std::size_t rom_size = UINT16_MAX / 2;
-static constexpr std::size_t ram_size = UINT16_MAX / 2;
+namespace
+{
+    // backs pages that have nothing mapped, reads as 0 and ignores writes
+    std::array <std::uint8_t, Bus::page_size> open_bus {};
+
+    // where every ram page of a shared bus starts, copy_on_write keeps writes away from it
+    const std::array <std::uint8_t, Bus::page_size> zero_page {};
+}
 
 Bus::Bus (Memory& _rom, Memory& _ram)
 : rom {_rom}
 , ram {_ram}
+, pages {}
+, trap_handler {}
+, heat_map {}
+, counting {false}
+, banks {1}
+, current_bank {0}
+, image {}
+, pool {}
+, owned {}
 {
+    map ();
 }
 
 Bus::~Bus ()
 {
+    release_pages ();
+}
+
+void Bus::map_shared (std::shared_ptr <const Rom_Image> _image, std::shared_ptr <Page_Pool> _pool)
+{
+    // the pages go back to the pool they came from
+    release_pages ();
+    image = std::move (_image);
+    pool = std::move (_pool);
+    map ();
+}
+
+void Bus::fork_from (Bus& parent)
+{
+    release_pages ();
+    image = parent.image;
+    pool = parent.pool;
+    banks = parent.banks;
+    current_bank.store(parent.bank (), std::memory_order_relaxed);
+
+    for (std::size_t i = 0; i < page_count; ++i)
+    {
+        if (i >= ram_pages)
+            map_rom_page (i);
+        else
+        {
+            // the parent stops writing its pages in place too, whoever writes first makes the copy
+            std::uint8_t* const page = parent.owned[i];
+            if (page != nullptr)
+            {
+                pool->share (page);
+                parent.pages[i].flags.fetch_and(~writable, std::memory_order_relaxed);
+                parent.pages[i].flags.fetch_or(copy_on_write, std::memory_order_relaxed);
+            }
+            owned[i] = page;
+            pages[i].data.store(page != nullptr ? page : const_cast <std::uint8_t*> (zero_page.data()), std::memory_order_relaxed);
+            pages[i].flags.store((pages[i].flags.load(std::memory_order_relaxed) & ~writable) | copy_on_write, std::memory_order_relaxed);
+        }
+        pages[i].generation.store(parent.generation (i), std::memory_order_release);
+    }
+}
+
+std::size_t Bus::private_pages () const
+{
+    return std::ranges::count_if (owned, [] (const std::uint8_t* page) {return page != nullptr;});
+}
+
+std::span <const std::uint8_t> Bus::rom_contents ()
+{
+    if (pool)
+        return image ? image->bytes () : std::span <const std::uint8_t> {};
+    return {rom.data(), rom.size()};
+}
+
+void Bus::map ()
+{
+    const std::size_t rom_size = rom_contents ().size();
+    banks = rom_size > (page_count - ram_pages) * page_size ? (rom_size + bank_size - 1) / bank_size : 1;
+    current_bank.store(0, std::memory_order_relaxed);
+    release_pages ();
+
+    for (std::size_t i = 0; i < page_count; ++i)
+    {
+        if (i >= ram_pages)
+        {
+            map_rom_page (i);
+            continue;
+        }
+
+        const std::size_t offset = i * page_size;
+        std::uint8_t flags = pages[i].flags.load(std::memory_order_relaxed) & ~(writable | copy_on_write);
+        std::uint8_t* memory = open_bus.data();
+        if (pool)
+        {
+            memory = const_cast <std::uint8_t*> (zero_page.data());
+            flags |= copy_on_write;
+        }
+        else if (offset + page_size <= ram.size())
+        {
+            memory = ram.data() + offset;
+            flags |= writable;
+        }
+
+        pages[i].data.store(memory, std::memory_order_relaxed);
+        pages[i].flags.store(flags, std::memory_order_relaxed);
+        // remapping happens on the thread that owns the cpu, like write, so no locked add
+        pages[i].generation.store(pages[i].generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+}
+
+void Bus::map_rom_page (const std::size_t page)
+{
+    static constexpr std::size_t pages_per_bank = bank_size / page_size;
+    static constexpr std::size_t fixed_page     = ram_pages + pages_per_bank;
+
+    std::size_t offset = (page - ram_pages) * page_size;
+    if (banks > 1)
+    {
+        const std::size_t bank = page < fixed_page ? current_bank.load(std::memory_order_relaxed) : banks - 1;
+        offset = bank * bank_size + ((page - ram_pages) % pages_per_bank) * page_size;
+    }
+    const auto contents = rom_contents ();
+    const bool backed = offset + page_size <= contents.size();
+
+    // rom pages are never writable so a shared image is only ever read through here
+    pages[page].data.store(backed ? const_cast <std::uint8_t*> (contents.data()) + offset : open_bus.data(), std::memory_order_relaxed);
+    pages[page].flags.fetch_and(~writable, std::memory_order_relaxed);
+    pages[page].generation.store(pages[page].generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void Bus::select_bank (const std::size_t bank)
+{
+    if (banks <= 1)
+        return;
+    current_bank.store(bank % banks, std::memory_order_relaxed);
+    for (std::size_t i = ram_pages; i < ram_pages + bank_size / page_size; ++i)
+        map_rom_page (i);
+}
+
+std::uint8_t Bus::peek (const std::uint16_t address) const
+{
+    return pages[address >> 8].data.load(std::memory_order_relaxed)[address & 0xFF];
 }
 
-void Bus::write (const std::uint16_t address, const std::uint8_t data)
+void Bus::poke (const std::uint16_t address, const std::uint8_t data)
 {
-    if (address > ram_size)
+    std::uint8_t* const memory = writable_memory (address >> 8);
+    if (memory == nullptr)
         return;
-    ram.write (address, data);
+    memory[address & 0xFF] = data;
+    pages[address >> 8].generation.fetch_add(1, std::memory_order_release);
 }
 
-std::uint8_t Bus::read  (const std::uint16_t address)
+std::span <const std::uint8_t> Bus::page_data (const std::uint8_t page) const
 {
-    if (address > ram_size)
-        return rom.read(0x7FFF & address);
-    return ram.read(address);
+    return {pages[page].data.load(std::memory_order_relaxed), page_size};
+}
+
+bool Bus::load_page (const std::uint8_t page, std::span <const std::uint8_t, page_size> data)
+{
+    std::uint8_t* const memory = writable_memory (page);
+    if (memory == nullptr)
+        return false;
+    std::memcpy (memory, data.data(), page_size);
+    pages[page].generation.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void Bus::set_trap (const std::uint8_t page, const Page_Flag flag, const bool value)
+{
+    if (value)
+        pages[page].flags.fetch_or(flag, std::memory_order_relaxed);
+    else
+        pages[page].flags.fetch_and(~flag, std::memory_order_relaxed);
+}
+
+void Bus::set_trap_handler (trap_cb handler)
+{
+    trap_handler = std::move (handler);
+}
+
+std::uint8_t* Bus::writable_memory (const std::size_t page)
+{
+    if (pages[page].flags.load(std::memory_order_relaxed) & copy_on_write)
+        return own_page (page);
+    std::uint8_t* const memory = pages[page].data.load(std::memory_order_relaxed);
+    // other buses may be reading a shared rom
+    if (memory == open_bus.data() || (pool && page >= ram_pages))
+        return nullptr;
+    return memory;
+}
+
+std::uint8_t* Bus::own_page (const std::size_t page)
+{
+    // a page the forks have all let go of is just taken back, otherwise the copy has the same
+    // contents at a new address so the generation stays where it is
+    std::uint8_t* memory = owned[page];
+    if (memory == nullptr || !pool->unique (memory))
+    {
+        memory = pool->allocate ();
+        std::memcpy (memory, pages[page].data.load(std::memory_order_relaxed), page_size);
+        if (owned[page] != nullptr)
+            pool->release (owned[page]);
+        owned[page] = memory;
+        pages[page].data.store(memory, std::memory_order_relaxed);
+    }
+    pages[page].flags.fetch_and(~copy_on_write, std::memory_order_relaxed);
+    pages[page].flags.fetch_or(writable, std::memory_order_relaxed);
+    return memory;
+}
+
+void Bus::release_pages ()
+{
+    for (auto& page : owned)
+    {
+        if (page != nullptr)
+            pool->release (page);
+        page = nullptr;
+    }
+}
+
+Heat_Map& Bus::heat ()
+{
+    // only made from the thread that turns counting on, the release store of counting in set_heat hands it to
+    // the cpu thread, which only touches it after seeing counting set with acquire
+    if (!heat_map)
+        heat_map = std::make_unique <Heat_Map> ();
+    return *heat_map;
+}
+
+void Bus::set_heat (const bool enabled)
+{
+    if (enabled)
+        heat ();
+    counting.store(enabled, std::memory_order_release);
+    for (std::size_t i = 0; i < page_count; ++i)
+    {
+        set_trap (i, count_read, enabled);
+        set_trap (i, count_write, enabled);
+    }
+}
+
+std::uint8_t Bus::read_slow (const std::uint16_t address)
+{
+    const Page& page = pages[address >> 8];
+    const std::uint8_t value = page.data.load(std::memory_order_relaxed)[address & 0xFF];
+    const std::uint8_t flags = page.flags.load(std::memory_order_relaxed);
+    if ((flags & count_read) && counting.load(std::memory_order_acquire))
+        heat_map->touch (Heat_Map::Kind::read, address);
+    if ((flags & watch_read) && trap_handler)
+        trap_handler (Access::read, address, value, value);
+    return value;
+}
+
+void Bus::write_slow (const std::uint16_t address, const std::uint8_t data)
+{
+    Page& page = pages[address >> 8];
+    if (page.flags.load(std::memory_order_relaxed) & copy_on_write)
+        own_page (address >> 8);
+
+    const std::uint8_t flags = page.flags.load(std::memory_order_relaxed);
+    std::uint8_t* const memory = page.data.load(std::memory_order_relaxed);
+    const std::uint8_t old_value = memory[address & 0xFF];
+
+    if ((flags & count_write) && counting.load(std::memory_order_acquire))
+        heat_map->touch (Heat_Map::Kind::write, address);
+
+    if (flags & writable)
+    {
+        memory[address & 0xFF] = data;
+        page.generation.fetch_add(1, std::memory_order_release);
+    }
+    else if (banks > 1 && (address >> 8) >= ram_pages)
+        select_bank (data);
+
+    if ((flags & watch_write) && trap_handler)
+        trap_handler (Access::write, address, old_value, (flags & writable) ? data : old_value);
 }
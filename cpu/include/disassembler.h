@@ -0,0 +1,128 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include "mos6502.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace MOS_6502
+{
+    /*
+        flow following disassembler
+
+        starts at the reset / nmi / irq vectors and follows jumps, calls and branches,
+        anything never reached is listed as data instead of being decoded as garbage.
+        runs on a worker thread and publishes the listing as it goes so the code window
+        has something to show straight away
+    */
+    class Disassembler
+    {
+    public:
+        enum class Kind : byte
+        {
+            unknown,
+            code,       // first byte of an instruction
+            operand,    // rest of an instruction
+        };
+
+        struct Listing
+        {
+            std::vector <line_type> lines; // address order
+            code_map_type map;
+            bool complete;
+        };
+
+        /* everything the flow worked out, enough to pick up again later without a fresh pass */
+        struct Analysis
+        {
+            std::span <const byte> memory;          // the bytes it was worked out from, 64kb
+            std::span <const Kind> kinds;           // 64kb
+            std::span <const std::uint64_t> targets; // bitmap of addresses jumped, called or branched to
+            std::span <const line_type> lines;      // one per instruction, any order
+            word data_begin;
+            word data_end;
+        };
+
+        Disassembler ();
+        ~Disassembler ();
+
+        Disassembler (const Disassembler&) = delete;
+        Disassembler& operator= (const Disassembler&) = delete;
+
+        /* snapshots memory through peek on the calling thread, then disassembles in the background */
+        void start (const CPU::read_cb& peek);
+        void stop ();
+
+        using generation_cb = std::function <std::uint32_t(const byte page)>;
+
+        /*
+            re-derives the listing around bytes that changed in pages whose write generation moved,
+            runs on the calling thread and does nothing while the first pass is still going.
+            returns true when a new listing was published
+        */
+        bool refresh (const CPU::read_cb& peek, const generation_cb& generation);
+
+        /* follows code from an address the cpu reached that the flow never found, e.g. code loaded into ram */
+        void add_entry (const word address);
+
+        /* lines is filled with the instructions and referenced by the result, nothing while the first pass is running */
+        std::optional <Analysis> analysis (std::vector <line_type>& lines) const;
+
+        /*
+            stops any pass and takes over a saved analysis, bytes that differ from what peek sees now are
+            re-disassembled the same way refresh does it. false if the analysis is the wrong shape
+        */
+        bool restore (const Analysis& analysis, const CPU::read_cb& peek, const generation_cb& generation);
+
+        /* data rows are only listed for this range, code is listed wherever it is found */
+        void set_data_range (const word begin, const word end);
+
+        std::shared_ptr <const Listing> listing () const;
+
+        /* bumped every time a new listing is published */
+        std::uint32_t version () const {return published_version.load(std::memory_order_acquire);}
+
+    private:
+        static constexpr std::size_t publish_interval = 1024; // instructions
+
+        std::array <byte, 0x10000>      memory;
+        std::array <Kind, 0x10000>      kinds;
+        std::vector <line_type>         decoded; // indexed by address, valid where kinds is code
+        std::vector <word>              work;
+
+        word data_begin;
+        word data_end;
+
+        std::array <std::uint64_t, 0x400> targets; // bitmap of addresses something jumps, calls or branches to
+        std::array <std::uint32_t, 0x100> seen_generation;
+
+        std::thread worker;
+        std::atomic <bool> stopping;
+        std::atomic <bool> running;
+
+        mutable std::mutex mu;
+        std::shared_ptr <const Listing> published;
+        std::atomic <std::uint32_t> published_version;
+
+        void run ();
+        void drain (std::size_t& count);
+        void target (const word address);
+        bool place (const line_type& line);
+        void follow (word address, std::size_t& count);
+        void erase (const word address);
+        void resync (word address, const word end);
+        bool redecode (const word begin, const word end);
+        bool diff_page (const std::size_t page, const CPU::read_cb& peek);
+        bool is_target (const word address) const {return targets[address >> 6] & (std::uint64_t {1} << (address & 63));}
+        void publish (const bool complete);
+        word vector_at (const word address) const;
+    };
+}
+
+#endif
@@ -1,12 +1,14 @@
 #ifndef MOS_6502_H
 #define MOS_6502_H
 
+#include "mos6502_types.h"
 #include <array>
 #include <cstdint>
 #include <functional>
 #include <span>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 
 /*
@@ -30,51 +32,8 @@ SP	stack pointer	(8 bit)
 namespace MOS_6502
 {
 
-    using byte = std::uint8_t;
-    using word = std::uint16_t;
-
-    static constexpr word stk_begin         = 0x0100;
-    static constexpr word nmi_vector_low    = 0xFFFA;
-    static constexpr word nmi_vector_high   = 0xFFFB;
-    static constexpr word reset_vector_low  = 0xFFFC;
-    static constexpr word reset_vector_high = 0xFFFD;
-    static constexpr word irq_vector_low    = 0xFFFE;
-    static constexpr word irq_vector_high   = 0xFFFF;
-
-    enum class Mnemonic
-    {
-        BRK, ORA, ASL, PHP, BPL,
-        CLC, JSR, AND, BIT, ROL, 
-        PLP, BMI, SEC, RTI, EOR,
-        LSR, PHA, JMP, BVC, CLI,
-        RTS, PLA, ADC, ROR, BVS,
-        SEI, STA, STY, STX, DEY,
-        TXA, BCC, TYA, TXS, LDY, 
-        LDA, LDX, TAY, TAX, BCS, 
-        CLV, TSX, CPY, CMP, DEC, 
-        INY, DEX, BNE, CLD, CPX, 
-        SBC, INC, INX, NOP, BEQ, 
-        SED, ___,
-    };
-
-    enum class Mode
-    {
-        ACC,ABS,ABX,ABY,IMM,IMP,IND,XIZ,YIZ,REL,ZPG,ZPX,ZPY,
-    };
-
-    enum class Flag: byte
-    {
-        N = 1 << 7, // negative
-        V = 1 << 6, // overflow
-        _ = 1 << 5, // ignored / unused
-        B = 1 << 4, // break
-        D = 1 << 3, // decimal
-        I = 1 << 2, // interrupt (IRQ dissabl)
-        Z = 1 << 1, // zero
-        C = 1 << 0, // carry
-    };
-
     class CPU;
+
     struct Instruction
     {
         Mnemonic mnemonic;
@@ -230,6 +189,11 @@ namespace MOS_6502
         byte get_SR () const;
         byte get_SP () const;
         const Current& get_current () const;
+
+        Registers get_registers () const;
+        /* also drops the decoded instruction, the next update starts fresh at PC */
+        void set_registers (const Registers& registers);
+
         static const std::array<Instruction, 256>& get_instruction_table ();
     };
 }
@@ -239,14 +203,56 @@ namespace MOS_6502
 
 namespace MOS_6502
 {
-    using line_type     = std::tuple<std::uint16_t, std::string, bool>;
+    enum class Line_Flag : byte
+    {
+        illegal = 1 << 0,
+        data    = 1 << 1, // up to 3 raw bytes held in opcode and operand
+    };
+
+    /* one disassembled instruction, text is only produced by format_line */
+    struct Line
+    {
+        word address;
+        word operand;
+        byte opcode;
+        byte length;
+        byte flags;
+
+        bool has (Line_Flag flag) const {return flags & static_cast <byte> (flag);}
+        void toggle (Line_Flag flag) {flags ^= static_cast <byte> (flag);}
+    };
+
+    /* big enough for the longest line e.g. "FFFF: FF FF FF .byte $FF,$FF,$FF" */
+    static constexpr std::size_t line_text_size = 40;
+    using line_text = std::array<char, line_text_size>;
+
+    using line_type     = Line;
     using trace_type    = std::vector<std::vector<std::string>>;
-    using code_map_type = std::unordered_map <std::size_t, const line_type&>;
 
-    std::vector <line_type> disassemble (const std::span<std::uint8_t>& rom, std::uint16_t offset = 0);
-    std::uint16_t           disassemble_line (line_type& result, const std::span<std::uint8_t>& rom, std::uint16_t rom_index);
+    /* dense address -> line lookup over the whole 64K address space */
+    struct Code_Map
+    {
+        static constexpr std::uint32_t no_line = UINT32_MAX;
+
+        std::span<const line_type>  lines;
+        std::vector<std::uint32_t>  index;
+
+        const line_type* find (word address) const
+        {
+            if (index.empty() || index[address] == no_line)
+                return nullptr;
+            return &lines[index[address]];
+        }
+    };
+
+    using code_map_type = Code_Map;
+
+    std::vector <line_type> disassemble (const std::span<const std::uint8_t>& rom, std::uint16_t offset = 0, std::uint16_t base = 0);
+    std::size_t             disassemble (std::span<line_type> result, const std::span<const std::uint8_t>& rom, std::uint16_t offset = 0, std::uint16_t base = 0);
+    std::uint16_t           disassemble_line (line_type& result, const std::span<const std::uint8_t>& rom, std::uint16_t rom_index, std::uint16_t base = 0);
+    std::size_t             format_line (char* buffer, std::size_t size, const line_type& line);
     code_map_type           code_mapper (const std::vector<line_type>& code);
-    bool                    trace (trace_type& traces, const code_map_type& map, const MOS_6502::CPU &  cpu);
+    bool                    trace (trace_type& traces, const code_map_type& map, const MOS_6502::CPU &  cpu, const CPU::read_cb& peek);
 }
 
 #endif
\ No newline at end of file
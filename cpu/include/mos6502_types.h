@@ -0,0 +1,71 @@
+#ifndef MOS_6502_TYPES_H
+#define MOS_6502_TYPES_H
+
+#include <cstdint>
+
+/*
+    the plain types of mos6502.h, for code that mustn't pull in the cpu class and the standard library
+    templates that come with it (the batch kernels are built once per instruction set)
+*/
+namespace MOS_6502
+{
+
+    using byte = std::uint8_t;
+    using word = std::uint16_t;
+
+    static constexpr word stk_begin         = 0x0100;
+    static constexpr word nmi_vector_low    = 0xFFFA;
+    static constexpr word nmi_vector_high   = 0xFFFB;
+    static constexpr word reset_vector_low  = 0xFFFC;
+    static constexpr word reset_vector_high = 0xFFFD;
+    static constexpr word irq_vector_low    = 0xFFFE;
+    static constexpr word irq_vector_high   = 0xFFFF;
+
+    enum class Mnemonic
+    {
+        BRK, ORA, ASL, PHP, BPL,
+        CLC, JSR, AND, BIT, ROL, 
+        PLP, BMI, SEC, RTI, EOR,
+        LSR, PHA, JMP, BVC, CLI,
+        RTS, PLA, ADC, ROR, BVS,
+        SEI, STA, STY, STX, DEY,
+        TXA, BCC, TYA, TXS, LDY, 
+        LDA, LDX, TAY, TAX, BCS, 
+        CLV, TSX, CPY, CMP, DEC, 
+        INY, DEX, BNE, CLD, CPX, 
+        SBC, INC, INX, NOP, BEQ, 
+        SED, ___,
+    };
+
+    enum class Mode
+    {
+        ACC,ABS,ABX,ABY,IMM,IMP,IND,XIZ,YIZ,REL,ZPG,ZPX,ZPY,
+    };
+
+    enum class Flag: byte
+    {
+        N = 1 << 7, // negative
+        V = 1 << 6, // overflow
+        _ = 1 << 5, // ignored / unused
+        B = 1 << 4, // break
+        D = 1 << 3, // decimal
+        I = 1 << 2, // interrupt (IRQ dissabl)
+        Z = 1 << 1, // zero
+        C = 1 << 0, // carry
+    };
+
+    /* the programmer visible state, what a save state or undo entry needs to put the cpu back */
+    struct Registers
+    {
+        word PC;
+        byte AC;
+        byte XR;
+        byte YR;
+        byte SR;
+        byte SP;
+
+        bool operator == (const Registers&) const = default;
+    };
+}
+
+#endif
@@ -0,0 +1,403 @@
+#include "disassembler.h"
+#include <algorithm>
+#include <optional>
+
+MOS_6502::Disassembler::Disassembler ()
+: memory {}
+, kinds {}
+, decoded (0x10000)
+, work {}
+, data_begin {0x8000}
+, data_end {0xFFFF}
+, targets {}
+, seen_generation {}
+, worker {}
+, stopping {false}
+, running {false}
+, published {std::make_shared <Listing> ()}
+, published_version {0}
+{
+}
+
+MOS_6502::Disassembler::~Disassembler ()
+{
+    stop ();
+}
+
+void MOS_6502::Disassembler::start (const CPU::read_cb& peek)
+{
+    stop ();
+
+    for (std::size_t address = 0; address < memory.size(); ++address)
+        memory[address] = peek (address);
+    kinds.fill (Kind::unknown);
+    targets.fill (0);
+
+    work.clear ();
+    target (vector_at (irq_vector_low));
+    target (vector_at (nmi_vector_low));
+    target (vector_at (reset_vector_low));
+
+    running = true;
+    worker = std::thread (&Disassembler::run, this);
+}
+
+void MOS_6502::Disassembler::stop ()
+{
+    stopping = true;
+    if (worker.joinable())
+        worker.join ();
+    stopping = false;
+    running = false;
+}
+
+void MOS_6502::Disassembler::set_data_range (const word begin, const word end)
+{
+    data_begin = begin;
+    data_end   = end;
+}
+
+std::shared_ptr <const MOS_6502::Disassembler::Listing> MOS_6502::Disassembler::listing () const
+{
+    std::lock_guard lock (mu);
+    return published;
+}
+
+MOS_6502::word MOS_6502::Disassembler::vector_at (const word address) const
+{
+    return (memory[static_cast <word> (address + 1)] << 8) | memory[address];
+}
+
+void MOS_6502::Disassembler::run ()
+{
+    // everything shows up as data until the flow reaches it
+    publish (false);
+
+    std::size_t count = 0;
+    drain (count);
+
+    if (!stopping)
+        publish (true);
+    running = false;
+}
+
+void MOS_6502::Disassembler::drain (std::size_t& count)
+{
+    while (!work.empty() && !stopping)
+    {
+        const word address = work.back();
+        work.pop_back ();
+        follow (address, count);
+    }
+}
+
+void MOS_6502::Disassembler::target (const word address)
+{
+    targets[address >> 6] |= std::uint64_t {1} << (address & 63);
+    work.push_back (address);
+}
+
+bool MOS_6502::Disassembler::place (const line_type& line)
+{
+    const word address = line.address;
+    kinds[address] = Kind::code;
+    for (std::size_t i = 1; i < line.length; ++i)
+        kinds[address + i] = Kind::operand;
+    decoded[address] = line;
+
+    const auto& ins = CPU::instruction_table[line.opcode];
+    switch (ins.mnemonic)
+    {
+        case Mnemonic::JMP:
+            if (ins.addr_mode == Mode::ABS)
+                target (line.operand);
+            // only follow an indirect jump when the pointer lives in rom and can't change
+            else if (line.operand >= 0x8000)
+                target (vector_at (line.operand));
+            return false;
+        case Mnemonic::JSR:
+            target (line.operand);
+            return true;
+        case Mnemonic::RTS:
+        case Mnemonic::RTI:
+        case Mnemonic::BRK:
+            return false;
+        default:
+            if (ins.addr_mode == Mode::REL)
+                target (address + 2 + static_cast <std::int8_t> (line.operand));
+            return true;
+    }
+}
+
+void MOS_6502::Disassembler::follow (word address, std::size_t& count)
+{
+    while (!stopping && kinds[address] == Kind::unknown)
+    {
+        line_type line;
+        disassemble_line (line, memory, address);
+
+        // illegal opcodes and instructions that overlap known code end this path
+        if (line.has(Line_Flag::illegal) || address + line.length > memory.size())
+            return;
+        for (std::size_t i = 1; i < line.length; ++i)
+        {
+            if (kinds[address + i] != Kind::unknown)
+                return;
+        }
+
+        const bool next = place (line);
+
+        if (running && ++count % publish_interval == 0)
+            publish (false);
+
+        if (!next)
+            return;
+        address += line.length;
+    }
+}
+
+void MOS_6502::Disassembler::erase (const word address)
+{
+    word begin = address;
+    for (int i = 0; i < 2 && kinds[begin] == Kind::operand; ++i)
+        --begin;
+
+    if (kinds[begin] != Kind::code)
+    {
+        kinds[address] = Kind::unknown;
+        return;
+    }
+    for (std::size_t i = 0; i < decoded[begin].length; ++i)
+        kinds[static_cast <word> (begin + i)] = Kind::unknown;
+}
+
+void MOS_6502::Disassembler::resync (word address, const word end)
+{
+    // decode over the top of whatever was there until the boundaries line up with the old decoding again
+    for (std::size_t steps = 0; steps < memory.size(); ++steps)
+    {
+        if (address > end && kinds[address] == Kind::code)
+            return;
+
+        line_type line;
+        disassemble_line (line, memory, address);
+        if (line.has(Line_Flag::illegal) || address + line.length > memory.size())
+            return;
+
+        for (std::size_t i = 0; i < line.length; ++i)
+        {
+            if (kinds[address + i] != Kind::unknown)
+                erase (address + i);
+        }
+
+        if (!place (line))
+            return;
+        address += line.length;
+    }
+}
+
+bool MOS_6502::Disassembler::redecode (const word begin, const word end)
+{
+    bool changed = false;
+
+    // raw bytes are on show in the data range
+    for (std::size_t address = std::max (begin, data_begin); address <= std::min (end, data_end); ++address)
+    {
+        if (kinds[address] == Kind::unknown)
+        {
+            changed = true;
+            break;
+        }
+    }
+
+    // back up to the instruction that covers the first changed byte
+    word start = begin;
+    for (int i = 0; i < 2 && start > 0 && kinds[start] == Kind::operand; ++i)
+        --start;
+
+    std::optional <word> first_code;
+    for (std::size_t address = start; address <= end; ++address)
+    {
+        if (kinds[address] == Kind::code)
+        {
+            first_code = address;
+            break;
+        }
+    }
+    if (!first_code)
+        return changed;
+
+    for (std::size_t address = *first_code; address <= end; ++address)
+    {
+        if (kinds[address] != Kind::unknown)
+            erase (address);
+    }
+
+    resync (*first_code, end);
+
+    // anything else that jumped into the changed bytes gets followed again
+    for (std::size_t address = *first_code; address <= end; ++address)
+    {
+        if (is_target (address) && kinds[address] == Kind::unknown)
+            work.push_back (address);
+    }
+    return true;
+}
+
+bool MOS_6502::Disassembler::diff_page (const std::size_t page, const CPU::read_cb& peek)
+{
+    // a write of the same value or to a page with no code costs a compare and nothing else
+    bool changed = false;
+    const word base = page << 8;
+    std::optional <word> run_begin;
+    for (std::size_t i = 0; i <= 0x100; ++i)
+    {
+        const word address = base + i;
+        const bool differs = i < 0x100 && peek (address) != memory[address];
+        if (differs)
+        {
+            memory[address] = peek (address);
+            if (!run_begin)
+                run_begin = address;
+        }
+        else if (run_begin)
+        {
+            changed |= redecode (*run_begin, address - 1);
+            run_begin.reset ();
+        }
+    }
+    return changed;
+}
+
+bool MOS_6502::Disassembler::refresh (const CPU::read_cb& peek, const generation_cb& generation)
+{
+    if (running)
+        return false;
+
+    bool changed = false;
+    for (std::size_t page = 0; page < seen_generation.size(); ++page)
+    {
+        const std::uint32_t current = generation (page);
+        if (current == seen_generation[page])
+            continue;
+        seen_generation[page] = current;
+        changed |= diff_page (page, peek);
+    }
+
+    if (changed)
+    {
+        std::size_t count = 0;
+        drain (count);
+        publish (true);
+    }
+    return changed;
+}
+
+std::optional <MOS_6502::Disassembler::Analysis> MOS_6502::Disassembler::analysis (std::vector <line_type>& lines) const
+{
+    if (running)
+        return std::nullopt;
+
+    lines.clear ();
+    for (std::size_t address = 0; address < kinds.size(); ++address)
+    {
+        if (kinds[address] == Kind::code)
+            lines.push_back (decoded[address]);
+    }
+    return Analysis {memory, kinds, targets, lines, data_begin, data_end};
+}
+
+bool MOS_6502::Disassembler::restore (const Analysis& analysis, const CPU::read_cb& peek, const generation_cb& generation)
+{
+    if (analysis.memory.size() != memory.size() || analysis.kinds.size() != kinds.size() || analysis.targets.size() != targets.size())
+        return false;
+
+    stop ();
+
+    std::ranges::copy (analysis.memory, memory.begin());
+    std::ranges::copy (analysis.kinds, kinds.begin());
+    std::ranges::copy (analysis.targets, targets.begin());
+    data_begin = analysis.data_begin;
+    data_end   = analysis.data_end;
+
+    // only trust instructions that line up with the kinds they were saved with
+    for (auto& line : decoded)
+        line.length = 0;
+    for (const auto& line : analysis.lines)
+    {
+        if (kinds[line.address] == Kind::code && line.length > 0)
+            decoded[line.address] = line;
+    }
+    for (std::size_t address = 0; address < kinds.size(); ++address)
+    {
+        if (kinds[address] != Kind::code || decoded[address].length != 0)
+            continue;
+        kinds[address] = Kind::unknown;
+        for (std::size_t i = address + 1; i < kinds.size() && kinds[i] == Kind::operand; ++i)
+            kinds[i] = Kind::unknown;
+    }
+
+    work.clear ();
+    for (std::size_t page = 0; page < seen_generation.size(); ++page)
+    {
+        seen_generation[page] = generation (page);
+        diff_page (page, peek);
+    }
+
+    std::size_t count = 0;
+    drain (count);
+    publish (true);
+    return true;
+}
+
+void MOS_6502::Disassembler::add_entry (const word address)
+{
+    if (running || kinds[address] != Kind::unknown)
+        return;
+
+    target (address);
+    std::size_t count = 0;
+    drain (count);
+    publish (true);
+}
+
+void MOS_6502::Disassembler::publish (const bool complete)
+{
+    auto result = std::make_shared <Listing> ();
+    result->complete = complete;
+
+    std::size_t address = 0;
+    while (address < memory.size())
+    {
+        if (kinds[address] == Kind::code)
+        {
+            result->lines.push_back (decoded[address]);
+            address += decoded[address].length;
+            continue;
+        }
+
+        if (address < data_begin || address > data_end)
+        {
+            ++address;
+            continue;
+        }
+
+        // up to 3 bytes of data per row, stopping at the next instruction
+        line_type line {static_cast <word> (address), 0, memory[address], 1, static_cast <byte> (Line_Flag::data)};
+        while (line.length < 3 && address + line.length <= data_end && kinds[address + line.length] == Kind::unknown)
+        {
+            line.operand |= memory[address + line.length] << (8 * (line.length - 1));
+            ++line.length;
+        }
+        result->lines.push_back (line);
+        address += line.length;
+    }
+
+    result->map = code_mapper (result->lines);
+
+    {
+        std::lock_guard lock (mu);
+        published = std::move (result);
+    }
+    published_version.fetch_add (1, std::memory_order_release);
+}
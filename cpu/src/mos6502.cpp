@@ -2,6 +2,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <cstdio>
+#include <algorithm>
 #include <print>
 
 
@@ -806,103 +807,179 @@ MOS_6502::byte MOS_6502::CPU::get_SR () const {return SR;}
 MOS_6502::byte MOS_6502::CPU::get_SP () const {return SP;}
 
 const MOS_6502::Current& MOS_6502::CPU::get_current () const {return current;}
+
+MOS_6502::Registers MOS_6502::CPU::get_registers () const
+{
+    return {PC, AC, XR, YR, SR, SP};
+}
+
+void MOS_6502::CPU::set_registers (const Registers& registers)
+{
+    PC = registers.PC;
+    AC = registers.AC;
+    XR = registers.XR;
+    YR = registers.YR;
+    SR = registers.SR;
+    SP = registers.SP;
+    old_PC = PC;
+    current = {};
+}
 const std::array<MOS_6502::Instruction, 256>& MOS_6502::CPU::get_instruction_table () {return instruction_table;}
 
-std::vector <MOS_6502::line_type> MOS_6502::disassemble (const std::span<std::uint8_t>& rom, std::uint16_t offset)
+std::vector <MOS_6502::line_type> MOS_6502::disassemble (const std::span<const std::uint8_t>& rom, std::uint16_t offset, std::uint16_t base)
+{
+    // every instruction is at least one byte so this is the most lines there can be
+    std::vector <line_type> result (offset < rom.size() ? rom.size() - offset : 0);
+    result.resize (disassemble (result, rom, offset, base));
+    return result;
+}
+
+std::size_t MOS_6502::disassemble (std::span<line_type> result, const std::span<const std::uint8_t>& rom, std::uint16_t offset, std::uint16_t base)
 {
-    std::vector <std::tuple<std::uint16_t, std::string, bool>> result {};
-    std::uint16_t rom_index = offset;
-    while (rom_index < rom.size())
+    std::size_t count = 0;
+    std::size_t rom_index = offset;
+    while (rom_index < rom.size() && count < result.size())
     {
-        line_type line;
-        rom_index = disassemble_line(line, rom, rom_index);
-        result.push_back (std::move(line));
+        disassemble_line (result[count], rom, rom_index, base);
+        rom_index += result[count].length;
+        ++count;
     }
-    return result;
+    return count;
+}
+
+std::uint16_t MOS_6502::disassemble_line (MOS_6502::line_type& result, const std::span<const std::uint8_t>& rom, std::uint16_t rom_index, std::uint16_t base)
+{
+    const std::uint8_t  b0  = rom[rom_index];
+    const std::uint8_t  b1  = rom_index + 1u < rom.size() ? rom[rom_index+1] : 0;
+    const std::uint8_t  b2  = rom_index + 2u < rom.size() ? rom[rom_index+2] : 0;
+    const auto&         ins = MOS_6502::CPU::instruction_table[b0];
+
+    result.address = base + rom_index;
+    result.opcode  = b0;
+    result.flags   = ins.mnemonic == Mnemonic::___ ? static_cast <byte> (Line_Flag::illegal) : 0;
+
+    switch (ins.addr_mode)
+    {
+        case MOS_6502::Mode::IMP:
+        case MOS_6502::Mode::ACC:
+            result.operand = 0;
+            result.length  = 1;
+            break;
+        case MOS_6502::Mode::ABS:
+        case MOS_6502::Mode::ABX:
+        case MOS_6502::Mode::ABY:
+        case MOS_6502::Mode::IND:
+            result.operand = (b2 << 8) | b1;
+            result.length  = 3;
+            break;
+        case MOS_6502::Mode::IMM:
+        case MOS_6502::Mode::XIZ:
+        case MOS_6502::Mode::YIZ:
+        case MOS_6502::Mode::REL:
+        case MOS_6502::Mode::ZPG:
+        case MOS_6502::Mode::ZPX:
+        case MOS_6502::Mode::ZPY:
+            result.operand = b1;
+            result.length  = 2;
+            break;
+    }
+    return rom_index + result.length;
 }
 
-std::uint16_t MOS_6502::disassemble_line (MOS_6502::line_type& result, const std::span<std::uint8_t>& rom, std::uint16_t rom_index)
+std::size_t MOS_6502::format_line (char* buffer, std::size_t size, const line_type& line)
 {
-    const auto&         ins      = MOS_6502::CPU::instruction_table[static_cast<std::size_t>(rom[rom_index])];
-    const std::uint16_t index    = rom_index;
+    const auto&         ins      = MOS_6502::CPU::instruction_table[line.opcode];
     const char*         mnemonic = MOS_6502::mnemonic_map.at(ins.mnemonic);
-    const std::uint8_t  b0       = rom[rom_index];
-    const std::uint8_t  b1       = rom_index + 1 < rom.size() ? rom[rom_index+1] : 0;
-    const std::uint8_t  b2       = rom_index + 2 < rom.size() ? rom[rom_index+2] : 0;
+    const std::uint16_t index    = line.address;
+    const std::uint8_t  b0       = line.opcode;
+    const std::uint8_t  b1       = line.operand & 0xFF;
+    const std::uint8_t  b2       = line.operand >> 8;
+    int written = 0;
+
+    if (line.has(Line_Flag::data))
+    {
+        switch (line.length)
+        {
+            case 1:  written = std::snprintf (buffer, size, "%04X: %02X %9s $%02X", index, b0, ".byte", b0); break;
+            case 2:  written = std::snprintf (buffer, size, "%04X: %02X %02X %6s $%02X,$%02X", index, b0, b1, ".byte", b0, b1); break;
+            default: written = std::snprintf (buffer, size, "%04X: %02X %02X %02X %s $%02X,$%02X,$%02X", index, b0, b1, b2, ".byte", b0, b1, b2); break;
+        }
+        return written < 0 ? 0 : std::min <std::size_t> (written, size ? size - 1 : 0);
+    }
 
     switch (ins.addr_mode)
     {
         case MOS_6502::Mode::IMP:
         case MOS_6502::Mode::ACC:
-            result = {index, std::format ("{:04X}: {:02X} {:>9} {:<5}", index, b0, mnemonic, "").c_str(), false};
-            rom_index += 1;
+            written = std::snprintf (buffer, size, "%04X: %02X %9s %-5s", index, b0, mnemonic, "");
             break;
         case MOS_6502::Mode::ABS:
-            result =  {index,std::format ("{:04X}: {:02X} {:02X} {:02X} {:} ${:04X}", index, b0, b1, b2, mnemonic, (b2 << 8 | b1)), false};
-            rom_index += 3;
+            written = std::snprintf (buffer, size, "%04X: %02X %02X %02X %s $%04X", index, b0, b1, b2, mnemonic, line.operand);
             break;
         case MOS_6502::Mode::ABX:
-            result = {index,std::format ("{:04X}: {:02X} {:02X} {:02X} {:} ${:04X},X", index, b0, b1, b2, mnemonic, (b2 << 8 | b1)), false};
-            rom_index += 3;
+            written = std::snprintf (buffer, size, "%04X: %02X %02X %02X %s $%04X,X", index, b0, b1, b2, mnemonic, line.operand);
             break;
         case MOS_6502::Mode::ABY:
-            result = {index, std::format ("{:04X}: {:02X} {:02X} {:02X} {:} ${:04X},Y", index, b0, b1, b2, mnemonic, (b2 << 8 | b1)), false};
-            rom_index += 3;
+            written = std::snprintf (buffer, size, "%04X: %02X %02X %02X %s $%04X,Y", index, b0, b1, b2, mnemonic, line.operand);
             break;
         case MOS_6502::Mode::IMM:
-            result = {index, std::format ("{:04X}: {:02X} {:02X} {:>6} #${:02X}", index, b0, b1, mnemonic, b1), false};
-            rom_index += 2;
+            written = std::snprintf (buffer, size, "%04X: %02X %02X %6s #$%02X", index, b0, b1, mnemonic, b1);
             break;
         case MOS_6502::Mode::IND:
-            result = {index, std::format ("{:04X}: {:02X} {:02X} {:02X} {:s} (${:04X})", index, b0, b1, b2, mnemonic, (b2 << 8) | b1), false};
-            rom_index += 3;
+            written = std::snprintf (buffer, size, "%04X: %02X %02X %02X %s ($%04X)", index, b0, b1, b2, mnemonic, line.operand);
             break;
         case MOS_6502::Mode::XIZ:
-            result = {index, std::format ("{:04X}: {:02X} {:02X} {:>6} (${:02X},X)", index, b0, b1, mnemonic, b1), false};
-            rom_index += 2;
+            written = std::snprintf (buffer, size, "%04X: %02X %02X %6s ($%02X,X)", index, b0, b1, mnemonic, b1);
             break;
         case MOS_6502::Mode::YIZ:
-            result = {index, std::format ("{:04X}: {:02X} {:02X} {:>6} (${:02X}),Y", index, b0, b1, mnemonic, b1), false};
-            rom_index += 2;
+            written = std::snprintf (buffer, size, "%04X: %02X %02X %6s ($%02X),Y", index, b0, b1, mnemonic, b1);
             break;
         case MOS_6502::Mode::REL:
-            result = {index, std::format ("{:04X}: {:02X} {:02X} {:>6} ${:04X}", index, b0, b1, mnemonic, (index+2) + b1), false};
-            rom_index += 2;
+            // branch offset is signed and relative to the next instruction
+            written = std::snprintf (buffer, size, "%04X: %02X %02X %6s $%04X", index, b0, b1, mnemonic, (std::uint16_t)(index + 2 + (std::int8_t)b1));
             break;
         case MOS_6502::Mode::ZPG:
-            result = {index, std::format ("{:04X}: {:02X} {:02X} {:>6} ${:02X}", index, b0, b1, mnemonic, b1), false};
-            rom_index += 2;
+            written = std::snprintf (buffer, size, "%04X: %02X %02X %6s $%02X", index, b0, b1, mnemonic, b1);
             break;
         case MOS_6502::Mode::ZPX:
-            result = {index, std::format ("{:04X}: {:02X} {:02X} {:>6} ${:02X},X", index, b0, b1, mnemonic, b1), false};
-            rom_index += 2;
+            written = std::snprintf (buffer, size, "%04X: %02X %02X %6s $%02X,X", index, b0, b1, mnemonic, b1);
             break;
         case MOS_6502::Mode::ZPY:
-            result = {index, std::format ("{:04X}: {:02X} {:02X} {:>6} ${:02X},Y", index, b0, b1, mnemonic, b1), false};
-            rom_index += 2;
+            written = std::snprintf (buffer, size, "%04X: %02X %02X %6s $%02X,Y", index, b0, b1, mnemonic, b1);
             break;
     }
-    return rom_index;
+
+    if (written < 0)
+        return 0;
+    return std::min <std::size_t> (written, size ? size - 1 : 0);
 }
 
 MOS_6502::code_map_type MOS_6502::code_mapper (const std::vector<line_type>& code)
 {
-    code_map_type result;
-    for (const auto& line : code)
-        result.emplace (std::get<0>(line), line);
+    code_map_type result {code, std::vector<std::uint32_t> (0x10000, code_map_type::no_line)};
+    for (std::uint32_t i = 0; i < code.size(); ++i)
+        result.index[code[i].address] = i;
     return result;
 }
 
-bool MOS_6502::trace (trace_type& traces, const code_map_type& map, const MOS_6502::CPU &  cpu)
+bool MOS_6502::trace (trace_type& traces, const code_map_type& map, const MOS_6502::CPU &  cpu, const CPU::read_cb& peek)
 {
-    if (!map.contains((cpu.old_PC & 0x7FFF)))
-        return false;
+    // anything the disassembler has not reached yet is decoded on the spot
+    line_type decoded;
+    const auto* line = map.find (cpu.old_PC);
+    if (!line || line->has(Line_Flag::data))
+    {
+        const std::array <std::uint8_t, 3> bytes = {peek (cpu.old_PC), peek (cpu.old_PC + 1), peek (cpu.old_PC + 2)};
+        disassemble_line (decoded, bytes, 0, cpu.old_PC);
+        line = &decoded;
+    }
 
-    const auto& [addr, code, brk] = map.at(cpu.old_PC & 0x7FFF);
+    line_text code;
+    format_line (code.data(), code.size(), *line);
 
     std::vector <std::string> temp = 
     {
-        code,
+        code.data(),
         std::format (" {:02X} ", cpu.get_XR()),
         std::format (" {:02X} ", cpu.get_YR()),
         std::format (" {:02X} ", cpu.get_AC()),
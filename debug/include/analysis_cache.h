@@ -0,0 +1,44 @@
+#ifndef ANALYSIS_CACHE_H
+#define ANALYSIS_CACHE_H
+
+#include "disassembler.h"
+#include <cstdint>
+#include <filesystem>
+
+class Breakpoints;
+
+/*
+    keeps what the debugger worked out about a rom between runs, keyed by the hash of its contents
+    so renamed or copied roms still hit: the disassembly, code / data map, jump targets (the
+    generated labels) and execute breakpoints with their conditions
+
+    one file per rom, a fixed header then raw arrays in native byte order, loaded with mmap
+    it's a cache, anything that doesn't check out is ignored and rebuilt
+*/
+class Analysis_Cache
+{
+public:
+    /* $XDG_CACHE_HOME/6502-emulator or ~/.cache/6502-emulator, empty if neither is set */
+    static std::filesystem::path default_directory ();
+
+    explicit Analysis_Cache (std::filesystem::path _directory);
+
+    bool enabled () const {return !directory.empty();}
+
+    /*
+        replaces the disassembler state and the breakpoints, false when there's nothing usable for hash.
+        execute breakpoints are cleared either way, the ones set belong to the rom going out
+    */
+    bool load (const std::uint64_t hash, MOS_6502::Disassembler& disassembler, Breakpoints& breakpoints,
+               const MOS_6502::CPU::read_cb& peek, const MOS_6502::Disassembler::generation_cb& generation) const;
+
+    /* false while the disassembler is still on its first pass or the file can't be written */
+    bool save (const std::uint64_t hash, const MOS_6502::Disassembler& disassembler, const Breakpoints& breakpoints) const;
+
+private:
+    std::filesystem::path directory;
+
+    std::filesystem::path file (const std::uint64_t hash) const;
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef BREAKPOINTS_H
+#define BREAKPOINTS_H
+
+#include "condition.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+/*
+    one bit per address for each kind of breakpoint (8kb per kind)
+    kept apart from the disassembly so they survive re-disassembly
+    the gui thread sets bits while the cpu thread tests them
+
+    conditions and hit counts are only looked at once the bit for an address is set
+*/
+class Breakpoints
+{
+public:
+    enum class Kind : std::uint8_t
+    {
+        execute,
+        read,
+        write,
+    };
+
+    struct Status
+    {
+        std::string condition;
+        std::uint64_t hits;
+    };
+
+    static constexpr std::size_t address_count = 0x10000;
+
+    Breakpoints ();
+
+    bool test (const Kind kind, const std::uint16_t address) const
+    {
+        return (bits[static_cast <std::size_t> (kind)][address >> 6].load(std::memory_order_relaxed) >> (address & 63)) & 1;
+    }
+
+    void set    (const Kind kind, const std::uint16_t address, const bool value);
+    void toggle (const Kind kind, const std::uint16_t address);
+    void clear  (const Kind kind);
+    void clear  ();
+
+    /* slow path, counts the hit and evaluates the condition of an execute breakpoint that test() found */
+    bool should_break (const std::uint16_t address, const MOS_6502::CPU& cpu, const Condition::peek_cb& peek);
+
+    bool   set_condition (const std::uint16_t address, std::string_view source, std::string& error);
+    Status status (const std::uint16_t address) const;
+
+    template <typename Callback>
+    void for_each (const Kind kind, Callback callback) const
+    {
+        const auto& map = bits[static_cast <std::size_t> (kind)];
+        for (std::size_t i = 0; i < map.size(); ++i)
+        {
+            for (std::uint64_t word = map[i].load(std::memory_order_relaxed); word; word &= word - 1)
+                callback (static_cast <std::uint16_t> ((i << 6) | __builtin_ctzll (word)));
+        }
+    }
+
+private:
+    using bitmap = std::array <std::atomic <std::uint64_t>, address_count / 64>;
+
+    struct Entry
+    {
+        Condition condition;
+        std::uint64_t hits = 0;
+    };
+
+    std::array <bitmap, 3> bits;
+
+    mutable std::mutex mu;
+    std::map <std::uint16_t, Entry> entries;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef CONDITION_H
+#define CONDITION_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace MOS_6502
+{
+    class CPU;
+}
+
+/*
+    breakpoint condition, parsed once and compiled into a small stack bytecode
+
+    PC==$7200 && XR>$10 && [$0200]==0
+    HITS==1000
+
+    values      $FF  %1010  255
+    registers   PC AC XR YR SP SR (A X Y aliases) and flags N V B D I Z C
+    HITS        how many times the breakpoint has been reached, including this one
+    [expr]      byte in memory at expr
+    operators   || && | ^ & == != < <= > >= + - ! ~ (expr)
+*/
+class Condition
+{
+public:
+    using peek_cb = std::function <std::uint8_t(const std::uint16_t)>;
+
+    bool compile (std::string_view source, std::string& error);
+    bool evaluate (const MOS_6502::CPU& cpu, const peek_cb& peek, const std::uint64_t hits) const;
+
+    bool empty () const {return code.empty();}
+    const std::string& source () const {return text;}
+
+private:
+    enum class Op : std::uint8_t
+    {
+        constant, reg, hits, load,
+        neg, lnot, bnot, to_bool,
+        add, sub, band, bor, bxor,
+        eq, ne, lt, le, gt, ge,
+        jump_zero, jump_nonzero, // short circuit for && and ||, the tested value stays on the stack when jumping
+    };
+
+    enum class Reg : std::uint8_t
+    {
+        PC, AC, XR, YR, SP, SR,
+    };
+
+    struct Instruction
+    {
+        Op op;
+        std::uint32_t value;
+    };
+
+    static constexpr std::size_t max_depth = 32;
+
+    std::vector <Instruction> code;
+    std::string text;
+
+    friend class Condition_Parser;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/*
+    cheat finder style search over a block of memory
+    start() makes every address a candidate and takes a snapshot, each narrow() takes a new
+    snapshot and drops the candidates that fail the filter against the previous one
+    candidates are kept as a byte mask (0xFF / 0x00) so a pass is a straight run of vector compares
+*/
+class Memory_Search
+{
+public:
+    enum class Width : std::uint8_t
+    {
+        byte,
+        word, // little endian, the candidate is the address of the low byte
+    };
+
+    enum class Filter : std::uint8_t
+    {
+        equal,        // current == value
+        changed,      // current != previous
+        unchanged,    // current == previous
+        increased,    // current >  previous, unsigned
+        decreased,    // current <  previous, unsigned
+        increased_by, // current == previous + value, wraps so a value of -1 finds decrements
+    };
+
+    Memory_Search ();
+
+    void start (std::span <const std::uint8_t> memory, const Width _width);
+
+    /* memory has to be the same size as the one passed to start, returns the candidates left */
+    std::size_t narrow (std::span <const std::uint8_t> memory, const Filter filter, const std::uint16_t value = 0);
+
+    std::size_t count () const {return candidates;}
+    Width width () const {return search_width;}
+    bool started () const {return !mask.empty();}
+
+    /* the first limit candidates in address order */
+    std::vector <std::size_t> results (const std::size_t limit) const;
+
+    /* value at index in the last snapshot */
+    std::uint16_t value (const std::size_t index) const;
+
+    /* every offset where pattern occurs, stops after limit */
+    static std::vector <std::size_t> find (std::span <const std::uint8_t> memory, std::span <const std::uint8_t> pattern, const std::size_t limit);
+
+private:
+    std::vector <std::uint8_t> mask;
+    std::vector <std::uint8_t> previous;
+    std::vector <std::uint8_t> current;
+    std::size_t candidates;
+    Width search_width;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef WATCHPOINTS_H
+#define WATCHPOINTS_H
+
+#include "bus.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+class Breakpoints;
+
+/*
+    read / write / value change watchpoints on address ranges
+    only the pages a range touches are trapped on the bus, the read and write
+    bitmaps in Breakpoints then filter the exact addresses inside those pages
+*/
+class Watchpoints
+{
+public:
+    enum class Kind : std::uint8_t
+    {
+        read,
+        write,
+        change,
+    };
+
+    // begin and end are inclusive
+    struct Range
+    {
+        std::uint16_t begin;
+        std::uint16_t end;
+        Kind kind;
+    };
+
+    struct Hit
+    {
+        Kind kind;
+        std::uint16_t address;
+        std::uint8_t old_value;
+        std::uint8_t new_value;
+        std::uint16_t pc;
+    };
+
+    Watchpoints (Bus& _bus, Breakpoints& _breakpoints);
+    ~Watchpoints ();
+
+    void add (const Range range);
+    void remove (const std::size_t index);
+    void clear ();
+    std::vector <Range> ranges () const;
+
+    /* cpu thread, checked after every instruction */
+    bool triggered () const {return pending.load(std::memory_order_relaxed);}
+    void acknowledge (const std::uint16_t pc);
+
+    std::optional <Hit> last_hit () const;
+
+private:
+    Bus& bus;
+    Breakpoints& breakpoints;
+
+    mutable std::mutex mu;
+    std::vector <Range> watches;
+    std::optional <Hit> hit;
+    std::atomic <bool> pending;
+
+    void on_trap (const Bus::Access access, const std::uint16_t address, const std::uint8_t old_value, const std::uint8_t new_value);
+    void update_traps ();
+};
+
+#endif
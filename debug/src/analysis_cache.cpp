@@ -0,0 +1,239 @@
+#include "analysis_cache.h"
+#include "breakpoints.h"
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr std::array <char, 8> magic = {'6', '5', '0', '2', 'A', 'N', 'L', '\0'};
+    constexpr std::uint32_t format_version = 1;
+
+    struct Header
+    {
+        std::array <char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t line_count;
+        std::uint64_t hash;
+        std::uint32_t breakpoint_count;
+        std::uint16_t data_begin;
+        std::uint16_t data_end;
+    };
+
+    // followed by the condition source
+    struct Breakpoint_Record
+    {
+        std::uint16_t address;
+        std::uint16_t condition_size;
+    };
+
+    constexpr std::size_t space = 0x10000;
+    constexpr std::size_t target_words = space / 64;
+
+    using Kind = MOS_6502::Disassembler::Kind;
+    using line_type = MOS_6502::line_type;
+
+    // header, memory, kinds, targets, lines, breakpoints
+    constexpr std::size_t memory_offset  = sizeof(Header);
+    constexpr std::size_t kinds_offset   = memory_offset + space;
+    constexpr std::size_t targets_offset = kinds_offset + space * sizeof(Kind);
+    constexpr std::size_t lines_offset   = targets_offset + target_words * sizeof(std::uint64_t);
+
+    static_assert (targets_offset % alignof(std::uint64_t) == 0);
+    static_assert (std::is_trivially_copyable_v <line_type>);
+
+    // a stale or damaged file mustn't hand the listing code kinds or lines it would index out of range with
+    bool valid (std::span <const Kind> kinds, std::span <const line_type> lines)
+    {
+        constexpr auto known_flags = static_cast <std::uint8_t> (MOS_6502::Line_Flag::illegal) | static_cast <std::uint8_t> (MOS_6502::Line_Flag::data);
+        for (const Kind kind : kinds)
+        {
+            if (static_cast <std::uint8_t> (kind) > static_cast <std::uint8_t> (Kind::operand))
+                return false;
+        }
+        for (const auto& line : lines)
+        {
+            if (line.length > 3 || line.address + line.length > space || (line.flags & ~known_flags) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    class Mapped_File
+    {
+    public:
+        explicit Mapped_File (const std::filesystem::path& path)
+        {
+            const int fd = ::open (path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+            struct stat info {};
+            if (::fstat (fd, &info) == 0 && info.st_size > 0)
+            {
+                void* const view = ::mmap (nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (view != MAP_FAILED)
+                {
+                    bytes = {static_cast <const std::uint8_t*> (view), static_cast <std::size_t> (info.st_size)};
+                }
+            }
+            ::close (fd);
+        }
+
+        ~Mapped_File ()
+        {
+            if (!bytes.empty())
+                ::munmap (const_cast <std::uint8_t*> (bytes.data()), bytes.size());
+        }
+
+        Mapped_File (const Mapped_File&) = delete;
+        Mapped_File& operator = (const Mapped_File&) = delete;
+
+        std::span <const std::uint8_t> bytes;
+    };
+}
+
+std::filesystem::path Analysis_Cache::default_directory ()
+{
+    if (const char* cache = std::getenv ("XDG_CACHE_HOME"); cache != nullptr && *cache != '\0')
+        return std::filesystem::path(cache) / "6502-emulator";
+    if (const char* home = std::getenv ("HOME"); home != nullptr && *home != '\0')
+        return std::filesystem::path(home) / ".cache" / "6502-emulator";
+    return {};
+}
+
+Analysis_Cache::Analysis_Cache (std::filesystem::path _directory)
+: directory {std::move (_directory)}
+{
+}
+
+std::filesystem::path Analysis_Cache::file (const std::uint64_t hash) const
+{
+    char name[32];
+    std::snprintf (name, sizeof(name), "%016llx.analysis", static_cast <unsigned long long> (hash));
+    return directory / name;
+}
+
+bool Analysis_Cache::load (const std::uint64_t hash, MOS_6502::Disassembler& disassembler, Breakpoints& breakpoints,
+                           const MOS_6502::CPU::read_cb& peek, const MOS_6502::Disassembler::generation_cb& generation) const
+{
+    // read / write bits belong to the watchpoints, leave those alone
+    breakpoints.clear (Breakpoints::Kind::execute);
+    if (!enabled())
+        return false;
+
+    const Mapped_File mapped (file (hash));
+    const auto bytes = mapped.bytes;
+    if (bytes.size() < lines_offset)
+        return false;
+
+    Header header;
+    std::memcpy (&header, bytes.data(), sizeof(header));
+    const std::size_t lines_end = lines_offset + std::size_t {header.line_count} * sizeof(line_type);
+    if (header.magic != magic || header.version != format_version || header.hash != hash || bytes.size() < lines_end)
+        return false;
+
+    // the arrays are used in place, only the disassembler's own copy touches the pages
+    const MOS_6502::Disassembler::Analysis analysis
+    {
+        bytes.subspan (memory_offset, space),
+        {reinterpret_cast <const Kind*> (bytes.data() + kinds_offset), space},
+        {reinterpret_cast <const std::uint64_t*> (bytes.data() + targets_offset), target_words},
+        {reinterpret_cast <const line_type*> (bytes.data() + lines_offset), header.line_count},
+        header.data_begin,
+        header.data_end,
+    };
+    if (!valid (analysis.kinds, analysis.lines) || !disassembler.restore (analysis, peek, generation))
+        return false;
+
+    std::size_t offset = lines_end;
+    for (std::uint32_t i = 0; i < header.breakpoint_count; ++i)
+    {
+        Breakpoint_Record record;
+        if (offset + sizeof(record) > bytes.size())
+            break;
+        std::memcpy (&record, bytes.data() + offset, sizeof(record));
+        offset += sizeof(record);
+        if (offset + record.condition_size > bytes.size())
+            break;
+
+        const std::string_view condition (reinterpret_cast <const char*> (bytes.data() + offset), record.condition_size);
+        offset += record.condition_size;
+
+        std::string error;
+        if (!breakpoints.set_condition (record.address, condition, error))
+            breakpoints.set (Breakpoints::Kind::execute, record.address, true);
+    }
+    return true;
+}
+
+bool Analysis_Cache::save (const std::uint64_t hash, const MOS_6502::Disassembler& disassembler, const Breakpoints& breakpoints) const
+{
+    if (!enabled())
+        return false;
+
+    std::vector <line_type> lines;
+    const auto analysis = disassembler.analysis (lines);
+    if (!analysis)
+        return false;
+
+    std::error_code error;
+    std::filesystem::create_directories (directory, error);
+
+    std::vector <std::pair <std::uint16_t, std::string>> conditions;
+    breakpoints.for_each (Breakpoints::Kind::execute, [&] (const std::uint16_t address)
+    {
+        conditions.emplace_back (address, breakpoints.status(address).condition);
+    });
+
+    const Header header {magic, format_version, static_cast <std::uint32_t> (lines.size()), hash,
+                         static_cast <std::uint32_t> (conditions.size()), analysis->data_begin, analysis->data_end};
+
+    // written beside the real file and renamed over it so a reader never maps half a file
+    const auto path = file (hash);
+    const auto temporary = std::filesystem::path(path).concat(".tmp");
+    {
+        std::ofstream output (temporary, std::ios::binary | std::ios::trunc);
+        if (!output.is_open())
+        {
+            std::cerr << temporary << " could not be written" << std::endl;
+            return false;
+        }
+
+        const auto write = [&output] (const auto* data, const std::size_t size)
+        {
+            output.write (reinterpret_cast <const char*> (data), size);
+        };
+        write (&header, sizeof(header));
+        write (analysis->memory.data(), analysis->memory.size_bytes());
+        write (analysis->kinds.data(), analysis->kinds.size_bytes());
+        write (analysis->targets.data(), analysis->targets.size_bytes());
+        write (lines.data(), lines.size() * sizeof(line_type));
+        for (const auto& [address, condition] : conditions)
+        {
+            const Breakpoint_Record record {address, static_cast <std::uint16_t> (condition.size())};
+            write (&record, sizeof(record));
+            write (condition.data(), condition.size());
+        }
+        if (!output)
+        {
+            std::cerr << temporary << " could not be written" << std::endl;
+            return false;
+        }
+    }
+
+    std::filesystem::rename (temporary, path, error);
+    if (error)
+    {
+        std::cerr << path << ": " << error.message() << std::endl;
+        return false;
+    }
+    return true;
+}
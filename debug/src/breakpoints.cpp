@@ -0,0 +1,80 @@
+#include "breakpoints.h"
+
+Breakpoints::Breakpoints ()
+{
+    clear ();
+}
+
+void Breakpoints::set (const Kind kind, const std::uint16_t address, const bool value)
+{
+    auto& word = bits[static_cast <std::size_t> (kind)][address >> 6];
+    const std::uint64_t mask = std::uint64_t {1} << (address & 63);
+    if (value)
+    {
+        word.fetch_or (mask, std::memory_order_relaxed);
+    }
+    else
+    {
+        word.fetch_and (~mask, std::memory_order_relaxed);
+        if (kind == Kind::execute)
+        {
+            std::lock_guard lock (mu);
+            entries.erase (address);
+        }
+    }
+}
+
+void Breakpoints::toggle (const Kind kind, const std::uint16_t address)
+{
+    set (kind, address, !test (kind, address));
+}
+
+void Breakpoints::clear (const Kind kind)
+{
+    for (auto& word : bits[static_cast <std::size_t> (kind)])
+        word.store (0, std::memory_order_relaxed);
+
+    if (kind == Kind::execute)
+    {
+        std::lock_guard lock (mu);
+        entries.clear ();
+    }
+}
+
+void Breakpoints::clear ()
+{
+    clear (Kind::execute);
+    clear (Kind::read);
+    clear (Kind::write);
+}
+
+bool Breakpoints::should_break (const std::uint16_t address, const MOS_6502::CPU& cpu, const Condition::peek_cb& peek)
+{
+    std::lock_guard lock (mu);
+    auto& entry = entries[address];
+    ++entry.hits;
+    return entry.condition.evaluate (cpu, peek, entry.hits);
+}
+
+bool Breakpoints::set_condition (const std::uint16_t address, std::string_view source, std::string& error)
+{
+    Condition condition;
+    if (!source.empty() && !condition.compile (source, error))
+        return false;
+
+    {
+        std::lock_guard lock (mu);
+        entries[address] = {std::move (condition), 0};
+    }
+    set (Kind::execute, address, true);
+    return true;
+}
+
+Breakpoints::Status Breakpoints::status (const std::uint16_t address) const
+{
+    std::lock_guard lock (mu);
+    const auto it = entries.find (address);
+    if (it == entries.end())
+        return {};
+    return {it->second.condition.source(), it->second.hits};
+}
@@ -0,0 +1,385 @@
+#include "condition.h"
+#include "mos6502.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <format>
+#include <utility>
+
+class Condition_Parser
+{
+public:
+    using Op  = Condition::Op;
+    using Reg = Condition::Reg;
+
+    Condition_Parser (std::string_view _source, std::vector <Condition::Instruction>& _code)
+    : source {_source}
+    , code {_code}
+    , position {0}
+    , depth {0}
+    , max_depth {0}
+    {
+    }
+
+    bool parse (std::string& error)
+    {
+        skip_space ();
+        if (position == source.size())
+            return fail ("empty condition", error);
+
+        if (!logical_or (error))
+            return false;
+
+        skip_space ();
+        if (position != source.size())
+            return fail (std::format ("unexpected '{}'", source[position]), error);
+
+        if (max_depth > Condition::max_depth)
+            return fail ("condition is too complex", error);
+        return true;
+    }
+
+private:
+    std::string_view source;
+    std::vector <Condition::Instruction>& code;
+    std::size_t position;
+    std::size_t depth;
+    std::size_t max_depth;
+
+    bool fail (const std::string& message, std::string& error)
+    {
+        error = std::format ("{} at column {}", message, position + 1);
+        return false;
+    }
+
+    void skip_space ()
+    {
+        while (position < source.size() && std::isspace (static_cast <unsigned char> (source[position])))
+            ++position;
+    }
+
+    bool accept (std::string_view token)
+    {
+        skip_space ();
+        if (source.substr (position, token.size()) != token)
+            return false;
+        position += token.size();
+        return true;
+    }
+
+    void emit (const Op op, const std::uint32_t value = 0)
+    {
+        switch (op)
+        {
+            case Op::constant: case Op::reg: case Op::hits:
+                max_depth = std::max (max_depth, ++depth);
+                break;
+            case Op::add: case Op::sub: case Op::band: case Op::bor: case Op::bxor:
+            case Op::eq: case Op::ne: case Op::lt: case Op::le: case Op::gt: case Op::ge:
+            case Op::jump_zero: case Op::jump_nonzero:
+                --depth;
+                break;
+            default:
+                break;
+        }
+        code.push_back ({op, value});
+    }
+
+    /* a && b and a || b only evaluate b when they have to */
+    template <typename Next>
+    bool short_circuit (std::string_view token, const Op jump, Next next, std::string& error)
+    {
+        if (!(this->*next) (error))
+            return false;
+        while (accept (token))
+        {
+            emit (Op::to_bool);
+            const std::size_t jump_index = code.size();
+            emit (jump);
+            if (!(this->*next) (error))
+                return false;
+            emit (Op::to_bool);
+            code[jump_index].value = code.size();
+        }
+        return true;
+    }
+
+    template <typename Next, std::size_t N>
+    bool binary (const std::array <std::pair <std::string_view, Op>, N>& operators, Next next, std::string& error)
+    {
+        if (!(this->*next) (error))
+            return false;
+        for (;;)
+        {
+            skip_space ();
+            bool matched = false;
+            for (const auto& [token, op] : operators)
+            {
+                // don't let | and & swallow the first half of || and &&
+                if (token.size() == 1 && (token == "|" || token == "&") && source.substr (position, 2) == std::string (2, token[0]))
+                    continue;
+                // < and > must not swallow <= and >=, = is accepted as ==
+                if (source.substr (position, token.size()) != token)
+                    continue;
+                if (token.size() == 1 && (token == "<" || token == ">") && source.substr (position + 1, 1) == "=")
+                    continue;
+
+                position += token.size();
+                if (!(this->*next) (error))
+                    return false;
+                emit (op);
+                matched = true;
+                break;
+            }
+            if (!matched)
+                return true;
+        }
+    }
+
+    bool logical_or (std::string& error)  {return short_circuit ("||", Op::jump_nonzero, &Condition_Parser::logical_and, error);}
+    bool logical_and (std::string& error) {return short_circuit ("&&", Op::jump_zero, &Condition_Parser::bit_or, error);}
+
+    bool bit_or (std::string& error)
+    {
+        static constexpr std::array <std::pair <std::string_view, Op>, 1> operators {{{"|", Op::bor}}};
+        return binary (operators, &Condition_Parser::bit_xor, error);
+    }
+
+    bool bit_xor (std::string& error)
+    {
+        static constexpr std::array <std::pair <std::string_view, Op>, 1> operators {{{"^", Op::bxor}}};
+        return binary (operators, &Condition_Parser::bit_and, error);
+    }
+
+    bool bit_and (std::string& error)
+    {
+        static constexpr std::array <std::pair <std::string_view, Op>, 1> operators {{{"&", Op::band}}};
+        return binary (operators, &Condition_Parser::equality, error);
+    }
+
+    bool equality (std::string& error)
+    {
+        static constexpr std::array <std::pair <std::string_view, Op>, 3> operators {{{"==", Op::eq}, {"!=", Op::ne}, {"=", Op::eq}}};
+        return binary (operators, &Condition_Parser::relational, error);
+    }
+
+    bool relational (std::string& error)
+    {
+        static constexpr std::array <std::pair <std::string_view, Op>, 4> operators {{{"<=", Op::le}, {">=", Op::ge}, {"<", Op::lt}, {">", Op::gt}}};
+        return binary (operators, &Condition_Parser::additive, error);
+    }
+
+    bool additive (std::string& error)
+    {
+        static constexpr std::array <std::pair <std::string_view, Op>, 2> operators {{{"+", Op::add}, {"-", Op::sub}}};
+        return binary (operators, &Condition_Parser::unary, error);
+    }
+
+    bool unary (std::string& error)
+    {
+        skip_space ();
+        if (source.substr (position, 2) != "!=" && accept ("!"))
+        {
+            if (!unary (error)) return false;
+            emit (Op::lnot);
+            return true;
+        }
+        if (accept ("~"))
+        {
+            if (!unary (error)) return false;
+            emit (Op::bnot);
+            return true;
+        }
+        if (accept ("-"))
+        {
+            if (!unary (error)) return false;
+            emit (Op::neg);
+            return true;
+        }
+        return primary (error);
+    }
+
+    bool number (const int base, std::string& error)
+    {
+        const std::size_t begin = position;
+        std::uint64_t value = 0;
+        while (position < source.size())
+        {
+            const char c = std::toupper (static_cast <unsigned char> (source[position]));
+            int digit = -1;
+            if (c >= '0' && c <= '9') digit = c - '0';
+            else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+            if (digit < 0 || digit >= base)
+                break;
+            value = value * base + digit;
+            if (value > UINT32_MAX)
+                return fail ("number is too large", error);
+            ++position;
+        }
+        if (position == begin)
+            return fail ("expected a number", error);
+        emit (Op::constant, static_cast <std::uint32_t> (value));
+        return true;
+    }
+
+    bool name (std::string& error)
+    {
+        static constexpr std::array <std::pair <std::string_view, Reg>, 9> registers
+        {{
+            {"PC", Reg::PC}, {"AC", Reg::AC}, {"XR", Reg::XR}, {"YR", Reg::YR}, {"SP", Reg::SP}, {"SR", Reg::SR},
+            {"A", Reg::AC}, {"X", Reg::XR}, {"Y", Reg::YR},
+        }};
+        static constexpr std::array <std::pair <std::string_view, MOS_6502::Flag>, 7> flags
+        {{
+            {"N", MOS_6502::Flag::N}, {"V", MOS_6502::Flag::V}, {"B", MOS_6502::Flag::B}, {"D", MOS_6502::Flag::D},
+            {"I", MOS_6502::Flag::I}, {"Z", MOS_6502::Flag::Z}, {"C", MOS_6502::Flag::C},
+        }};
+
+        const std::size_t begin = position;
+        std::string word;
+        while (position < source.size() && std::isalnum (static_cast <unsigned char> (source[position])))
+            word += std::toupper (static_cast <unsigned char> (source[position++]));
+
+        if (word == "HITS")
+        {
+            emit (Op::hits);
+            return true;
+        }
+        for (const auto& [key, reg] : registers)
+        {
+            if (key == word)
+            {
+                emit (Op::reg, static_cast <std::uint32_t> (reg));
+                return true;
+            }
+        }
+        for (const auto& [key, flag] : flags)
+        {
+            if (key == word)
+            {
+                emit (Op::reg, static_cast <std::uint32_t> (Reg::SR));
+                emit (Op::constant, static_cast <std::uint32_t> (flag));
+                emit (Op::band);
+                emit (Op::to_bool);
+                return true;
+            }
+        }
+
+        position = begin;
+        return fail (std::format ("unknown name '{}'", word), error);
+    }
+
+    bool primary (std::string& error)
+    {
+        skip_space ();
+        if (position == source.size())
+            return fail ("unexpected end of condition", error);
+
+        const char c = source[position];
+        if (c == '$')
+        {
+            ++position;
+            return number (16, error);
+        }
+        if (c == '%')
+        {
+            ++position;
+            return number (2, error);
+        }
+        if (c == '0' && position + 1 < source.size() && (source[position + 1] == 'x' || source[position + 1] == 'X'))
+        {
+            position += 2;
+            return number (16, error);
+        }
+        if (std::isdigit (static_cast <unsigned char> (c)))
+            return number (10, error);
+        if (std::isalpha (static_cast <unsigned char> (c)))
+            return name (error);
+
+        if (accept ("("))
+        {
+            if (!logical_or (error)) return false;
+            if (!accept (")")) return fail ("expected ')'", error);
+            return true;
+        }
+        if (accept ("["))
+        {
+            if (!logical_or (error)) return false;
+            if (!accept ("]")) return fail ("expected ']'", error);
+            emit (Op::load);
+            return true;
+        }
+        return fail (std::format ("unexpected '{}'", c), error);
+    }
+};
+
+bool Condition::compile (std::string_view source, std::string& error)
+{
+    std::vector <Instruction> result;
+    Condition_Parser parser (source, result);
+    if (!parser.parse (error))
+        return false;
+
+    code = std::move (result);
+    text = source;
+    return true;
+}
+
+bool Condition::evaluate (const MOS_6502::CPU& cpu, const peek_cb& peek, const std::uint64_t hits) const
+{
+    if (code.empty())
+        return true;
+
+    std::array <std::int64_t, max_depth> stack;
+    std::size_t top = 0;
+
+    for (std::size_t i = 0; i < code.size(); ++i)
+    {
+        const auto& ins = code[i];
+        switch (ins.op)
+        {
+            case Op::constant: stack[top++] = ins.value; break;
+            case Op::hits:     stack[top++] = hits; break;
+            case Op::reg:
+                switch (static_cast <Reg> (ins.value))
+                {
+                    case Reg::PC: stack[top++] = cpu.get_PC(); break;
+                    case Reg::AC: stack[top++] = cpu.get_AC(); break;
+                    case Reg::XR: stack[top++] = cpu.get_XR(); break;
+                    case Reg::YR: stack[top++] = cpu.get_YR(); break;
+                    case Reg::SP: stack[top++] = cpu.get_SP(); break;
+                    case Reg::SR: stack[top++] = cpu.get_SR(); break;
+                }
+                break;
+            case Op::load:    stack[top - 1] = peek (static_cast <std::uint16_t> (stack[top - 1])); break;
+            case Op::neg:     stack[top - 1] = -stack[top - 1]; break;
+            case Op::lnot:    stack[top - 1] = !stack[top - 1]; break;
+            case Op::bnot:    stack[top - 1] = ~stack[top - 1]; break;
+            case Op::to_bool: stack[top - 1] = stack[top - 1] != 0; break;
+            case Op::add:  --top; stack[top - 1] = stack[top - 1] +  stack[top]; break;
+            case Op::sub:  --top; stack[top - 1] = stack[top - 1] -  stack[top]; break;
+            case Op::band: --top; stack[top - 1] = stack[top - 1] &  stack[top]; break;
+            case Op::bor:  --top; stack[top - 1] = stack[top - 1] |  stack[top]; break;
+            case Op::bxor: --top; stack[top - 1] = stack[top - 1] ^  stack[top]; break;
+            case Op::eq:   --top; stack[top - 1] = stack[top - 1] == stack[top]; break;
+            case Op::ne:   --top; stack[top - 1] = stack[top - 1] != stack[top]; break;
+            case Op::lt:   --top; stack[top - 1] = stack[top - 1] <  stack[top]; break;
+            case Op::le:   --top; stack[top - 1] = stack[top - 1] <= stack[top]; break;
+            case Op::gt:   --top; stack[top - 1] = stack[top - 1] >  stack[top]; break;
+            case Op::ge:   --top; stack[top - 1] = stack[top - 1] >= stack[top]; break;
+            case Op::jump_zero:
+                if (stack[top - 1] == 0)
+                    i = ins.value - 1;
+                else
+                    --top;
+                break;
+            case Op::jump_nonzero:
+                if (stack[top - 1] != 0)
+                    i = ins.value - 1;
+                else
+                    --top;
+                break;
+        }
+    }
+    return stack[0] != 0;
+}
@@ -0,0 +1,181 @@
+#include "search.h"
+#include "search_kernel.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+namespace
+{
+    struct Sse2
+    {
+        using reg = __m128i;
+        static constexpr std::size_t bytes = sizeof(reg);
+
+        static reg load (const std::uint8_t* p)      {return _mm_loadu_si128 (reinterpret_cast <const reg*> (p));}
+        static void store (std::uint8_t* p, reg a)   {_mm_storeu_si128 (reinterpret_cast <reg*> (p), a);}
+        static reg ones ()                           {return _mm_set1_epi8 (-1);}
+        static reg set8 (std::uint16_t v)            {return _mm_set1_epi8 (static_cast <char> (v));}
+        static reg set16 (std::uint16_t v)           {return _mm_set1_epi16 (static_cast <short> (v));}
+        static reg band (reg a, reg b)               {return _mm_and_si128 (a, b);}
+        static reg bor (reg a, reg b)                {return _mm_or_si128 (a, b);}
+        static reg andnot (reg a, reg b)             {return _mm_andnot_si128 (a, b);}
+        static reg eq8 (reg a, reg b)                {return _mm_cmpeq_epi8 (a, b);}
+        static reg eq16 (reg a, reg b)               {return _mm_cmpeq_epi16 (a, b);}
+        static reg add8 (reg a, reg b)               {return _mm_add_epi8 (a, b);}
+        static reg add16 (reg a, reg b)              {return _mm_add_epi16 (a, b);}
+        static reg shift_up8 (reg a)                 {return _mm_slli_epi16 (a, 8);}
+        static unsigned movemask (reg a)             {return static_cast <unsigned> (_mm_movemask_epi8 (a));}
+        static int popcount (unsigned mask)          {return __builtin_popcount (mask);}
+
+        static reg gt8 (reg a, reg b)
+        {
+            const reg bias = _mm_set1_epi8 (static_cast <char> (0x80));
+            return _mm_cmpgt_epi8 (_mm_xor_si128 (a, bias), _mm_xor_si128 (b, bias));
+        }
+        static reg gt16 (reg a, reg b)
+        {
+            const reg bias = _mm_set1_epi16 (static_cast <short> (0x8000));
+            return _mm_cmpgt_epi16 (_mm_xor_si128 (a, bias), _mm_xor_si128 (b, bias));
+        }
+    };
+}
+#endif
+
+namespace
+{
+    bool keep (const search_kernel::Args& args, const std::size_t i)
+    {
+        using Filter = Memory_Search::Filter;
+
+        std::uint16_t current  = args.current[i];
+        std::uint16_t previous = args.previous[i];
+        std::uint16_t mask     = 0xFF;
+        if (args.width == Memory_Search::Width::word)
+        {
+            // the last byte can't hold a word
+            if (i + 1 >= args.size)
+                return false;
+            current  |= args.current[i + 1] << 8;
+            previous |= args.previous[i + 1] << 8;
+            mask = 0xFFFF;
+        }
+
+        switch (args.filter)
+        {
+            case Filter::equal:        return current == (args.value & mask);
+            case Filter::changed:      return current != previous;
+            case Filter::unchanged:    return current == previous;
+            case Filter::increased:    return current > previous;
+            case Filter::decreased:    return current < previous;
+            case Filter::increased_by: return current == ((previous + args.value) & mask);
+        }
+        return false;
+    }
+
+    bool has_avx2 ()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        static const bool supported = __builtin_cpu_supports ("avx2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+}
+
+Memory_Search::Memory_Search ()
+: mask {}
+, previous {}
+, current {}
+, candidates {0}
+, search_width {Width::byte}
+{
+}
+
+void Memory_Search::start (std::span <const std::uint8_t> memory, const Width _width)
+{
+    search_width = _width;
+    previous.assign (memory.begin(), memory.end());
+    current.resize (memory.size());
+    mask.assign (memory.size(), 0xFF);
+    candidates = memory.size();
+
+    if (search_width == Width::word && !mask.empty())
+    {
+        mask.back() = 0;
+        --candidates;
+    }
+}
+
+std::size_t Memory_Search::narrow (std::span <const std::uint8_t> memory, const Filter filter, const std::uint16_t value)
+{
+    if (memory.size() != mask.size())
+        return candidates;
+
+    // the cpu keeps writing while this runs, compare against one consistent copy
+    std::memcpy (current.data(), memory.data(), memory.size());
+
+    const search_kernel::Args args {current.data(), previous.data(), mask.data(), mask.size(), filter, search_width, value};
+
+    std::size_t count = 0;
+    std::size_t done = 0;
+    if (has_avx2 ())
+        done = search_kernel::narrow_avx2 (args, count);
+#if defined(__SSE2__)
+    if (done == 0)
+        done = search_kernel::narrow <Sse2> (args, count);
+#endif
+
+    for (std::size_t i = done; i < mask.size(); ++i)
+    {
+        if (mask[i] && !keep (args, i))
+            mask[i] = 0;
+        count += mask[i] != 0;
+    }
+
+    candidates = count;
+    std::swap (previous, current);
+    return candidates;
+}
+
+std::vector <std::size_t> Memory_Search::results (const std::size_t limit) const
+{
+    std::vector <std::size_t> found;
+    for (std::size_t i = 0; i < mask.size() && found.size() < limit; ++i)
+    {
+        if (mask[i])
+            found.push_back (i);
+    }
+    return found;
+}
+
+std::uint16_t Memory_Search::value (const std::size_t index) const
+{
+    if (index >= previous.size())
+        return 0;
+    if (search_width == Width::word && index + 1 < previous.size())
+        return previous[index] | (previous[index + 1] << 8);
+    return previous[index];
+}
+
+std::vector <std::size_t> Memory_Search::find (std::span <const std::uint8_t> memory, std::span <const std::uint8_t> pattern, const std::size_t limit)
+{
+    std::vector <std::size_t> found;
+    if (pattern.empty() || pattern.size() > memory.size())
+        return found;
+
+    // memchr is already vectorised, it finds the first byte and memcmp checks the rest
+    const std::uint8_t* const begin = memory.data();
+    const std::uint8_t* const last  = begin + memory.size() - pattern.size();
+    for (const std::uint8_t* p = begin; p <= last && found.size() < limit; ++p)
+    {
+        p = static_cast <const std::uint8_t*> (std::memchr (p, pattern[0], last - p + 1));
+        if (p == nullptr)
+            break;
+        if (std::memcmp (p, pattern.data(), pattern.size()) == 0)
+            found.push_back (p - begin);
+    }
+    return found;
+}
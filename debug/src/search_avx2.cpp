@@ -0,0 +1,55 @@
+#include "search_kernel.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace
+{
+    struct Avx2
+    {
+        using reg = __m256i;
+        static constexpr std::size_t bytes = sizeof(reg);
+
+        static reg load (const std::uint8_t* p)      {return _mm256_loadu_si256 (reinterpret_cast <const reg*> (p));}
+        static void store (std::uint8_t* p, reg a)   {_mm256_storeu_si256 (reinterpret_cast <reg*> (p), a);}
+        static reg ones ()                           {return _mm256_set1_epi8 (-1);}
+        static reg set8 (std::uint16_t v)            {return _mm256_set1_epi8 (static_cast <char> (v));}
+        static reg set16 (std::uint16_t v)           {return _mm256_set1_epi16 (static_cast <short> (v));}
+        static reg band (reg a, reg b)               {return _mm256_and_si256 (a, b);}
+        static reg bor (reg a, reg b)                {return _mm256_or_si256 (a, b);}
+        static reg andnot (reg a, reg b)             {return _mm256_andnot_si256 (a, b);}
+        static reg eq8 (reg a, reg b)                {return _mm256_cmpeq_epi8 (a, b);}
+        static reg eq16 (reg a, reg b)               {return _mm256_cmpeq_epi16 (a, b);}
+        static reg add8 (reg a, reg b)               {return _mm256_add_epi8 (a, b);}
+        static reg add16 (reg a, reg b)              {return _mm256_add_epi16 (a, b);}
+        static reg shift_up8 (reg a)                 {return _mm256_slli_epi16 (a, 8);}
+        static unsigned movemask (reg a)             {return static_cast <unsigned> (_mm256_movemask_epi8 (a));}
+        static int popcount (unsigned mask)          {return __builtin_popcount (mask);}
+
+        // there are only signed compares, flipping the sign bit makes them unsigned
+        static reg gt8 (reg a, reg b)
+        {
+            const reg bias = _mm256_set1_epi8 (static_cast <char> (0x80));
+            return _mm256_cmpgt_epi8 (_mm256_xor_si256 (a, bias), _mm256_xor_si256 (b, bias));
+        }
+        static reg gt16 (reg a, reg b)
+        {
+            const reg bias = _mm256_set1_epi16 (static_cast <short> (0x8000));
+            return _mm256_cmpgt_epi16 (_mm256_xor_si256 (a, bias), _mm256_xor_si256 (b, bias));
+        }
+    };
+}
+
+std::size_t search_kernel::narrow_avx2 (const Args& args, std::size_t& count)
+{
+    return narrow <Avx2> (args, count);
+}
+
+#else
+
+std::size_t search_kernel::narrow_avx2 (const Args&, std::size_t&)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef SEARCH_KERNEL_H
+#define SEARCH_KERNEL_H
+
+#include "search.h"
+#include <cstddef>
+#include <cstdint>
+
+/*
+    the narrowing loop, shared by every instruction set and instantiated with a small traits
+    type wrapping its intrinsics, see search.cpp (sse2) and search_avx2.cpp (avx2)
+    it handles whole vectors from the start of the block and returns how far it got,
+    the caller finishes the tail one byte at a time
+
+    everything the loop calls comes from the traits type, a standard library template used here would be
+    compiled once per instruction set under one name and the linker could keep the avx2 copy for everyone
+*/
+namespace search_kernel
+{
+    using Filter = Memory_Search::Filter;
+
+    struct Args
+    {
+        const std::uint8_t* current;
+        const std::uint8_t* previous;
+        std::uint8_t* mask;
+        std::size_t size;
+        Filter filter;
+        Memory_Search::Width width;
+        std::uint16_t value;
+    };
+
+    /* avx2 build of narrow, returns 0 without touching anything when built without it, only call it when the cpu has avx2 */
+    std::size_t narrow_avx2 (const Args& args, std::size_t& count);
+
+    template <class V, bool wide, Filter filter>
+    typename V::reg test (const typename V::reg current, const typename V::reg previous, const typename V::reg value)
+    {
+        const auto eq = [] (const auto a, const auto b) {return wide ? V::eq16 (a, b) : V::eq8 (a, b);};
+        const auto gt = [] (const auto a, const auto b) {return wide ? V::gt16 (a, b) : V::gt8 (a, b);};
+
+        if constexpr (filter == Filter::equal)
+            return eq (current, value);
+        else if constexpr (filter == Filter::changed)
+            return V::andnot (eq (current, previous), V::ones ());
+        else if constexpr (filter == Filter::unchanged)
+            return eq (current, previous);
+        else if constexpr (filter == Filter::increased)
+            return gt (current, previous);
+        else if constexpr (filter == Filter::decreased)
+            return gt (previous, current);
+        else
+            return eq (current, wide ? V::add16 (previous, value) : V::add8 (previous, value));
+    }
+
+    template <class V, bool wide, Filter filter>
+    std::size_t narrow (const Args& args, std::size_t& count)
+    {
+        const auto value = wide ? V::set16 (args.value) : V::set8 (args.value);
+        const auto low_bytes = V::set16 (0x00FF);
+
+        // words starting at odd offsets come from a second load one byte on, which reads one byte further
+        const std::size_t reach = V::bytes + (wide ? 1 : 0);
+
+        std::size_t i = 0;
+        for (; i + reach <= args.size; i += V::bytes)
+        {
+            typename V::reg keep;
+            if constexpr (wide)
+            {
+                // each 16 bit lane is all ones or zero, the even result keeps its low byte
+                // and the odd result moves into the high byte so lanes map back onto addresses
+                const auto even = test <V, wide, filter> (V::load (args.current + i), V::load (args.previous + i), value);
+                const auto odd  = test <V, wide, filter> (V::load (args.current + i + 1), V::load (args.previous + i + 1), value);
+                keep = V::bor (V::band (even, low_bytes), V::shift_up8 (odd));
+            }
+            else
+                keep = test <V, wide, filter> (V::load (args.current + i), V::load (args.previous + i), value);
+
+            keep = V::band (keep, V::load (args.mask + i));
+            V::store (args.mask + i, keep);
+            count += V::popcount (V::movemask (keep));
+        }
+        return i;
+    }
+
+    template <class V, bool wide>
+    std::size_t narrow (const Args& args, std::size_t& count)
+    {
+        switch (args.filter)
+        {
+            case Filter::equal:        return narrow <V, wide, Filter::equal>        (args, count);
+            case Filter::changed:      return narrow <V, wide, Filter::changed>      (args, count);
+            case Filter::unchanged:    return narrow <V, wide, Filter::unchanged>    (args, count);
+            case Filter::increased:    return narrow <V, wide, Filter::increased>    (args, count);
+            case Filter::decreased:    return narrow <V, wide, Filter::decreased>    (args, count);
+            case Filter::increased_by: return narrow <V, wide, Filter::increased_by> (args, count);
+        }
+        return 0;
+    }
+
+    template <class V>
+    std::size_t narrow (const Args& args, std::size_t& count)
+    {
+        if (args.width == Memory_Search::Width::word)
+            return narrow <V, true> (args, count);
+        return narrow <V, false> (args, count);
+    }
+}
+
+#endif
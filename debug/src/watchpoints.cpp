@@ -0,0 +1,121 @@
+#include "watchpoints.h"
+#include "breakpoints.h"
+#include <array>
+
+Watchpoints::Watchpoints (Bus& _bus, Breakpoints& _breakpoints)
+: bus {_bus}
+, breakpoints {_breakpoints}
+, watches {}
+, hit {}
+, pending {false}
+{
+    bus.set_trap_handler ([this] (const auto access, const auto address, const auto old_value, const auto new_value)
+    {
+        on_trap (access, address, old_value, new_value);
+    });
+}
+
+Watchpoints::~Watchpoints ()
+{
+    bus.set_trap_handler ({});
+}
+
+void Watchpoints::add (const Range range)
+{
+    std::lock_guard lock (mu);
+    watches.push_back (range.begin <= range.end ? range : Range {range.end, range.begin, range.kind});
+    update_traps ();
+}
+
+void Watchpoints::remove (const std::size_t index)
+{
+    std::lock_guard lock (mu);
+    if (index >= watches.size())
+        return;
+    watches.erase (watches.begin() + index);
+    update_traps ();
+}
+
+void Watchpoints::clear ()
+{
+    std::lock_guard lock (mu);
+    watches.clear ();
+    hit.reset ();
+    pending.store (false, std::memory_order_relaxed);
+    update_traps ();
+}
+
+std::vector <Watchpoints::Range> Watchpoints::ranges () const
+{
+    std::lock_guard lock (mu);
+    return watches;
+}
+
+void Watchpoints::acknowledge (const std::uint16_t pc)
+{
+    std::lock_guard lock (mu);
+    if (hit)
+        hit->pc = pc;
+    pending.store (false, std::memory_order_relaxed);
+}
+
+std::optional <Watchpoints::Hit> Watchpoints::last_hit () const
+{
+    std::lock_guard lock (mu);
+    return hit;
+}
+
+void Watchpoints::on_trap (const Bus::Access access, const std::uint16_t address, const std::uint8_t old_value, const std::uint8_t new_value)
+{
+    // the page is trapped but this address might not be watched
+    const auto bit = access == Bus::Access::read ? Breakpoints::Kind::read : Breakpoints::Kind::write;
+    if (!breakpoints.test (bit, address))
+        return;
+
+    std::lock_guard lock (mu);
+    for (const auto& range : watches)
+    {
+        if (address < range.begin || address > range.end)
+            continue;
+
+        const bool matched = access == Bus::Access::read
+                           ? range.kind == Kind::read
+                           : range.kind == Kind::write || (range.kind == Kind::change && old_value != new_value);
+        if (!matched)
+            continue;
+
+        // keep the first hit of an instruction, the cpu thread stops after it finishes
+        if (!pending.load (std::memory_order_relaxed))
+        {
+            hit = Hit {range.kind, address, old_value, new_value, 0};
+            pending.store (true, std::memory_order_relaxed);
+        }
+        return;
+    }
+}
+
+void Watchpoints::update_traps ()
+{
+    std::array <bool, Bus::page_count> read_pages {};
+    std::array <bool, Bus::page_count> write_pages {};
+
+    breakpoints.clear (Breakpoints::Kind::read);
+    breakpoints.clear (Breakpoints::Kind::write);
+
+    for (const auto& range : watches)
+    {
+        const auto bit = range.kind == Kind::read ? Breakpoints::Kind::read : Breakpoints::Kind::write;
+        auto& pages = range.kind == Kind::read ? read_pages : write_pages;
+        for (std::uint32_t address = range.begin; address <= range.end; ++address)
+        {
+            breakpoints.set (bit, address, true);
+            pages[address >> 8] = true;
+        }
+    }
+
+    for (std::size_t page = 0; page < Bus::page_count; ++page)
+    {
+        bus.set_trap (page, Bus::watch_read, read_pages[page]);
+        bus.set_trap (page, Bus::watch_write, write_pages[page]);
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef FARM_H
+#define FARM_H
+
+#include <bitset>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+    headless runs of a rom until it reaches a trap address, jumps to itself, stops making progress
+    or uses up its cycles. one Farm_Job is one rom under one configuration
+*/
+struct Farm_Config
+{
+    std::string name = "default";
+    std::uint64_t cycle_budget = 100'000'000;
+    std::uint64_t irq_period = 0;
+    // instructions without a ram write while pc stays inside a few bytes before calling it a hang
+    std::uint64_t hang_window = 1'000'000;
+    std::bitset <0x10000> success;
+    std::bitset <0x10000> failure;
+};
+
+enum class Farm_Outcome : std::uint8_t
+{
+    passed,     // pc reached a success address
+    failed,     // pc reached a failure address
+    trapped,    // jumped to itself somewhere not listed
+    hung,       // tight loop with no ram writes for a whole hang window
+    budget,     // ran out of cycles
+    load_error,
+};
+
+struct Farm_Result
+{
+    std::filesystem::path rom;
+    std::string config;
+    Farm_Outcome outcome;
+    std::uint16_t pc;
+    std::uint64_t cycles;
+    std::uint64_t instructions;
+    double wall_ms;
+
+    /* without any success address a trap or a full budget is as good as it gets */
+    bool ok (const Farm_Config& config) const;
+};
+
+class Page_Pool;
+class Rom_Image;
+
+/* image is rom loaded once for every job that runs it, null counts as a load error */
+Farm_Result run_job (const std::filesystem::path& rom, std::shared_ptr <const Rom_Image> image,
+                     std::shared_ptr <Page_Pool> pool, const Farm_Config& config);
+
+const char* outcome_name (const Farm_Outcome outcome);
+
+/* one object per job plus totals */
+void write_json (std::ostream& output, const std::vector <Farm_Result>& results, const std::vector <Farm_Config>& configs,
+                 const std::size_t threads, const double wall_ms);
+
+#endif
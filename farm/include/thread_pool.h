@@ -0,0 +1,60 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    fixed set of workers, each with its own deque. a worker takes from the back of its own and
+    when that's empty steals from the front of the others, so a worker that drew short jobs
+    keeps busy with someone else's queue instead of idling
+*/
+class Thread_Pool
+{
+public:
+    using task_type = std::function <void(void)>;
+
+    /* 0 means one worker per hardware thread */
+    explicit Thread_Pool (std::size_t threads = 0);
+    ~Thread_Pool ();
+
+    Thread_Pool (const Thread_Pool&) = delete;
+    Thread_Pool& operator = (const Thread_Pool&) = delete;
+
+    void submit (task_type task);
+
+    /* blocks until every submitted task has finished */
+    void wait ();
+
+    std::size_t size () const {return workers.size();}
+
+private:
+    struct Queue
+    {
+        std::mutex mu;
+        std::deque <task_type> tasks;
+    };
+
+    std::vector <std::unique_ptr <Queue>> queues;
+    std::vector <std::thread> workers;
+    std::atomic <std::size_t> next_queue;
+
+    std::mutex mu;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    std::size_t queued;    // guarded by mu, submitted and not yet taken
+    std::size_t unfinished; // guarded by mu, submitted and not yet finished
+    bool stopping;
+
+    void worker (const std::size_t index);
+    bool take (const std::size_t index, task_type& task);
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "farm.h"
+#include "machine.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+
+namespace
+{
+    // a pc range this small with nothing written to ram is a program waiting on something that won't come
+    constexpr std::uint16_t hang_span = 0x40;
+
+    std::uint64_t ram_generations (const Bus& bus)
+    {
+        std::uint64_t sum = 0;
+        for (std::size_t page = 0; page < Bus::ram_pages; ++page)
+            sum += bus.generation (page);
+        return sum;
+    }
+
+    void write_string (std::ostream& output, const std::string& text)
+    {
+        output << '"';
+        for (const char c : text)
+        {
+            if (c == '"' || c == '\\')
+                output << '\\' << c;
+            else if (static_cast <unsigned char> (c) < 0x20)
+            {
+                char escaped[8];
+                std::snprintf (escaped, sizeof(escaped), "\\u%04x", c);
+                output << escaped;
+            }
+            else
+                output << c;
+        }
+        output << '"';
+    }
+}
+
+const char* outcome_name (const Farm_Outcome outcome)
+{
+    switch (outcome)
+    {
+        case Farm_Outcome::passed:     return "passed";
+        case Farm_Outcome::failed:     return "failed";
+        case Farm_Outcome::trapped:    return "trapped";
+        case Farm_Outcome::hung:       return "hung";
+        case Farm_Outcome::budget:     return "budget";
+        case Farm_Outcome::load_error: return "load_error";
+    }
+    return "unknown";
+}
+
+bool Farm_Result::ok (const Farm_Config& config) const
+{
+    if (outcome == Farm_Outcome::passed)
+        return true;
+    return config.success.none() && (outcome == Farm_Outcome::trapped || outcome == Farm_Outcome::budget);
+}
+
+Farm_Result run_job (const std::filesystem::path& rom, std::shared_ptr <const Rom_Image> image,
+                     std::shared_ptr <Page_Pool> pool, const Farm_Config& config)
+{
+    const auto begin = std::chrono::steady_clock::now();
+    Farm_Result result {rom, config.name, Farm_Outcome::budget, 0, 0, 0, 0};
+
+    // on the heap, a machine carries its page caches around with it
+    const bool loaded = image != nullptr;
+    auto machine = std::make_unique <Machine> (std::move (image), std::move (pool));
+    machine->set_irq_period (config.irq_period);
+    machine->set_idle_skip (true);
+    if (!loaded)
+        result.outcome = Farm_Outcome::load_error;
+    else
+    {
+        MOS_6502::CPU& cpu = machine->cpu;
+        std::uint64_t window_end = config.hang_window;
+        std::uint64_t window_writes = ram_generations (machine->bus);
+        std::uint16_t low = cpu.get_PC();
+        std::uint16_t high = low;
+
+        while (machine->cycles() < config.cycle_budget)
+        {
+            const std::uint16_t pc = cpu.get_PC();
+            machine->step ();
+            const std::uint16_t next = cpu.get_PC();
+
+            // every pc of the loop was checked on the turn that proved it, the rest are the same turn again
+            if (machine->idle ())
+                machine->skip_idle (config.cycle_budget);
+
+            if (config.success[next])
+            {
+                result.outcome = Farm_Outcome::passed;
+                break;
+            }
+            if (config.failure[next])
+            {
+                result.outcome = Farm_Outcome::failed;
+                break;
+            }
+            if (next == pc)
+            {
+                result.outcome = Farm_Outcome::trapped;
+                break;
+            }
+
+            low = std::min (low, next);
+            high = std::max (high, next);
+            if (config.hang_window != 0 && machine->instructions() >= window_end)
+            {
+                const std::uint64_t writes = ram_generations (machine->bus);
+                if (writes == window_writes && high - low < hang_span)
+                {
+                    result.outcome = Farm_Outcome::hung;
+                    break;
+                }
+                window_end = machine->instructions() + config.hang_window;
+                window_writes = writes;
+                low = high = next;
+            }
+        }
+        result.pc = cpu.get_PC();
+        result.cycles = machine->cycles();
+        result.instructions = machine->instructions();
+    }
+
+    result.wall_ms = std::chrono::duration <double, std::milli> (std::chrono::steady_clock::now() - begin).count();
+    return result;
+}
+
+void write_json (std::ostream& output, const std::vector <Farm_Result>& results, const std::vector <Farm_Config>& configs,
+                 const std::size_t threads, const double wall_ms)
+{
+    std::size_t ok = 0;
+    std::uint64_t cycles = 0;
+    output << "{\n  \"jobs\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const auto& result = results[i];
+        const auto config = std::ranges::find (configs, result.config, &Farm_Config::name);
+        const bool passed = config != configs.end() && result.ok (*config);
+        ok += passed;
+        cycles += result.cycles;
+
+        char numbers[160];
+        std::snprintf (numbers, sizeof(numbers), "\"pc\": \"%04X\", \"cycles\": %llu, \"instructions\": %llu, \"wall_ms\": %.3f",
+                       result.pc, static_cast <unsigned long long> (result.cycles),
+                       static_cast <unsigned long long> (result.instructions), result.wall_ms);
+
+        output << "    {\"rom\": ";
+        write_string (output, result.rom.string());
+        output << ", \"config\": ";
+        write_string (output, result.config);
+        output << ", \"result\": \"" << outcome_name (result.outcome) << "\", \"ok\": " << (passed ? "true" : "false")
+               << ", " << numbers << '}' << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+
+    char totals[200];
+    std::snprintf (totals, sizeof(totals), "  \"total\": %zu,\n  \"ok\": %zu,\n  \"cycles\": %llu,\n  \"threads\": %zu,\n  \"wall_ms\": %.3f\n",
+                   results.size(), ok, static_cast <unsigned long long> (cycles), threads, wall_ms);
+    output << "  ],\n" << totals << "}\n";
+}
@@ -0,0 +1,210 @@
+#include "debug_server.h"
+#include "farm.h"
+#include "machine.h"
+#include "page_pool.h"
+#include "rom_image.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+    farm [options] <rom or directory>...
+
+    --threads N          workers, default one per hardware thread
+    --cycles N[,N...]    cycle budgets
+    --irq-period N[,N..] periodic irq every N cycles, 0 for none
+    --success ADDR[,..]  hex addresses that mean the rom passed
+    --failure ADDR[,..]  hex addresses that mean it failed
+    --hang N             instructions without progress before calling it hung, 0 turns it off
+    --output FILE        json goes here instead of stdout
+    --serve ADDRESS      instead of running jobs, serve the first rom under the first config to a debugger
+                         (unix socket path or [host:]port, see debug_protocol.h) until one sends quit
+
+    every rom runs once per combination of cycle budget and irq period. exits 1 if any job isn't ok
+*/
+
+namespace
+{
+    std::vector <std::uint64_t> parse_list (std::string_view text, const int base, bool& valid)
+    {
+        std::vector <std::uint64_t> values;
+        while (!text.empty())
+        {
+            const auto comma = text.find (',');
+            const std::string item (text.substr (0, comma));
+            char* end = nullptr;
+            values.push_back (std::strtoull (item.c_str(), &end, base));
+            valid = valid && !item.empty() && *end == '\0';
+            text = comma == std::string_view::npos ? std::string_view {} : text.substr (comma + 1);
+        }
+        return values;
+    }
+
+    // options that take one number, an empty argument or a list is invalid
+    std::uint64_t parse_value (std::string_view text, const int base, bool& valid)
+    {
+        const auto values = parse_list (text, base, valid);
+        valid = valid && values.size() == 1;
+        return values.empty() ? 0 : values.front();
+    }
+
+    // directories contribute their regular files in name order so job order is stable between runs
+    void add_roms (const std::filesystem::path& path, std::vector <std::filesystem::path>& roms)
+    {
+        std::error_code error;
+        if (!std::filesystem::is_directory (path, error))
+        {
+            roms.push_back (path);
+            return;
+        }
+        std::vector <std::filesystem::path> found;
+        for (const auto& entry : std::filesystem::directory_iterator (path, error))
+        {
+            std::error_code file_error;
+            if (entry.is_regular_file (file_error) && entry.path().filename().string().front() != '.')
+                found.push_back (entry.path());
+        }
+        std::ranges::sort (found);
+        roms.insert (roms.end(), found.begin(), found.end());
+    }
+
+    int usage ()
+    {
+        std::cerr << "usage: farm [--threads N] [--cycles N,..] [--irq-period N,..] [--success ADDR,..] [--failure ADDR,..]"
+                     " [--hang N] [--output FILE] [--serve ADDRESS] <rom or directory>..." << std::endl;
+        return 2;
+    }
+
+    int serve (const std::filesystem::path& rom, const Farm_Config& config, const std::string& address)
+    {
+        Machine machine;
+        if (!machine.load_rom (rom.string()))
+            return 2;
+        machine.set_irq_period (config.irq_period);
+        machine.set_idle_skip (true);
+
+        Debug_Server server (machine);
+        if (!server.listen (address))
+            return 2;
+        std::cerr << "serving " << rom.string() << " (" << config.name << ") on " << address << std::endl;
+        return server.serve () ? 0 : 2;
+    }
+}
+
+int main (int argc, char** argv)
+{
+    std::size_t threads = 0;
+    std::vector <std::uint64_t> budgets {Farm_Config {}.cycle_budget};
+    std::vector <std::uint64_t> periods {0};
+    std::vector <std::uint64_t> success;
+    std::vector <std::uint64_t> failure;
+    std::uint64_t hang_window = Farm_Config {}.hang_window;
+    std::string output_path;
+    std::string serve_address;
+    std::vector <std::filesystem::path> roms;
+
+    bool valid = true;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view argument = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (argument == "--threads" && has_value)
+            threads = parse_value (argv[++i], 10, valid);
+        else if (argument == "--cycles" && has_value)
+            budgets = parse_list (argv[++i], 10, valid);
+        else if (argument == "--irq-period" && has_value)
+            periods = parse_list (argv[++i], 10, valid);
+        else if (argument == "--success" && has_value)
+            success = parse_list (argv[++i], 16, valid);
+        else if (argument == "--failure" && has_value)
+            failure = parse_list (argv[++i], 16, valid);
+        else if (argument == "--hang" && has_value)
+            hang_window = parse_value (argv[++i], 10, valid);
+        else if (argument == "--output" && has_value)
+            output_path = argv[++i];
+        else if (argument == "--serve" && has_value)
+            serve_address = argv[++i];
+        else if (argument.starts_with ("--"))
+            return usage ();
+        else
+            add_roms (argument, roms);
+    }
+    const auto out_of_range = [] (const std::uint64_t address) {return address > 0xFFFF;};
+    if (!valid || roms.empty() || budgets.empty() || periods.empty()
+        || std::ranges::any_of (success, out_of_range) || std::ranges::any_of (failure, out_of_range))
+        return usage ();
+
+    std::vector <Farm_Config> configs;
+    for (const auto budget : budgets)
+    {
+        for (const auto period : periods)
+        {
+            Farm_Config config;
+            config.name = "cycles=" + std::to_string (budget) + " irq=" + std::to_string (period);
+            config.cycle_budget = budget;
+            config.irq_period = period;
+            config.hang_window = hang_window;
+            for (const auto address : success)
+                config.success.set (address);
+            for (const auto address : failure)
+                config.failure.set (address);
+            configs.push_back (std::move (config));
+        }
+    }
+
+    if (!serve_address.empty())
+        return serve (roms.front(), configs.front(), serve_address);
+
+    // every config of a rom runs the same image and all the machines take their ram from one pool
+    std::vector <std::shared_ptr <const Rom_Image>> images;
+    for (const auto& rom : roms)
+        images.push_back (Rom_Image::load (rom.string(), 0x8000));
+    const auto pages = std::make_shared <Page_Pool> ();
+
+    // each job writes its own slot so the report keeps submission order whatever order they finish in
+    std::vector <Farm_Result> results (roms.size() * configs.size());
+    const auto begin = std::chrono::steady_clock::now();
+    std::size_t workers = 0;
+    {
+        Thread_Pool pool (threads);
+        workers = pool.size();
+        for (std::size_t r = 0; r < roms.size(); ++r)
+        {
+            for (std::size_t c = 0; c < configs.size(); ++c)
+            {
+                pool.submit ([&results, &roms, &images, &pages, &configs, r, c, slot = r * configs.size() + c] ()
+                {
+                    results[slot] = run_job (roms[r], images[r], pages, configs[c]);
+                });
+            }
+        }
+        pool.wait ();
+    }
+    const double wall_ms = std::chrono::duration <double, std::milli> (std::chrono::steady_clock::now() - begin).count();
+
+    if (output_path.empty())
+        write_json (std::cout, results, configs, workers, wall_ms);
+    else
+    {
+        std::ofstream output (output_path);
+        if (!output.is_open())
+        {
+            std::cerr << output_path << " could not be written" << std::endl;
+            return 2;
+        }
+        write_json (output, results, configs, workers, wall_ms);
+    }
+
+    const bool all_ok = std::ranges::all_of (results, [&configs] (const Farm_Result& result)
+    {
+        return result.ok (*std::ranges::find (configs, result.config, &Farm_Config::name));
+    });
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+Thread_Pool::Thread_Pool (std::size_t threads)
+: queues {}
+, workers {}
+, next_queue {0}
+, mu {}
+, work_cv {}
+, done_cv {}
+, queued {0}
+, unfinished {0}
+, stopping {false}
+{
+    if (threads == 0)
+        threads = std::max (1u, std::thread::hardware_concurrency ());
+
+    for (std::size_t i = 0; i < threads; ++i)
+        queues.push_back (std::make_unique <Queue> ());
+    for (std::size_t i = 0; i < threads; ++i)
+        workers.emplace_back (&Thread_Pool::worker, this, i);
+}
+
+Thread_Pool::~Thread_Pool ()
+{
+    {
+        std::lock_guard lock (mu);
+        stopping = true;
+    }
+    work_cv.notify_all ();
+    for (auto& thread : workers)
+        thread.join ();
+}
+
+void Thread_Pool::submit (task_type task)
+{
+    // spread new work round robin, stealing evens out whatever that gets wrong
+    Queue& queue = *queues[next_queue.fetch_add (1, std::memory_order_relaxed) % queues.size()];
+    {
+        std::lock_guard lock (queue.mu);
+        queue.tasks.push_back (std::move (task));
+    }
+    {
+        std::lock_guard lock (mu);
+        ++queued;
+        ++unfinished;
+    }
+    work_cv.notify_one ();
+}
+
+void Thread_Pool::wait ()
+{
+    std::unique_lock lock (mu);
+    done_cv.wait (lock, [this] () {return unfinished == 0;});
+}
+
+bool Thread_Pool::take (const std::size_t index, task_type& task)
+{
+    {
+        Queue& own = *queues[index];
+        std::lock_guard lock (own.mu);
+        if (!own.tasks.empty())
+        {
+            task = std::move (own.tasks.back());
+            own.tasks.pop_back ();
+            return true;
+        }
+    }
+    for (std::size_t i = 1; i < queues.size(); ++i)
+    {
+        Queue& victim = *queues[(index + i) % queues.size()];
+        std::lock_guard lock (victim.mu);
+        if (!victim.tasks.empty())
+        {
+            task = std::move (victim.tasks.front());
+            victim.tasks.pop_front ();
+            return true;
+        }
+    }
+    return false;
+}
+
+void Thread_Pool::worker (const std::size_t index)
+{
+    for (;;)
+    {
+        {
+            std::unique_lock lock (mu);
+            work_cv.wait (lock, [this] () {return stopping || queued != 0;});
+            if (queued == 0)
+                return;
+            // claimed here so a task is only ever counted by the worker that ends up running it
+            --queued;
+        }
+
+        // the claim guarantees a task is sitting in one of the queues
+        task_type task;
+        while (!take (index, task))
+            std::this_thread::yield ();
+        task ();
+
+        std::lock_guard lock (mu);
+        if (--unfinished == 0)
+            done_cv.notify_all ();
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef LIB6502_H
+#define LIB6502_H
+
+/*
+    c interface to the emulator core for test harnesses and other programs that embed it
+    a machine is an opaque handle, everything crosses the boundary as plain c types and nothing throws.
+    calls that can fail return L6502_OK or L6502_ERROR and say why on stderr
+    a machine belongs to one thread at a time, different machines can run on different threads
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define L6502_API __attribute__((visibility("default")))
+#else
+#define L6502_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* bumped whenever a declaration here changes in a way old callers would notice */
+#define L6502_ABI_VERSION 1
+
+#define L6502_OK     0
+#define L6502_ERROR -1
+
+typedef struct l6502_machine l6502_machine;
+
+typedef struct l6502_registers
+{
+    uint16_t pc;
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t sr;
+    uint8_t sp;
+} l6502_registers;
+
+/* why run_for came back */
+typedef enum l6502_stop
+{
+    L6502_STOP_BUDGET   = 0, /* used up the cycles it was given */
+    L6502_STOP_ADDRESS  = 1, /* pc reached a stop address */
+    L6502_STOP_CALLBACK = 2, /* an access callback asked to stop */
+    L6502_STOP_IDLE     = 3, /* waiting on an interrupt nothing is going to raise */
+} l6502_stop;
+
+/* flags for watch */
+#define L6502_READ  1u
+#define L6502_WRITE 2u
+
+/*
+    called from inside run_for for every watched access, after it happened. for reads old_value == new_value
+    return nonzero to stop the run once the current instruction is done
+*/
+typedef int (*l6502_access_cb) (void* user, unsigned access, uint16_t address, uint8_t old_value, uint8_t new_value);
+
+L6502_API int l6502_abi_version (void);
+
+/* an empty machine, no rom and zeroed ram. null if it couldn't be made */
+L6502_API l6502_machine* l6502_create (void);
+L6502_API void l6502_destroy (l6502_machine* machine);
+
+/*
+    rom at $8000 and a reset, ram is cleared. images over 32kb are banked in 16kb banks as the gui does it,
+    files can be raw binaries, intel hex or s-records
+*/
+L6502_API int l6502_load_rom_file (l6502_machine* machine, const char* path);
+L6502_API int l6502_load_rom (l6502_machine* machine, const uint8_t* image, size_t size);
+
+/* cpu reset, counters cleared, memory left alone */
+L6502_API void l6502_reset (l6502_machine* machine);
+
+/*
+    runs at least cycles cycles unless it stops first, cycles_run (may be null) gets what was actually run
+    loops that provably only wait for an interrupt are skipped over, see set_idle_skip
+*/
+L6502_API l6502_stop l6502_run_for (l6502_machine* machine, uint64_t cycles, uint64_t* cycles_run);
+
+/* one instruction, taking a pending interrupt first, returns its cycles */
+L6502_API int l6502_step (l6502_machine* machine);
+
+/* on by default, watch callbacks for reads in skipped turns of an idle loop don't fire */
+L6502_API void l6502_set_idle_skip (l6502_machine* machine, int enabled);
+
+L6502_API uint64_t l6502_cycles (const l6502_machine* machine);
+L6502_API uint64_t l6502_instructions (const l6502_machine* machine);
+
+/* the whole 64kb address space as the cpu sees it, rom included. address + size can't pass $FFFF */
+L6502_API int l6502_read (const l6502_machine* machine, uint16_t address, uint8_t* out, size_t size);
+L6502_API int l6502_write (l6502_machine* machine, uint16_t address, const uint8_t* data, size_t size);
+
+/*
+    puts an image into memory at address a whole page at a time, bytes of the first and last page outside it
+    are kept. faster than write for anything big and every page changes in one go. fails on a page with
+    nothing behind it (rom space with no rom loaded), the pages before it are already mapped by then
+*/
+L6502_API int l6502_map (l6502_machine* machine, uint16_t address, const uint8_t* image, size_t size);
+
+L6502_API void l6502_get_registers (const l6502_machine* machine, l6502_registers* registers);
+L6502_API void l6502_set_registers (l6502_machine* machine, const l6502_registers* registers);
+
+L6502_API void l6502_irq (l6502_machine* machine);
+L6502_API void l6502_nmi (l6502_machine* machine);
+
+/* periodic irq every period cycles, 0 turns it off */
+L6502_API void l6502_set_irq_period (l6502_machine* machine, uint64_t period);
+
+/* run_for stops after the instruction that lands on address */
+L6502_API void l6502_stop_at (l6502_machine* machine, uint16_t address, int enabled);
+
+/* calls callback for accesses to first..last (inclusive) of the kinds in access, 0 stops watching them */
+L6502_API void l6502_watch (l6502_machine* machine, uint16_t first, uint16_t last, unsigned access);
+L6502_API void l6502_set_access_callback (l6502_machine* machine, l6502_access_cb callback, void* user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,245 @@
+#include "lib6502.h"
+#include "machine.h"
+#include <bitset>
+#include <exception>
+#include <iostream>
+
+struct l6502_machine
+{
+    Machine machine;
+    std::bitset <0x10000> stops;
+    std::bitset <0x10000> read_watches;
+    std::bitset <0x10000> write_watches;
+    l6502_access_cb callback = nullptr;
+    void* user = nullptr;
+    bool stop_requested = false;
+};
+
+namespace
+{
+    // bus traps are per page, the watch bits pick out the addresses inside them
+    void update_traps (l6502_machine& handle, const std::uint16_t first, const std::uint16_t last)
+    {
+        for (std::size_t page = first >> 8; page <= static_cast <std::size_t> (last >> 8); ++page)
+        {
+            bool reads = false;
+            bool writes = false;
+            for (std::size_t address = page * Bus::page_size; address < (page + 1) * Bus::page_size; ++address)
+            {
+                reads = reads || handle.read_watches[address];
+                writes = writes || handle.write_watches[address];
+            }
+            handle.machine.bus.set_trap (page, Bus::watch_read, reads);
+            handle.machine.bus.set_trap (page, Bus::watch_write, writes);
+        }
+    }
+
+    bool in_range (const std::uint16_t address, const std::size_t size, const char* function)
+    {
+        if (address + size <= 0x10000)
+            return true;
+        std::cerr << function << ": range runs past $FFFF" << std::endl;
+        return false;
+    }
+}
+
+int l6502_abi_version (void)
+{
+    return L6502_ABI_VERSION;
+}
+
+l6502_machine* l6502_create (void)
+{
+    try
+    {
+        auto* handle = new l6502_machine {};
+        handle->machine.set_idle_skip (true);
+        handle->machine.bus.set_trap_handler ([handle] (const Bus::Access access, const std::uint16_t address, const std::uint8_t old_value, const std::uint8_t new_value)
+        {
+            const bool read = access == Bus::Access::read;
+            if (!handle->callback || !(read ? handle->read_watches[address] : handle->write_watches[address]))
+                return;
+            if (handle->callback (handle->user, read ? L6502_READ : L6502_WRITE, address, old_value, new_value) != 0)
+                handle->stop_requested = true;
+        });
+        return handle;
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << "l6502_create: " << error.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void l6502_destroy (l6502_machine* machine)
+{
+    delete machine;
+}
+
+int l6502_load_rom_file (l6502_machine* machine, const char* path)
+{
+    try
+    {
+        return path != nullptr && machine->machine.load_rom (std::string (path)) ? L6502_OK : L6502_ERROR;
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << "l6502_load_rom_file: " << error.what() << std::endl;
+        return L6502_ERROR;
+    }
+}
+
+int l6502_load_rom (l6502_machine* machine, const uint8_t* image, size_t size)
+{
+    try
+    {
+        return image != nullptr && machine->machine.load_rom (std::span (image, size)) ? L6502_OK : L6502_ERROR;
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << "l6502_load_rom: " << error.what() << std::endl;
+        return L6502_ERROR;
+    }
+}
+
+void l6502_reset (l6502_machine* machine)
+{
+    machine->machine.reset ();
+}
+
+l6502_stop l6502_run_for (l6502_machine* machine, uint64_t cycles, uint64_t* cycles_run)
+{
+    Machine& m = machine->machine;
+    const std::uint64_t start = m.cycles ();
+    const std::uint64_t limit = start + cycles;
+    l6502_stop reason = L6502_STOP_BUDGET;
+
+    machine->stop_requested = false;
+    while (m.cycles () < limit)
+    {
+        m.step ();
+        if (machine->stop_requested)
+        {
+            reason = L6502_STOP_CALLBACK;
+            break;
+        }
+        if (machine->stops[m.cpu.get_PC ()])
+        {
+            reason = L6502_STOP_ADDRESS;
+            break;
+        }
+        if (m.idle ())
+        {
+            // only an irq or nmi from the caller could get it out, no point running out the budget
+            if (m.next_event () == UINT64_MAX)
+            {
+                reason = L6502_STOP_IDLE;
+                break;
+            }
+            m.skip_idle (limit);
+        }
+    }
+
+    if (cycles_run != nullptr)
+        *cycles_run = m.cycles () - start;
+    return reason;
+}
+
+int l6502_step (l6502_machine* machine)
+{
+    return machine->machine.step ();
+}
+
+void l6502_set_idle_skip (l6502_machine* machine, int enabled)
+{
+    machine->machine.set_idle_skip (enabled != 0);
+}
+
+uint64_t l6502_cycles (const l6502_machine* machine)
+{
+    return machine->machine.cycles ();
+}
+
+uint64_t l6502_instructions (const l6502_machine* machine)
+{
+    return machine->machine.instructions ();
+}
+
+int l6502_read (const l6502_machine* machine, uint16_t address, uint8_t* out, size_t size)
+{
+    if (!in_range (address, size, "l6502_read"))
+        return L6502_ERROR;
+    for (std::size_t i = 0; i < size; ++i)
+        out[i] = machine->machine.bus.peek (address + i);
+    return L6502_OK;
+}
+
+int l6502_write (l6502_machine* machine, uint16_t address, const uint8_t* data, size_t size)
+{
+    if (!in_range (address, size, "l6502_write"))
+        return L6502_ERROR;
+    for (std::size_t i = 0; i < size; ++i)
+        machine->machine.poke (address + i, data[i]);
+    return L6502_OK;
+}
+
+int l6502_map (l6502_machine* machine, uint16_t address, const uint8_t* image, size_t size)
+{
+    if (image == nullptr || !in_range (address, size, "l6502_map"))
+        return L6502_ERROR;
+    if (!machine->machine.map (address, std::span (image, size)))
+    {
+        std::cerr << "l6502_map: part of the range has no memory behind it" << std::endl;
+        return L6502_ERROR;
+    }
+    return L6502_OK;
+}
+
+void l6502_get_registers (const l6502_machine* machine, l6502_registers* registers)
+{
+    const MOS_6502::Registers r = machine->machine.cpu.get_registers ();
+    *registers = {r.PC, r.AC, r.XR, r.YR, r.SR, r.SP};
+}
+
+void l6502_set_registers (l6502_machine* machine, const l6502_registers* registers)
+{
+    machine->machine.set_registers ({registers->pc, registers->a, registers->x, registers->y, registers->sr, registers->sp});
+}
+
+void l6502_irq (l6502_machine* machine)
+{
+    machine->machine.raise_irq ();
+}
+
+void l6502_nmi (l6502_machine* machine)
+{
+    machine->machine.raise_nmi ();
+}
+
+void l6502_set_irq_period (l6502_machine* machine, uint64_t period)
+{
+    machine->machine.set_irq_period (period);
+}
+
+void l6502_stop_at (l6502_machine* machine, uint16_t address, int enabled)
+{
+    machine->stops[address] = enabled != 0;
+}
+
+void l6502_watch (l6502_machine* machine, uint16_t first, uint16_t last, unsigned access)
+{
+    if (first > last)
+        return;
+    for (std::size_t address = first; address <= last; ++address)
+    {
+        machine->read_watches[address] = (access & L6502_READ) != 0;
+        machine->write_watches[address] = (access & L6502_WRITE) != 0;
+    }
+    update_traps (*machine, first, last);
+}
+
+void l6502_set_access_callback (l6502_machine* machine, l6502_access_cb callback, void* user)
+{
+    machine->callback = callback;
+    machine->user = user;
+}
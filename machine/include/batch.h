@@ -0,0 +1,105 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "machine.h"
+#include "mos6502.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/*
+    many copies of one program stepped in lock-step, for fuzzing and parameter sweeps
+    registers are kept as one array per register and ram as one column per lane (address * lanes + lane),
+    so lanes running the same instruction on the same address touch neighbouring bytes and an instruction
+    becomes a few passes over plain arrays that compile to sse2, avx2 or avx-512 (picked at run time)
+
+    while pcs agree every lane runs together. once they split the lanes at the lowest pc go first and the
+    rest wait for them to catch up, a group too small to be worth a vector pass is peeled off to the scalar
+    core until it reaches the others. code running from ram always takes the scalar core
+
+    rom is the one mapped when the batch was made and is read only, writes above $7FFF are dropped so a
+    banked rom stays on that bank. there are no interrupts
+*/
+class Batch
+{
+public:
+    /* lane storage is padded to a multiple of this, the widest vector is 64 bytes */
+    static constexpr std::size_t lane_block = 64;
+
+    struct Stats
+    {
+        std::uint64_t vector_steps;      // group instructions run on the vector path
+        std::uint64_t vector_lane_steps; // lane instructions they covered
+        std::uint64_t scalar_steps;      // lane instructions run on the scalar core
+    };
+
+    /* every lane starts as a copy of machine's ram, registers and counters */
+    Batch (const Machine& machine, const std::size_t lane_count);
+
+    Batch (const Batch&) = delete;
+    Batch& operator = (const Batch&) = delete;
+
+    std::size_t lanes () const {return count;}
+
+    MOS_6502::Registers get_registers (const std::size_t lane) const;
+    void set_registers (const std::size_t lane, const MOS_6502::Registers& registers);
+
+    std::uint8_t peek (const std::size_t lane, const std::uint16_t address) const;
+    void poke (const std::size_t lane, const std::uint16_t address, const std::uint8_t value);
+
+    std::uint64_t cycles       (const std::size_t lane) const {return cycle_counts[lane];}
+    std::uint64_t instructions (const std::size_t lane) const {return instruction_counts[lane];}
+
+    /* a lane whose pc lands on a stop address stops there for good */
+    void stop_at (const std::uint16_t address);
+    bool stopped (const std::size_t lane) const {return halted[lane] != 0;}
+
+    /* groups of this many lanes or fewer go to the scalar core */
+    void set_peel_threshold (const std::size_t lanes) {peel_threshold = lanes;}
+
+    /* runs every lane that hasn't stopped for at least budget more cycles, or until it stops */
+    void run (const std::uint64_t budget);
+
+    const Stats& stats () const {return counters;}
+
+private:
+    std::size_t count;
+    std::size_t padded;
+
+    std::array <std::uint8_t, 0x8000> rom;
+    std::vector <std::uint8_t> ram;
+
+    std::vector <std::uint16_t> pc;
+    std::vector <std::uint8_t> ac;
+    std::vector <std::uint8_t> xr;
+    std::vector <std::uint8_t> yr;
+    std::vector <std::uint8_t> sr;
+    std::vector <std::uint8_t> sp;
+    std::vector <std::uint64_t> cycle_counts;
+    std::vector <std::uint64_t> instruction_counts;
+    std::vector <std::uint64_t> cycle_limits;
+    std::vector <std::uint8_t> halted;
+
+    // 0xFF / 0x00 masks and scratch for the kernel
+    std::vector <std::uint8_t> active;
+    std::vector <std::uint8_t> group;
+    std::vector <std::uint16_t> address;
+    std::vector <std::uint8_t> data;
+    std::vector <std::uint8_t> extra;
+
+    std::vector <std::uint8_t> stops; // 64k flags, empty until the first stop_at
+    std::size_t peel_threshold;
+    Stats counters;
+
+    // one scalar core shared by every peeled lane, its bus is whichever lane scalar_lane names
+    std::size_t scalar_lane;
+    MOS_6502::CPU scalar;
+
+    /* runs lane on the scalar core until its pc reaches target or beyond, it leaves the run, or limit instructions pass */
+    void peel (const std::size_t lane, const std::uint32_t target, const std::size_t limit);
+
+    /* false and the lane leaves the run if it's out of cycles or sitting on a stop address */
+    bool keep_running (const std::size_t lane);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef CHECKPOINTS_H
+#define CHECKPOINTS_H
+
+#include "machine.h"
+#include "save_state.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+/*
+    bounded ring of save states taken every interval cycles, seeking restores the nearest earlier
+    one and runs forward so a seek never re-executes more than about interval cycles however long
+    the program has been going. the oldest checkpoint falls off when the ring is full
+
+    update and seek belong to the thread running the machine, the range getters can be read from anywhere
+*/
+class Checkpoints
+{
+public:
+    static constexpr std::size_t default_capacity = 256;
+    static constexpr std::uint64_t default_interval = 1'000'000;
+
+    Checkpoints (const std::size_t _capacity = default_capacity, const std::uint64_t _interval = default_interval);
+
+    /*
+        after every instruction, only does work once interval cycles have passed
+        the machine going backwards (a reset, rom change or save state load) drops the checkpoints it left behind
+    */
+    void update (Machine& machine)
+    {
+        const std::uint64_t cycles = machine.cycles ();
+        if (cycles >= next_cycle || cycles < last_cycle)
+            take (machine);
+        const std::uint64_t instructions = machine.instructions ();
+        position.store (instructions, std::memory_order_relaxed);
+        if (instructions > furthest.load(std::memory_order_relaxed))
+            furthest.store (instructions, std::memory_order_relaxed);
+    }
+
+    /*
+        stops at the first instruction boundary at or after the target. false if it's before the oldest checkpoint
+        or past the furthest the machine has run (more than an interval past the newest one for cycles), which
+        would mean running open ended
+    */
+    bool seek_instruction (Machine& machine, const std::uint64_t instruction);
+    bool seek_cycle (Machine& machine, const std::uint64_t cycle);
+
+    void clear ();
+
+    /* the instructions that can be reached, first is the oldest checkpoint and last the furthest the machine has run */
+    std::uint64_t first () const {return oldest.load(std::memory_order_relaxed);}
+    std::uint64_t last () const {return furthest.load(std::memory_order_relaxed);}
+    std::uint64_t current () const {return position.load(std::memory_order_relaxed);}
+
+    /* the cycle the next checkpoint is due at, idle skips stop short of it so it's taken on time */
+    std::uint64_t next_cycle_due () const {return next_cycle;}
+
+    std::size_t count () const;
+    std::size_t memory () const;
+
+private:
+    const std::size_t capacity;
+    const std::uint64_t interval;
+
+    mutable std::mutex mu; // only count and memory take it from another thread
+    std::deque <Save_State> states;
+    std::uint64_t next_cycle;
+    std::uint64_t last_cycle;
+    std::atomic <std::uint64_t> oldest;
+    std::atomic <std::uint64_t> furthest;
+    std::atomic <std::uint64_t> position;
+
+    void take (Machine& machine);
+
+    template <typename Key>
+    bool seek (Machine& machine, const std::uint64_t target, Key key);
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef HASH_TRACE_H
+#define HASH_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+class Machine;
+
+/*
+    Machine::state_hash sampled every interval instructions, on multiples of the interval so two runs
+    line up sample for sample. compare two traces to find the window a divergence is in, then
+    find_divergence narrows it to the instruction
+
+    update belongs to the thread running the machine
+*/
+class Hash_Trace
+{
+public:
+    struct Sample
+    {
+        std::uint64_t instruction;
+        std::uint64_t hash;
+    };
+
+    /* 0 stops sampling, the samples so far are kept */
+    void set_interval (const std::uint64_t _interval);
+    std::uint64_t get_interval () const {return interval;}
+
+    /* the instruction count update samples at next, for Machine::skip_idle to stop short of */
+    std::uint64_t next_sample () const {return interval == 0 ? UINT64_MAX : next;}
+
+    void update (Machine& machine);
+    void clear ();
+
+    const std::vector <Sample>& samples () const {return taken;}
+    std::size_t count () const {return sample_count.load(std::memory_order_relaxed);}
+
+    /* the first instruction both traces sampled and disagree on, nullopt if they agree as far as both go */
+    static std::optional <std::uint64_t> first_mismatch (const Hash_Trace& a, const Hash_Trace& b);
+
+    bool write (const std::filesystem::path& path) const;
+    bool read (const std::filesystem::path& path);
+
+private:
+    std::uint64_t interval = 0;
+    std::uint64_t next = 0;
+    std::vector <Sample> taken;
+    std::atomic <std::size_t> sample_count {0};
+};
+
+/*
+    a and b have to be at the same instruction with equal hashes and run deterministically from there
+    (replays, or loads of the same state with different patches). bisects with save states down to the
+    first instruction, at most end, after which the hashes differ. both machines are left just past it
+*/
+std::optional <std::uint64_t> find_divergence (Machine& a, Machine& b, const std::uint64_t end);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+#include "save_state.h"
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+class Machine;
+
+/*
+    everything from outside the cpu that changed a run: interrupts raised by hand, edits made from
+    the debugger and rom patches, each stamped with the instruction and cycle it landed before.
+    together with the state the recording started from that's enough to run it again bit for bit
+
+    events are packed as varint deltas, a few bytes each
+        [instruction delta] [cycle delta] [kind] [address]? [value]?
+    replay goes by the instruction count, an illegal opcode takes 0 cycles so a cycle count doesn't
+    always name one point between instructions, the cycles are checked to catch a divergence
+*/
+class Input_Log
+{
+public:
+    enum class Kind : std::uint8_t
+    {
+        irq,
+        nmi,
+        poke,      // a byte written through the bus from outside the cpu
+        rom_patch, // a byte changed in the rom image, for banked roms that don't line up with the bus
+    };
+
+    struct Event
+    {
+        std::uint64_t instruction;
+        std::uint64_t cycle;
+        Kind kind;
+        std::uint32_t address;
+        std::uint8_t value;
+    };
+
+    /* snapshots the machine, logging starts from here */
+    void begin (Machine& machine);
+    /* where the run stopped, replay runs up to here */
+    void finish (const Machine& machine);
+
+    void append (const Event& event);
+
+    bool recording () const {return started && !finished;}
+    bool empty () const {return !started;}
+    std::size_t count () const {return event_count;}
+    std::size_t size () const {return events.size();}
+
+    /*
+        loads the starting state and runs to the end as fast as it goes, skipping idle loops between events
+        when the machine has idle skip on. false on the first divergence
+    */
+    bool replay (Machine& machine) const;
+
+    bool write (const std::filesystem::path& path) const;
+    bool read (const std::filesystem::path& path);
+
+private:
+    Save_State start {};
+    std::uint64_t irq_period = 0;
+    std::uint64_t end_instruction = 0;
+    std::uint64_t end_cycle = 0;
+    std::uint64_t last_instruction = 0;
+    std::uint64_t last_cycle = 0;
+    std::size_t event_count = 0;
+    std::vector <std::uint8_t> events;
+    bool started = false;
+    bool finished = false;
+};
+
+#endif
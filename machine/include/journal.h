@@ -0,0 +1,65 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "mos6502.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+/*
+    undo log for stepping backwards, one entry per instruction holding what it overwrote:
+    the registers, cycles and interrupt lines from before it and the old value of every ram byte it wrote
+
+    entries are packed into a byte ring, the oldest are dropped to make room. a tag byte at both ends
+    (write count, interrupt lines, whether a bank byte follows) lets the ring be walked from either side
+        [tag] [address lo, address hi, old value] * writes [bank] [PC lo, PC hi, AC, XR, YR, SR, SP] [cycles] [tag]
+    an instruction that writes nothing costs 10 bytes
+*/
+class Undo_Journal
+{
+public:
+    static constexpr std::size_t max_writes = 0x1F;
+
+    struct Write
+    {
+        std::uint16_t address;
+        std::uint8_t old_value;
+    };
+
+    struct Entry
+    {
+        MOS_6502::Registers registers {};
+        std::uint8_t cycles = 0;
+        bool irq_pending = false;
+        bool nmi_pending = false;
+        std::optional <std::uint8_t> bank;
+        std::size_t write_count = 0;
+        std::array <Write, max_writes> writes {};
+    };
+
+    /* capacity is rounded up to a power of two */
+    explicit Undo_Journal (const std::size_t capacity);
+
+    /* an entry with more writes than fit breaks the chain, everything before it is dropped */
+    void push (const Entry& entry);
+    bool pop (Entry& entry);
+    void clear ();
+
+    /* instructions that can be undone, safe to read from any thread */
+    std::size_t depth () const {return entries.load(std::memory_order_relaxed);}
+    std::size_t capacity () const {return ring.size();}
+
+private:
+    std::vector <std::uint8_t> ring;
+    std::size_t head; // one past the newest byte
+    std::size_t used;
+    std::atomic <std::size_t> entries;
+
+    static std::size_t entry_size (const std::uint8_t tag);
+    std::uint8_t at (const std::size_t offset) const {return ring[offset & (ring.size() - 1)];}
+    void drop_oldest ();
+};
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/*
+    small byte oriented lz77 codec for save states and checkpoints
+
+    a block is a run of sequences: a token byte (high nibble literal count, low nibble match length - 4),
+    extra length bytes when a nibble is 15 (255 means keep adding), the literals, then a 2 byte little
+    endian offset back into the output. the last sequence has literals only.
+    machine memory is mostly zeros and repeated tables so this is fast and good enough
+*/
+namespace lz
+{
+    /* appends the compressed form of input to output, returns the number of bytes appended */
+    std::size_t compress (std::span <const std::uint8_t> input, std::vector <std::uint8_t>& output);
+
+    /* output has to be exactly the original size, false if the block is corrupt */
+    bool decompress (std::span <const std::uint8_t> input, std::span <std::uint8_t> output);
+}
+
+#endif
@@ -0,0 +1,205 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include "bus.h"
+#include "input_log.h"
+#include "journal.h"
+#include "mem.h"
+#include "mos6502.h"
+#include "page_pool.h"
+#include "rom_image.h"
+#include "save_state.h"
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+    rom, ram, bus and cpu wired together with the counters and interrupt lines that go with them
+    everything that runs the emulator, the gui's cpu thread or a headless tool, goes through one of these
+    not thread safe, the owner of the cpu thread is the only one that may call in while it runs
+*/
+class Machine
+{
+public:
+    Machine ();
+
+    /*
+        runs a rom image other machines may share and takes ram from pool a page at a time as it's written,
+        so an instance that touches little memory costs a few kb on top of the object itself.
+        a shared rom can't be patched and the rom and ram members stay empty, go through the bus
+    */
+    Machine (std::shared_ptr <const Rom_Image> image, std::shared_ptr <Page_Pool> pool);
+
+    Machine (const Machine&) = delete;
+    Machine& operator = (const Machine&) = delete;
+
+    /* reloads rom at $8000 (hex and s-record addresses are cpu addresses), clears ram and resets */
+    bool load_rom (const std::string& path);
+
+    /* same for an image already in memory, the bytes are copied */
+    bool load_rom (std::span <const std::uint8_t> image);
+
+    /* empties rom and ram, the cpu ends up running open bus */
+    void unload ();
+
+    /* cpu reset, counters and interrupt lines cleared, memory left alone */
+    void reset ();
+
+    /* reset with ram cleared and the rom kept, on a shared machine that's just rebuilding the page table */
+    void restart ();
+
+    /*
+        an independent copy of a shared machine in a few microseconds, for trying every value of an input
+        or both sides of a branch. registers, counters, interrupt lines and the irq timer are copied and ram
+        pages are shared until either side writes one. the child starts without a journal or recording.
+        call it where step would be called, afterwards parent and child can run on different threads.
+        null for a machine that owns its memory
+    */
+    std::unique_ptr <Machine> fork ();
+
+    /* takes a pending nmi or irq then runs one instruction, returns the cycles used */
+    int step ();
+
+    /* serviced before the next instruction, an irq that finds I set is dropped like before */
+    void raise_irq ();
+    void raise_nmi ();
+
+    /* changes from outside the cpu, the debugger's edits go through these so they can be recorded */
+    void poke (const std::uint16_t address, const std::uint8_t value);
+    void patch_rom (const std::uint32_t offset, const std::uint8_t value);
+    void set_registers (const MOS_6502::Registers& registers);
+
+    /*
+        pokes image in at address a page at a time, faster than poking it byte by byte and each page changes in
+        one go. false at the first page with nothing behind it, the pages before that are already written
+    */
+    bool map (const std::uint16_t address, std::span <const std::uint8_t> image);
+
+    /* every raise, poke and patch is appended to log until it's detached with nullptr */
+    void record (Input_Log* log) {input_log = log;}
+    bool recording () const {return input_log != nullptr;}
+
+    /*
+        periodic irq every period cycles, 0 turns it off
+        counted in emulated cycles rather than wall time so re-running from a state hits the same instructions
+    */
+    void set_irq_period (const std::uint64_t period) {irq_period = period;}
+    std::uint64_t get_irq_period () const {return irq_period;}
+
+    /*
+        idle loop fast-forward. with no interrupt taken and nothing written, the next instruction depends on
+        the registers alone, so registers coming back to a value they had earlier prove the program will go
+        round that loop until an interrupt arrives (there are no devices whose reads could change under it).
+        found with brent's cycle finding, one compare per step while it's on. nothing is skipped while
+        journaling since skipped turns can't be stepped back through
+    */
+    void set_idle_skip (const bool enabled);
+    bool idle_skip () const {return idle_search;}
+
+    /* a loop has been found and the machine is at the start of a turn of it */
+    bool idle () const;
+
+    /* the cycle count the irq timer fires at next, UINT64_MAX with it off */
+    std::uint64_t next_event () const;
+
+    /*
+        adds whole turns of the loop to the counters without running them, keeping the cycle count below
+        limit and short of the next timer irq, and the instruction count below instruction_limit so whatever
+        samples on instruction boundaries (Hash_Trace) still gets to them by stepping. leaves the machine
+        exactly where stepping would, returns the cycles skipped
+    */
+    std::uint64_t skip_idle (const std::uint64_t limit, const std::uint64_t instruction_limit = UINT64_MAX);
+
+    std::uint64_t cycles       () const {return cycle_count;}
+    std::uint64_t instructions () const {return instruction_count;}
+    std::uint64_t rom_hash     () const {return loaded_hash;}
+
+    /*
+        only ram pages written since the last save are compressed again, the rest reuse the block
+        from last time so a save is a handful of page compressions and a copy
+    */
+    Save_State save ();
+
+    /* false if the state was made with a different rom, pages whose contents already match are skipped */
+    bool load (const Save_State& state);
+
+    /*
+        fingerprint of everything a run can see: the 64kb address space as mapped, registers, counters,
+        bank and interrupt lines. page hashes are cached against the bus generations and folded in a
+        two level tree, so a call costs a pass over the generations plus rehashing what was written since
+    */
+    std::uint64_t state_hash ();
+
+    /* keep an undo journal of capacity bytes for step_back, 0 turns it off */
+    void set_journal (const std::size_t capacity);
+    bool journaling () const {return journal != nullptr;}
+    std::size_t journal_depth () const {return journal ? journal->depth() : 0;}
+
+    /* puts back everything the last instruction changed, false once the journal runs out */
+    bool step_back ();
+
+    Memory rom;
+    Memory ram;
+    Bus bus;
+    MOS_6502::CPU cpu;
+
+private:
+    Machine (const std::uint16_t rom_size, const std::uint16_t ram_size);
+
+    /* the end of both load_roms, for a shared and an owned rom */
+    bool map_image (std::shared_ptr <const Rom_Image> image);
+    bool map_rom (const bool loaded);
+
+    std::uint64_t cycle_count;
+    std::uint64_t instruction_count;
+    std::uint64_t loaded_hash;
+    std::uint64_t irq_period;
+    bool irq_pending;
+    bool nmi_pending;
+
+    Input_Log* input_log;
+
+    // the registers the current ones are compared against, moved forward every power steps
+    struct Idle_Loop
+    {
+        MOS_6502::Registers mark;
+        std::uint64_t mark_cycles;
+        std::uint64_t mark_instructions;
+        std::uint64_t mark_writes;
+        std::uint64_t power;
+        std::uint64_t length;
+        std::uint64_t turn_cycles; // 0 until a loop is found
+        std::uint64_t turn_instructions;
+    };
+
+    bool idle_search;
+    Idle_Loop idle_loop;
+    std::uint64_t write_count; // every cpu write, rom writes that switch banks included
+
+    void watch_idle ();
+    void forget_idle ();
+
+    void log_input (const Input_Log::Kind kind, const std::uint32_t address, const std::uint8_t value);
+    void stop_recording ();
+
+    // filled by the cpu's write callback while an instruction runs, pushed when it's done
+    std::unique_ptr <Undo_Journal> journal;
+    Undo_Journal::Entry undo;
+
+    // the compressed blocks from the last save or load and the page generations they match
+    std::array <std::vector <std::uint8_t>, Bus::ram_pages> page_blocks;
+    std::array <std::uint32_t, Bus::ram_pages> page_generations;
+    std::bitset <Bus::ram_pages> page_cached;
+
+    static constexpr std::size_t hash_group = 16;
+    std::array <std::uint64_t, Bus::page_count> page_hashes;
+    std::array <std::uint32_t, Bus::page_count> page_hash_generations;
+    std::array <std::uint64_t, Bus::page_count / hash_group> group_hashes;
+    std::array <bool, Bus::page_count> page_hashed;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef SAVE_STATE_H
+#define SAVE_STATE_H
+
+#include "mos6502.h"
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <span>
+#include <vector>
+
+/*
+    everything needed to put a machine back where it was: registers, counters, the selected rom
+    bank, pending interrupts and the bus visible ram, one lz block per page
+    rom isn't stored, a state only loads into a machine running a rom with the same hash
+*/
+struct Save_State
+{
+    MOS_6502::Registers registers {};
+    std::uint64_t cycles       = 0;
+    std::uint64_t instructions = 0;
+    std::uint64_t rom_hash     = 0;
+    std::uint32_t bank         = 0;
+    bool irq_pending = false;
+    bool nmi_pending = false;
+
+    /* page i is pages[offsets[i] .. offsets[i + 1]] */
+    std::vector <std::uint32_t> offsets;
+    std::vector <std::uint8_t> pages;
+
+    std::size_t page_count () const {return offsets.empty() ? 0 : offsets.size() - 1;}
+    std::span <const std::uint8_t> page (const std::size_t index) const
+    {
+        return std::span(pages).subspan (offsets[index], offsets[index + 1] - offsets[index]);
+    }
+
+    /* bytes held, roughly what the state costs in memory or on disk */
+    std::size_t size () const {return sizeof(*this) + offsets.size() * sizeof(std::uint32_t) + pages.size();}
+
+    bool write (const std::filesystem::path& path) const;
+    bool read (const std::filesystem::path& path);
+
+    /* for embedding in other files, these don't report anything */
+    bool write (std::ostream& output) const;
+    bool read (std::istream& input);
+};
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef SHM_OBSERVER_H
+#define SHM_OBSERVER_H
+
+#include "bus.h"
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class Machine;
+
+/*
+    ram, a register and counter snapshot and a ring of recent instructions in a posix shared memory segment
+    (shm_open), so dashboards and loggers in other processes can watch a running machine. the emulator never
+    makes a syscall or waits on a reader after open, readers map the segment read only and never write to it
+
+    layout, native endian, every field naturally aligned, offsets in bytes:
+
+        0     char[8]  magic "6502OBS"
+        8     u32      layout version (1)
+        12    u32      ram offset (128)
+        16    u32      ram size (0x8000, $0000 - $7FFF)
+        20    u32      trace offset
+        24    u32      trace capacity in entries, a power of two or 0 for no trace
+        28    u32      trace entry size (16)
+        32    u32      sequence, odd while a snapshot is being written
+        36    u32      rom bank
+        40    u64      cycles
+        48    u64      instructions
+        56    u64      rom hash
+        64    u16      pc
+        66    u8 x5    a, x, y, sr, sp
+        72    u64      trace head, entries written so far
+        80    u32      pid of the emulator writing the segment
+        128   ram
+        trace ring     16 byte entries: u64 cycles after the instruction, u16 pc, u8 opcode, u8 a, x, y, sr, sp
+
+    snapshot (ram and 36 - 71): read the sequence with acquire, give up if it's odd, copy what you need, issue an
+    acquire fence and read the sequence again. the copy is good if both reads match. a snapshot is written every
+    interval instructions, so ram here trails the machine by at most that much
+    trace: entry n is in slot n & (capacity - 1). read the head with acquire, copy entries below it, read the head
+    again. entries more than capacity below the second head may have been overwritten while copying
+*/
+class Shm_Observer
+{
+public:
+    struct Header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t ram_offset;
+        std::uint32_t ram_size;
+        std::uint32_t trace_offset;
+        std::uint32_t trace_capacity;
+        std::uint32_t trace_entry_size;
+        std::uint32_t sequence;
+        std::uint32_t bank;
+        std::uint64_t cycles;
+        std::uint64_t instructions;
+        std::uint64_t rom_hash;
+        std::uint16_t pc;
+        std::uint8_t a;
+        std::uint8_t x;
+        std::uint8_t y;
+        std::uint8_t sr;
+        std::uint8_t sp;
+        std::uint8_t unused;
+        std::uint64_t trace_head;
+        std::uint32_t owner;
+    };
+
+    struct Trace_Entry
+    {
+        std::uint64_t cycles;
+        std::uint16_t pc;
+        std::uint8_t opcode;
+        std::uint8_t a;
+        std::uint8_t x;
+        std::uint8_t y;
+        std::uint8_t sr;
+        std::uint8_t sp;
+    };
+
+    static constexpr std::uint32_t layout_version = 1;
+    static constexpr std::size_t header_size = 128;
+    static constexpr std::uint64_t default_interval = 1000;
+
+    Shm_Observer ();
+    ~Shm_Observer ();
+
+    Shm_Observer (const Shm_Observer&) = delete;
+    Shm_Observer& operator = (const Shm_Observer&) = delete;
+
+    /*
+        creates the segment, replacing one left behind by a run that's gone. fails while the emulator that made
+        it is still running. trace_capacity is rounded up to a power of two
+    */
+    bool open (std::string _name, const std::size_t trace_capacity);
+
+    /* unmaps and unlinks, readers that still have it mapped keep their view */
+    void close ();
+    bool is_open () const {return header != nullptr;}
+    const std::string& segment_name () const {return name;}
+
+    /* instructions between snapshots */
+    void set_interval (const std::uint64_t instructions) {interval = instructions;}
+
+    /* after every instruction, on the thread running the machine. traces it and snapshots once interval has passed */
+    void update (const Machine& machine);
+
+    /* snapshot now, for changes that didn't come from running (loads, resets, edits while paused) */
+    void publish (const Machine& machine);
+
+private:
+    std::string name;
+    std::size_t size;
+    Header* header;
+    std::uint8_t* ram;
+    Trace_Entry* trace;
+    std::uint64_t trace_mask;
+    std::uint64_t trace_head;
+    std::uint64_t interval;
+    std::uint64_t next;
+
+    // ram pages are only copied when their generation moved since the last snapshot
+    std::array <std::uint32_t, Bus::ram_pages> page_generations;
+    std::bitset <Bus::ram_pages> page_copied;
+};
+
+static_assert (offsetof (Shm_Observer::Header, sequence) == 32);
+static_assert (offsetof (Shm_Observer::Header, cycles) == 40);
+static_assert (offsetof (Shm_Observer::Header, pc) == 64);
+static_assert (offsetof (Shm_Observer::Header, trace_head) == 72);
+static_assert (offsetof (Shm_Observer::Header, owner) == 80);
+static_assert (sizeof (Shm_Observer::Header) <= Shm_Observer::header_size);
+static_assert (sizeof (Shm_Observer::Trace_Entry) == 16);
+
+#endif
@@ -0,0 +1,250 @@
+#include "batch.h"
+#include "batch_kernel.h"
+#include <array>
+#include <cstring>
+
+namespace
+{
+    struct Baseline {};
+
+    constexpr std::array <batch_kernel::Opcode, 256> opcodes = [] ()
+    {
+        std::array <batch_kernel::Opcode, 256> table {};
+        for (std::size_t i = 0; i < table.size(); ++i)
+        {
+            const auto& ins = MOS_6502::CPU::instruction_table[i];
+            table[i] = {ins.mnemonic, ins.addr_mode, ins.cycle_count};
+        }
+        return table;
+    } ();
+
+    // a peeled lane goes back to the scheduler after this many instructions even if it hasn't caught up
+    constexpr std::size_t peel_limit = 1024;
+
+    batch_kernel::execute_fn pick_kernel ()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        if (batch_kernel::avx512 () && __builtin_cpu_supports ("avx512bw") && __builtin_cpu_supports ("avx512vl"))
+            return batch_kernel::avx512 ();
+        if (batch_kernel::avx2 () && __builtin_cpu_supports ("avx2"))
+            return batch_kernel::avx2 ();
+#endif
+        return &batch_kernel::execute <Baseline>;
+    }
+}
+
+Batch::Batch (const Machine& machine, const std::size_t lane_count)
+: count {lane_count}
+, padded {(lane_count + lane_block - 1) / lane_block * lane_block}
+, rom {}
+, ram (0x8000 * padded)
+, pc (padded)
+, ac (padded)
+, xr (padded)
+, yr (padded)
+, sr (padded)
+, sp (padded)
+, cycle_counts (padded, machine.cycles ())
+, instruction_counts (padded, machine.instructions ())
+, cycle_limits (padded)
+, halted (padded)
+, active (padded)
+, group (padded)
+, address (padded)
+, data (padded)
+, extra (padded)
+, stops {}
+, peel_threshold {padded / 16}
+, counters {}
+, scalar_lane {0}
+, scalar {[this] (const std::uint16_t at) {return peek (scalar_lane, at);},
+          [this] (const std::uint16_t at, const std::uint8_t value) {poke (scalar_lane, at, value);}}
+{
+    for (std::size_t page = Bus::ram_pages; page < Bus::page_count; ++page)
+        std::memcpy (rom.data() + (page - Bus::ram_pages) * Bus::page_size, machine.bus.page_data (page).data(), Bus::page_size);
+
+    for (std::size_t page = 0; page < Bus::ram_pages; ++page)
+    {
+        const auto bytes = machine.bus.page_data (page);
+        for (std::size_t i = 0; i < Bus::page_size; ++i)
+            std::memset (ram.data() + (page * Bus::page_size + i) * padded, bytes[i], padded);
+    }
+
+    for (std::size_t lane = 0; lane < padded; ++lane)
+        set_registers (lane, machine.cpu.get_registers ());
+}
+
+MOS_6502::Registers Batch::get_registers (const std::size_t lane) const
+{
+    return {pc[lane], ac[lane], xr[lane], yr[lane], sr[lane], sp[lane]};
+}
+
+void Batch::set_registers (const std::size_t lane, const MOS_6502::Registers& registers)
+{
+    pc[lane] = registers.PC;
+    ac[lane] = registers.AC;
+    xr[lane] = registers.XR;
+    yr[lane] = registers.YR;
+    sr[lane] = registers.SR;
+    sp[lane] = registers.SP;
+}
+
+std::uint8_t Batch::peek (const std::size_t lane, const std::uint16_t address) const
+{
+    return address < 0x8000 ? ram[address * padded + lane] : rom[address - 0x8000];
+}
+
+void Batch::poke (const std::size_t lane, const std::uint16_t address, const std::uint8_t value)
+{
+    // rom is shared by every lane
+    if (address < 0x8000)
+        ram[address * padded + lane] = value;
+}
+
+void Batch::stop_at (const std::uint16_t address)
+{
+    if (stops.empty())
+        stops.resize (0x10000);
+    stops[address] = 1;
+}
+
+bool Batch::keep_running (const std::size_t lane)
+{
+    if (!stops.empty() && stops[pc[lane]])
+        halted[lane] = 0xFF;
+    if (halted[lane] || cycle_counts[lane] >= cycle_limits[lane])
+        active[lane] = 0;
+    return active[lane] != 0;
+}
+
+void Batch::peel (const std::size_t lane, const std::uint32_t target, const std::size_t limit)
+{
+    scalar_lane = lane;
+    scalar.set_registers (get_registers (lane));
+    for (std::size_t step = 0; step < limit; ++step)
+    {
+        cycle_counts[lane] += scalar.update ();
+        ++instruction_counts[lane];
+        ++counters.scalar_steps;
+        pc[lane] = scalar.get_PC ();
+        if (!keep_running (lane) || pc[lane] >= target)
+            break;
+    }
+    set_registers (lane, scalar.get_registers ());
+}
+
+void Batch::run (const std::uint64_t budget)
+{
+    static const batch_kernel::execute_fn execute = pick_kernel ();
+
+    // raw pointers so the byte stores can't be taken for writes to the vectors and every pass vectorises
+    const std::size_t n = padded;
+    std::uint8_t* const running_lanes = active.data();
+    std::uint8_t* const group_lanes = group.data();
+    const std::uint16_t* const pcs = pc.data();
+    const std::uint64_t* const used = cycle_counts.data();
+    const std::uint64_t* const limits = cycle_limits.data();
+    std::uint8_t* const stopped_lanes = halted.data();
+
+    std::size_t running = 0;
+    for (std::size_t lane = 0; lane < n; ++lane)
+    {
+        cycle_limits[lane] = cycle_counts[lane] + budget;
+        running_lanes[lane] = lane < count ? 0xFF : 0x00;
+        running += lane < count && keep_running (lane);
+    }
+
+    bool together = false; // every running lane is in the group and at the pc in at
+    std::uint16_t at = 0;
+    std::size_t leader = 0; // a lane in the group
+    std::size_t members = 0;
+    while (running > 0)
+    {
+        if (!together)
+        {
+            // the lowest pc goes first, the lanes ahead wait for it to catch up
+            std::uint16_t lowest = UINT16_MAX;
+            for (std::size_t lane = 0; lane < n; ++lane)
+            {
+                const std::uint16_t value = running_lanes[lane] ? pcs[lane] : UINT16_MAX;
+                lowest = value < lowest ? value : lowest;
+            }
+
+            members = 0;
+            for (std::size_t lane = 0; lane < n; ++lane)
+            {
+                group_lanes[lane] = pcs[lane] == lowest ? running_lanes[lane] : 0;
+                members += group_lanes[lane] & 1;
+            }
+            leader = 0;
+            while (!group_lanes[leader])
+                ++leader;
+            at = lowest;
+            together = members == running;
+        }
+
+        if (at < 0x8000 || at > 0xFFFD || members <= peel_threshold)
+        {
+            // the peeled lanes run until they reach the next lowest pc, where the others are waiting
+            std::uint16_t target = UINT16_MAX;
+            bool others = false;
+            for (std::size_t lane = 0; lane < n; ++lane)
+            {
+                const std::uint16_t value = running_lanes[lane] && !group_lanes[lane] ? pcs[lane] : UINT16_MAX;
+                others = others || (running_lanes[lane] && !group_lanes[lane]);
+                target = value < target ? value : target;
+            }
+            for (std::size_t lane = 0; lane < count; ++lane)
+            {
+                if (group_lanes[lane] && running_lanes[lane])
+                    peel (lane, others ? target : 0x10000, peel_limit);
+            }
+
+            running = 0;
+            for (std::size_t lane = 0; lane < n; ++lane)
+                running += running_lanes[lane] & 1;
+            together = false;
+            continue;
+        }
+
+        const batch_kernel::Args args
+        {
+            n, members, ram.data(), rom.data(), opcodes.data(),
+            pc.data(), ac.data(), xr.data(), yr.data(), sr.data(), sp.data(),
+            cycle_counts.data(), instruction_counts.data(),
+            group_lanes, address.data(), data.data(), extra.data(),
+            at,
+        };
+        const bool same = execute (args);
+        ++counters.vector_steps;
+        counters.vector_lane_steps += members;
+
+        if (!stops.empty() && (!same || stops[pcs[leader]]))
+        {
+            for (std::size_t lane = 0; lane < count; ++lane)
+            {
+                if (group_lanes[lane] && stops[pcs[lane]])
+                    stopped_lanes[lane] = 0xFF;
+            }
+        }
+
+        running = 0;
+        members = 0;
+        for (std::size_t lane = 0; lane < n; ++lane)
+        {
+            const bool out = stopped_lanes[lane] || used[lane] >= limits[lane];
+            running_lanes[lane] = out ? 0 : running_lanes[lane];
+            group_lanes[lane] &= running_lanes[lane];
+            running += running_lanes[lane] & 1;
+            members += group_lanes[lane] & 1;
+        }
+
+        together = together && same;
+        if (together && running > 0)
+        {
+            at = pcs[leader];
+            while (!group_lanes[leader])
+                ++leader;
+        }
+    }
+}
@@ -0,0 +1,22 @@
+#include "batch_kernel.h"
+
+#if defined(__AVX2__)
+
+namespace
+{
+    struct Avx2 {};
+}
+
+batch_kernel::execute_fn batch_kernel::avx2 ()
+{
+    return &execute <Avx2>;
+}
+
+#else
+
+batch_kernel::execute_fn batch_kernel::avx2 ()
+{
+    return nullptr;
+}
+
+#endif
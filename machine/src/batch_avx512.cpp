@@ -0,0 +1,22 @@
+#include "batch_kernel.h"
+
+#if defined(__AVX512BW__) && defined(__AVX512VL__)
+
+namespace
+{
+    struct Avx512 {};
+}
+
+batch_kernel::execute_fn batch_kernel::avx512 ()
+{
+    return &execute <Avx512>;
+}
+
+#else
+
+batch_kernel::execute_fn batch_kernel::avx512 ()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,685 @@
+#ifndef BATCH_KERNEL_H
+#define BATCH_KERNEL_H
+
+#include "mos6502_types.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/*
+    one instruction for a group of lanes that share a pc in rom, see batch.h
+    written as plain loops over every lane with the group mask blended in, so the same source becomes
+    sse2, avx2 or avx-512 depending on the flags of the file instantiating it (batch.cpp, batch_avx2.cpp,
+    batch_avx512.cpp). machine/CMakeLists.txt builds those three at -O3, g++ leaves the loops scalar at -O2.
+    every function is a template on a tag type each of those files defines for itself, so the copies never
+    merge at link time. for the same reason nothing in here calls standard library templates or includes
+    mos6502.h, whose tables would be instantiated in each file, the opcode table comes in through Args
+
+    helpers copy what they need out of Args into locals first, the byte stores could alias anything
+    reached through a pointer and would otherwise keep the loops from vectorising
+
+    it follows MOS_6502::CPU to the bit, quirks included, so lanes can move between the two at any instruction
+*/
+namespace batch_kernel
+{
+    /* what the kernel needs of an opcode, batch.cpp copies them out of MOS_6502::CPU::instruction_table */
+    struct Opcode
+    {
+        MOS_6502::Mnemonic mnemonic;
+        MOS_6502::Mode addr_mode;
+        int cycle_count;
+    };
+
+    struct Args
+    {
+        std::size_t lanes;         // padded, a multiple of Batch::lane_block
+        std::size_t count;         // lanes in the group
+        std::uint8_t* ram;         // address * lanes + lane
+        const std::uint8_t* rom;   // $8000 - $FFFF
+        const Opcode* opcodes;     // all 256
+        std::uint16_t* pc;
+        std::uint8_t* ac;
+        std::uint8_t* xr;
+        std::uint8_t* yr;
+        std::uint8_t* sr;
+        std::uint8_t* sp;
+        std::uint64_t* cycles;
+        std::uint64_t* instructions;
+        const std::uint8_t* group; // 0xFF for lanes taking part, 0x00 for the rest
+        std::uint16_t* address;    // scratch
+        std::uint8_t* data;        // scratch
+        std::uint8_t* extra;       // scratch
+        std::uint16_t at;          // the group's pc, $8000 - $FFFD
+    };
+
+    /* returns true when every lane in the group ends up at the same pc */
+    using execute_fn = bool (*) (const Args&);
+
+    /* the avx2 and avx-512 builds, null when the file was built without them, only use them when the cpu has them */
+    execute_fn avx2 ();
+    execute_fn avx512 ();
+
+    enum Flag_Bit : std::uint8_t
+    {
+        N = 0x80, V = 0x40, U = 0x20, B = 0x10, D = 0x08, I = 0x04, Z = 0x02, C = 0x01,
+    };
+
+    /* where an instruction's operand is, one address for the whole group or one per lane in Args::address */
+    struct Operand
+    {
+        bool per_lane;
+        std::uint16_t uniform;
+    };
+
+    template <class Isa>
+    std::uint8_t nz (const std::uint8_t value)
+    {
+        return (value & N) | (value == 0 ? Z : 0);
+    }
+
+    /* true if every lane in the group holds the same value, which ends up in value */
+    template <class Isa, class T>
+    bool shared (const Args& a, const T* values, T& value)
+    {
+        const std::size_t n = a.lanes;
+        const std::uint8_t* const g = a.group;
+        std::size_t first = 0;
+        while (!g[first])
+            ++first;
+        value = values[first];
+        std::uint8_t differ = 0;
+        for (std::size_t i = 0; i < n; ++i)
+            differ |= g[i] & (values[i] != value ? 1 : 0);
+        return differ == 0;
+    }
+
+    /* the operand byte of every lane, straight out of the ram column when the address is shared */
+    template <class Isa>
+    const std::uint8_t* fetch (const Args& a, const Operand operand)
+    {
+        const std::size_t n = a.lanes;
+        const std::uint8_t* const ram = a.ram;
+        const std::uint8_t* const rom = a.rom;
+        const std::uint16_t* const address = a.address;
+        std::uint8_t* const data = a.data;
+        if (operand.per_lane)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                data[i] = address[i] < 0x8000 ? ram[address[i] * n + i] : rom[address[i] - 0x8000];
+            return data;
+        }
+        if (operand.uniform < 0x8000)
+            return ram + operand.uniform * n;
+        std::memset (data, rom[operand.uniform - 0x8000], n);
+        return data;
+    }
+
+    /* writes value[i] for the group, rom writes are dropped */
+    template <class Isa>
+    void store (const Args& a, const Operand operand, const std::uint8_t* value)
+    {
+        const std::size_t n = a.lanes;
+        const std::uint8_t* const g = a.group;
+        std::uint8_t* const ram = a.ram;
+        const std::uint16_t* const address = a.address;
+        if (operand.per_lane)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                if (g[i] && address[i] < 0x8000)
+                    ram[address[i] * n + i] = value[i];
+            }
+        }
+        else if (operand.uniform < 0x8000)
+        {
+            std::uint8_t* const row = ram + operand.uniform * n;
+            for (std::size_t i = 0; i < n; ++i)
+                row[i] = g[i] ? value[i] : row[i];
+        }
+    }
+
+    /* value is either one byte for everyone (step 0) or one per lane (step 1) */
+    template <class Isa>
+    void push (const Args& a, const std::uint8_t* value, const std::size_t step)
+    {
+        const std::size_t n = a.lanes;
+        const std::uint8_t* const g = a.group;
+        std::uint8_t* const ram = a.ram;
+        std::uint8_t* const sp = a.sp;
+        std::uint8_t top = 0;
+        if (shared <Isa> (a, sp, top))
+        {
+            std::uint8_t* const row = ram + (0x100 + top) * n;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                row[i] = g[i] ? value[i * step] : row[i];
+                sp[i] -= g[i] & 1;
+            }
+            return;
+        }
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            if (g[i])
+            {
+                ram[(0x100 + sp[i]) * n + i] = value[i * step];
+                --sp[i];
+            }
+        }
+    }
+
+    template <class Isa>
+    void pop (const Args& a, std::uint8_t* out)
+    {
+        const std::size_t n = a.lanes;
+        const std::uint8_t* const g = a.group;
+        const std::uint8_t* const ram = a.ram;
+        std::uint8_t* const sp = a.sp;
+        for (std::size_t i = 0; i < n; ++i)
+            sp[i] += g[i] & 1;
+        std::uint8_t top = 0;
+        if (shared <Isa> (a, sp, top))
+        {
+            std::memcpy (out, ram + (0x100 + top) * n, n);
+            return;
+        }
+        for (std::size_t i = 0; i < n; ++i)
+            out[i] = ram[(0x100 + sp[i]) * n + i];
+    }
+
+    /* reg = op (reg, m) with N and Z from the result */
+    template <class Isa, class Op>
+    void load (const Args& a, std::uint8_t* reg, const std::uint8_t* m, const Op op)
+    {
+        const std::size_t n = a.lanes;
+        const std::uint8_t* const g = a.group;
+        std::uint8_t* const sr = a.sr;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            const std::uint8_t v = op (reg[i], m[i]);
+            reg[i] = g[i] ? v : reg[i];
+            sr[i] = g[i] ? static_cast <std::uint8_t> ((sr[i] & ~(N | Z)) | nz <Isa> (v)) : sr[i];
+        }
+    }
+
+    template <class Isa>
+    void set_flags (const Args& a, const std::uint8_t clear, const std::uint8_t set)
+    {
+        const std::size_t n = a.lanes;
+        const std::uint8_t* const g = a.group;
+        std::uint8_t* const sr = a.sr;
+        for (std::size_t i = 0; i < n; ++i)
+            sr[i] = g[i] ? static_cast <std::uint8_t> ((sr[i] & ~clear) | set) : sr[i];
+    }
+
+    template <class Isa>
+    void compare (const Args& a, const std::uint8_t* reg, const std::uint8_t* m)
+    {
+        const std::size_t n = a.lanes;
+        const std::uint8_t* const g = a.group;
+        std::uint8_t* const sr = a.sr;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            const std::uint8_t result = reg[i] - m[i];
+            const std::uint8_t flags = nz <Isa> (result) | (reg[i] >= m[i] ? C : 0);
+            sr[i] = g[i] ? static_cast <std::uint8_t> ((sr[i] & ~(N | Z | C)) | flags) : sr[i];
+        }
+    }
+
+    /* shifts, rotates, increments and decrements, on the accumulator or read-modify-write on memory */
+    template <class Isa, class Op>
+    void modify (const Args& a, const Operand operand, const bool accumulator, const std::uint8_t affected, const Op op)
+    {
+        const std::size_t n = a.lanes;
+        const std::uint8_t* const g = a.group;
+        std::uint8_t* const sr = a.sr;
+        std::uint8_t* const ac = a.ac;
+        std::uint8_t* const data = a.data;
+        const std::uint8_t* const m = accumulator ? ac : fetch <Isa> (a, operand);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            // m can be data itself, op reads it before it's written back
+            std::uint8_t carry = 0;
+            const std::uint8_t v = op (m[i], sr[i] & C, carry);
+            const std::uint8_t flags = nz <Isa> (v) | carry;
+            sr[i] = g[i] ? static_cast <std::uint8_t> ((sr[i] & ~affected) | flags) : sr[i];
+            data[i] = v;
+        }
+        if (accumulator)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                ac[i] = g[i] ? data[i] : ac[i];
+        }
+        else
+            store <Isa> (a, operand, data);
+    }
+
+    /* the target is the same for every lane, only whether it's taken differs, returns how many took it */
+    template <class Isa>
+    std::size_t branch (const Args& a, const std::uint16_t offset, const std::uint16_t next, const std::uint8_t flag, const std::uint8_t when, const bool overflow_quirk)
+    {
+        const std::size_t n = a.lanes;
+        const std::uint8_t* const g = a.group;
+        const std::uint8_t* const sr = a.sr;
+        std::uint16_t* const pc = a.pc;
+        std::uint8_t* const extra = a.extra;
+
+        const std::uint16_t target = offset + next;
+        // BVC compares the wrong halves in the scalar core, kept so the two agree
+        const bool crossed = overflow_quirk ? (target & 0x00FF) != (next & 0xFF00) : (target & 0xFF00) != (next & 0xFF00);
+        const std::uint8_t taken_cycles = 1 + (crossed ? 1 : 0);
+        std::size_t taken_count = 0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            const std::uint8_t taken = g[i] & ((sr[i] & flag) == when ? 1 : 0);
+            extra[i] = taken ? taken_cycles : 0;
+            pc[i] = g[i] ? (taken ? target : next) : pc[i];
+            taken_count += taken;
+        }
+        return taken_count;
+    }
+
+    template <class Isa>
+    void jump (const Args& a, const Operand operand)
+    {
+        const std::size_t n = a.lanes;
+        const std::uint8_t* const g = a.group;
+        const std::uint16_t* const address = a.address;
+        std::uint16_t* const pc = a.pc;
+        if (operand.per_lane)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                pc[i] = g[i] ? address[i] : pc[i];
+        }
+        else
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                pc[i] = g[i] ? operand.uniform : pc[i];
+        }
+    }
+
+    /* works out where the operand is, per lane addresses go in Args::address */
+    template <class Isa>
+    Operand address (const Args& a, const Opcode& ins, std::uint16_t& length, bool& has_extra)
+    {
+        using MOS_6502::Mode;
+
+        const std::size_t n = a.lanes;
+        const std::uint8_t* const ram = a.ram;
+        const std::uint8_t* const rom = a.rom;
+        const std::uint8_t* const xr = a.xr;
+        const std::uint8_t* const yr = a.yr;
+        std::uint16_t* const address = a.address;
+        std::uint8_t* const extra = a.extra;
+
+        const std::uint8_t op1 = rom[(a.at + 1) & 0x7FFF];
+        const std::uint8_t op2 = rom[(a.at + 2) & 0x7FFF];
+        const std::uint16_t word = (op2 << 8) | op1;
+
+        Operand operand {false, 0};
+        length = 2;
+        has_extra = false;
+        switch (ins.addr_mode)
+        {
+            case Mode::ACC:
+            case Mode::IMP:
+                length = 1;
+                break;
+            case Mode::IMM:
+                operand.uniform = a.at + 1;
+                break;
+            case Mode::ABS:
+                length = 3;
+                operand.uniform = word;
+                break;
+            case Mode::ZPG:
+                operand.uniform = op1;
+                break;
+            case Mode::REL:
+                operand.uniform = static_cast <std::uint16_t> (static_cast <std::int8_t> (op1));
+                break;
+            case Mode::ZPX:
+            case Mode::ZPY:
+            {
+                // no wrap inside the zero page, the scalar core can reach $01FE
+                const std::uint8_t* const index = ins.addr_mode == Mode::ZPX ? xr : yr;
+                operand.per_lane = true;
+                for (std::size_t i = 0; i < n; ++i)
+                    address[i] = op1 + index[i];
+                break;
+            }
+            case Mode::ABX:
+            case Mode::ABY:
+            {
+                const std::uint8_t* const index = ins.addr_mode == Mode::ABX ? xr : yr;
+                length = 3;
+                operand.per_lane = true;
+                has_extra = true;
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    address[i] = word + index[i];
+                    extra[i] = (address[i] & 0xFF00) != (op2 << 8);
+                }
+                break;
+            }
+            case Mode::XIZ:
+                operand.per_lane = true;
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    const std::size_t pointer = op1 + xr[i];
+                    address[i] = ram[pointer * n + i] | (ram[(pointer + 1) * n + i] << 8);
+                }
+                break;
+            case Mode::YIZ:
+            {
+                const std::uint8_t* const low  = ram + op1 * n;
+                const std::uint8_t* const high = ram + (op1 + 1) * n;
+                operand.per_lane = true;
+                has_extra = true;
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    address[i] = ((high[i] << 8) | low[i]) + yr[i];
+                    extra[i] = (address[i] & 0xFF00) != (high[i] << 8);
+                }
+                break;
+            }
+            case Mode::IND:
+            {
+                const std::uint16_t next = word + 1;
+                length = 3;
+                if (word >= 0x8000 && next >= 0x8000)
+                    operand.uniform = rom[word - 0x8000] | (rom[next - 0x8000] << 8);
+                else
+                {
+                    operand.per_lane = true;
+                    for (std::size_t i = 0; i < n; ++i)
+                    {
+                        const std::uint8_t low  = word < 0x8000 ? ram[word * n + i] : rom[word - 0x8000];
+                        const std::uint8_t high = next < 0x8000 ? ram[next * n + i] : rom[next - 0x8000];
+                        address[i] = (high << 8) | low;
+                    }
+                }
+                break;
+            }
+        }
+
+        // lanes usually agree on X and Y, then the address is shared and the ram column can be used directly
+        if (operand.per_lane && shared <Isa> (a, address, operand.uniform))
+            operand.per_lane = false;
+        return operand;
+    }
+
+    template <class Isa>
+    bool execute (const Args& a)
+    {
+        using MOS_6502::Mnemonic;
+        using MOS_6502::Mode;
+
+        const std::size_t n = a.lanes;
+        const std::uint8_t* const g = a.group;
+        const std::uint8_t* const rom = a.rom;
+        std::uint16_t* const pc = a.pc;
+        std::uint8_t* const ac = a.ac;
+        std::uint8_t* const xr = a.xr;
+        std::uint8_t* const yr = a.yr;
+        std::uint8_t* const sr = a.sr;
+        std::uint8_t* const sp = a.sp;
+        std::uint8_t* const data = a.data;
+        const std::uint8_t* const extra = a.extra;
+        std::uint64_t* const cycles = a.cycles;
+        std::uint64_t* const instructions = a.instructions;
+
+        const Opcode& ins = a.opcodes[rom[a.at - 0x8000]];
+
+        for (std::size_t i = 0; i < n; ++i)
+            sr[i] |= g[i] & U;
+
+        std::uint16_t length = 0;
+        bool has_extra = false;
+        const Operand operand = address <Isa> (a, ins, length, has_extra);
+        const std::uint16_t next = a.at + length;
+        const bool accumulator = ins.addr_mode == Mode::ACC;
+
+        const auto pass  = [] (const std::uint8_t, const std::uint8_t m) -> std::uint8_t {return m;};
+        const auto plus  = [] (const std::uint8_t r, const std::uint8_t) -> std::uint8_t {return r + 1;};
+        const auto minus = [] (const std::uint8_t r, const std::uint8_t) -> std::uint8_t {return r - 1;};
+
+        bool pc_done = false;
+        bool same_pc = true;
+        std::size_t taken_count = 0;
+        switch (ins.mnemonic)
+        {
+            case Mnemonic::LDA: load <Isa> (a, ac, fetch <Isa> (a, operand), pass); break;
+            case Mnemonic::LDX: load <Isa> (a, xr, fetch <Isa> (a, operand), pass); break;
+            case Mnemonic::LDY: load <Isa> (a, yr, fetch <Isa> (a, operand), pass); break;
+            case Mnemonic::ORA: load <Isa> (a, ac, fetch <Isa> (a, operand), [] (const std::uint8_t r, const std::uint8_t m) -> std::uint8_t {return r | m;}); break;
+            case Mnemonic::AND: load <Isa> (a, ac, fetch <Isa> (a, operand), [] (const std::uint8_t r, const std::uint8_t m) -> std::uint8_t {return r & m;}); break;
+            case Mnemonic::EOR: load <Isa> (a, ac, fetch <Isa> (a, operand), [] (const std::uint8_t r, const std::uint8_t m) -> std::uint8_t {return r ^ m;}); break;
+
+            case Mnemonic::TAX: load <Isa> (a, xr, ac, pass); break;
+            case Mnemonic::TAY: load <Isa> (a, yr, ac, pass); break;
+            case Mnemonic::TXA: load <Isa> (a, ac, xr, pass); break;
+            case Mnemonic::TYA: load <Isa> (a, ac, yr, pass); break;
+            case Mnemonic::TSX: load <Isa> (a, xr, sp, pass); break;
+            case Mnemonic::TXS:
+                for (std::size_t i = 0; i < n; ++i)
+                    sp[i] = g[i] ? xr[i] : sp[i];
+                break;
+
+            case Mnemonic::INX: load <Isa> (a, xr, xr, plus); break;
+            case Mnemonic::INY: load <Isa> (a, yr, yr, plus); break;
+            case Mnemonic::DEX: load <Isa> (a, xr, xr, minus); break;
+            case Mnemonic::DEY: load <Isa> (a, yr, yr, minus); break;
+            case Mnemonic::INC:
+                modify <Isa> (a, operand, false, N | Z, [] (const std::uint8_t m, const std::uint8_t, std::uint8_t&) -> std::uint8_t {return m + 1;});
+                break;
+            case Mnemonic::DEC:
+                modify <Isa> (a, operand, false, N | Z, [] (const std::uint8_t m, const std::uint8_t, std::uint8_t&) -> std::uint8_t {return m - 1;});
+                break;
+
+            case Mnemonic::STA: store <Isa> (a, operand, ac); break;
+            case Mnemonic::STX: store <Isa> (a, operand, xr); break;
+            case Mnemonic::STY: store <Isa> (a, operand, yr); break;
+
+            case Mnemonic::CMP: compare <Isa> (a, ac, fetch <Isa> (a, operand)); break;
+            case Mnemonic::CPX: compare <Isa> (a, xr, fetch <Isa> (a, operand)); break;
+            case Mnemonic::CPY: compare <Isa> (a, yr, fetch <Isa> (a, operand)); break;
+
+            case Mnemonic::BIT:
+            {
+                // V and N come from the and, not the operand, as in the scalar core
+                const std::uint8_t* const m = fetch <Isa> (a, operand);
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    const std::uint8_t t = ac[i] & m[i];
+                    const std::uint8_t flags = (t & (N | V)) | (t == 0 ? Z : 0);
+                    sr[i] = g[i] ? static_cast <std::uint8_t> ((sr[i] & ~(N | V | Z)) | flags) : sr[i];
+                }
+                break;
+            }
+
+            case Mnemonic::ADC:
+            {
+                // decimal mode is ignored and Z looks at the 9 bit sum, both like the scalar core
+                const std::uint8_t* const m = fetch <Isa> (a, operand);
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    const std::uint16_t sum = ac[i] + m[i] + (sr[i] & C);
+                    const std::uint8_t result = sum & 0xFF;
+                    const std::uint8_t flags = (result & N) | (sum == 0 ? Z : 0) | (sum > 0xFF ? C : 0)
+                                             | ((result ^ ac[i]) & (result ^ m[i]) & 0x80 ? V : 0);
+                    sr[i] = g[i] ? static_cast <std::uint8_t> ((sr[i] & ~(N | V | Z | C)) | flags) : sr[i];
+                    ac[i] = g[i] ? result : ac[i];
+                }
+                break;
+            }
+
+            case Mnemonic::SBC:
+            {
+                // the scalar core's 16 bit result is never below zero so C always ends up set
+                const std::uint8_t* const m = fetch <Isa> (a, operand);
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    const std::uint8_t carry = sr[i] & C;
+                    const std::uint8_t result = ac[i] - m[i] - 1 + carry;
+                    const bool zero = ac[i] + carry == m[i] + 1;
+                    const std::uint8_t flags = (result & N) | (zero ? Z : 0) | C
+                                             | ((result ^ ac[i]) & (result ^ ~m[i]) & 0x80 ? V : 0);
+                    sr[i] = g[i] ? static_cast <std::uint8_t> ((sr[i] & ~(N | V | Z | C)) | flags) : sr[i];
+                    ac[i] = g[i] ? result : ac[i];
+                }
+                break;
+            }
+
+            // ASL sets C for any non zero operand and ROL doesn't rotate C in, both as the scalar core does
+            case Mnemonic::ASL:
+                modify <Isa> (a, operand, accumulator, N | Z | C, [] (const std::uint8_t m, const std::uint8_t, std::uint8_t& carry) -> std::uint8_t
+                {
+                    carry = m != 0 ? C : 0;
+                    return m << 1;
+                });
+                break;
+            case Mnemonic::ROL:
+                modify <Isa> (a, operand, accumulator, N | Z | C, [] (const std::uint8_t m, const std::uint8_t, std::uint8_t& carry) -> std::uint8_t
+                {
+                    carry = m >> 7;
+                    return m << 1;
+                });
+                break;
+            case Mnemonic::LSR:
+                modify <Isa> (a, operand, accumulator, N | Z | C, [] (const std::uint8_t m, const std::uint8_t, std::uint8_t& carry) -> std::uint8_t
+                {
+                    carry = m & C;
+                    return m >> 1;
+                });
+                break;
+            case Mnemonic::ROR:
+                modify <Isa> (a, operand, accumulator, N | Z | C, [] (const std::uint8_t m, const std::uint8_t c, std::uint8_t& carry) -> std::uint8_t
+                {
+                    carry = m & C;
+                    return (m >> 1) | (c << 7);
+                });
+                break;
+
+            case Mnemonic::CLC: set_flags <Isa> (a, C, 0); break;
+            case Mnemonic::SEC: set_flags <Isa> (a, 0, C); break;
+            case Mnemonic::CLI: set_flags <Isa> (a, I, 0); break;
+            case Mnemonic::SEI: set_flags <Isa> (a, 0, I); break;
+            case Mnemonic::CLV: set_flags <Isa> (a, V, 0); break;
+            case Mnemonic::CLD: set_flags <Isa> (a, D, 0); break;
+            case Mnemonic::SED: set_flags <Isa> (a, 0, D); break;
+
+            case Mnemonic::PHA: push <Isa> (a, ac, 1); break;
+            case Mnemonic::PHP:
+                for (std::size_t i = 0; i < n; ++i)
+                    data[i] = sr[i] | B | U;
+                push <Isa> (a, data, 1);
+                break;
+            case Mnemonic::PLA:
+                pop <Isa> (a, data);
+                load <Isa> (a, ac, data, pass);
+                break;
+            case Mnemonic::PLP:
+                pop <Isa> (a, data);
+                for (std::size_t i = 0; i < n; ++i)
+                    sr[i] = g[i] ? data[i] : sr[i];
+                break;
+
+            case Mnemonic::JMP:
+                jump <Isa> (a, operand);
+                pc_done = true;
+                same_pc = !operand.per_lane;
+                break;
+            case Mnemonic::JSR:
+            {
+                // pushes the address after the operand, RTS doesn't add one back
+                const std::uint8_t high = next >> 8;
+                const std::uint8_t low  = next & 0xFF;
+                push <Isa> (a, &high, 0);
+                push <Isa> (a, &low, 0);
+                jump <Isa> (a, operand);
+                pc_done = true;
+                break;
+            }
+            case Mnemonic::RTS:
+            case Mnemonic::RTI:
+            {
+                std::uint16_t* const address = a.address;
+                if (ins.mnemonic == Mnemonic::RTI)
+                {
+                    pop <Isa> (a, data);
+                    for (std::size_t i = 0; i < n; ++i)
+                        sr[i] = g[i] ? static_cast <std::uint8_t> (data[i] & ~(B | U)) : sr[i];
+                }
+                pop <Isa> (a, data);
+                for (std::size_t i = 0; i < n; ++i)
+                    address[i] = data[i];
+                pop <Isa> (a, data);
+                for (std::size_t i = 0; i < n; ++i)
+                    address[i] |= data[i] << 8;
+                jump <Isa> (a, {true, 0});
+                pc_done = true;
+                same_pc = false;
+                break;
+            }
+            case Mnemonic::BRK:
+            {
+                // the high byte goes through a byte parameter in the scalar core and comes out as 0
+                const std::uint8_t high = 0;
+                const std::uint8_t low  = (next + 1) & 0xFF;
+                push <Isa> (a, &high, 0);
+                push <Isa> (a, &low, 0);
+                for (std::size_t i = 0; i < n; ++i)
+                    data[i] = sr[i] | B | U;
+                push <Isa> (a, data, 1);
+                set_flags <Isa> (a, 0, I);
+                const std::uint16_t vector = rom[MOS_6502::irq_vector_low - 0x8000] | (rom[MOS_6502::irq_vector_high - 0x8000] << 8);
+                jump <Isa> (a, {false, vector});
+                pc_done = true;
+                break;
+            }
+
+            case Mnemonic::BPL: taken_count = branch <Isa> (a, operand.uniform, next, N, 0, false); break;
+            case Mnemonic::BMI: taken_count = branch <Isa> (a, operand.uniform, next, N, N, false); break;
+            case Mnemonic::BVC: taken_count = branch <Isa> (a, operand.uniform, next, V, 0, true);  break;
+            case Mnemonic::BVS: taken_count = branch <Isa> (a, operand.uniform, next, V, V, false); break;
+            case Mnemonic::BCC: taken_count = branch <Isa> (a, operand.uniform, next, C, 0, false); break;
+            case Mnemonic::BCS: taken_count = branch <Isa> (a, operand.uniform, next, C, C, false); break;
+            case Mnemonic::BNE: taken_count = branch <Isa> (a, operand.uniform, next, Z, 0, false); break;
+            case Mnemonic::BEQ: taken_count = branch <Isa> (a, operand.uniform, next, Z, Z, false); break;
+
+            case Mnemonic::NOP:
+            case Mnemonic::___:
+                break;
+        }
+
+        if (ins.addr_mode == Mode::REL)
+        {
+            has_extra = true;
+            pc_done = true;
+        }
+        if (!pc_done)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                pc[i] = g[i] ? next : pc[i];
+        }
+
+        const std::uint8_t base = static_cast <std::uint8_t> (ins.cycle_count);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            const std::uint8_t used = base + (has_extra ? extra[i] : 0);
+            cycles[i] += g[i] ? used : 0;
+            instructions[i] += g[i] & 1;
+        }
+
+        if (ins.addr_mode == Mode::REL)
+            return taken_count == 0 || taken_count == a.count;
+        if (same_pc)
+            return true;
+
+        // per lane jumps, check whether they all went to the same place
+        std::uint16_t landed = 0;
+        return shared <Isa> (a, static_cast <const std::uint16_t*> (pc), landed);
+    }
+}
+
+#endif
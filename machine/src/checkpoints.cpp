@@ -0,0 +1,113 @@
+#include "checkpoints.h"
+#include <algorithm>
+
+Checkpoints::Checkpoints (const std::size_t _capacity, const std::uint64_t _interval)
+: capacity {std::max <std::size_t> (_capacity, 1)}
+, interval {std::max <std::uint64_t> (_interval, 1)}
+, mu {}
+, states {}
+, next_cycle {0}
+, last_cycle {0}
+, oldest {0}
+, furthest {0}
+, position {0}
+{
+}
+
+void Checkpoints::take (Machine& machine)
+{
+    Save_State state = machine.save ();
+    const std::uint64_t cycles = state.cycles;
+    const std::uint64_t instructions = state.instructions;
+
+    std::lock_guard lock (mu);
+
+    // a different rom, or anything at or past this point, belongs to a history that's just been left
+    if (!states.empty() && states.back().rom_hash != state.rom_hash)
+        states.clear ();
+    bool diverged = cycles < last_cycle;
+    while (!states.empty() && states.back().cycles >= cycles)
+    {
+        states.pop_back ();
+        diverged = true;
+    }
+    if (diverged)
+        furthest.store (instructions, std::memory_order_relaxed);
+
+    states.push_back (std::move (state));
+    if (states.size() > capacity)
+        states.pop_front ();
+    oldest.store (states.front().instructions, std::memory_order_relaxed);
+
+    next_cycle = cycles + interval;
+    last_cycle = cycles;
+}
+
+template <typename Key>
+bool Checkpoints::seek (Machine& machine, const std::uint64_t target, Key key)
+{
+    const auto now = [&machine, &key] () {return key (machine.cycles (), machine.instructions ());};
+
+    // the newest checkpoint at or before the target
+    const auto after = std::ranges::upper_bound (states, target, {}, [&key] (const Save_State& state) {return key (state.cycles, state.instructions);});
+    if (after == states.begin())
+        return false;
+    const Save_State& checkpoint = *std::prev (after);
+
+    // when the machine is already between the checkpoint and the target carrying on is shorter
+    if (now () > target || now () < key (checkpoint.cycles, checkpoint.instructions))
+    {
+        if (!machine.load (checkpoint))
+            return false;
+    }
+    // anything reachable comes before the next checkpoint, or within an interval of the newest one
+    const std::uint64_t limit = after == states.end() ? checkpoint.cycles + interval : std::max (after->cycles, checkpoint.cycles + interval);
+    while (now () < target && machine.cycles () < limit)
+        machine.step ();
+
+    // still the same history so the later checkpoints stay, update just mustn't take the jump back as a reset
+    // running on from here replaces them one by one as it gets to them
+    last_cycle = machine.cycles ();
+    next_cycle = checkpoint.cycles + interval;
+    position.store (machine.instructions (), std::memory_order_relaxed);
+    return now () >= target;
+}
+
+bool Checkpoints::seek_instruction (Machine& machine, const std::uint64_t instruction)
+{
+    if (instruction > last ())
+        return false;
+    return seek (machine, instruction, [] (const std::uint64_t, const std::uint64_t instructions) {return instructions;});
+}
+
+bool Checkpoints::seek_cycle (Machine& machine, const std::uint64_t cycle)
+{
+    if (states.empty() || cycle > states.back().cycles + interval)
+        return false;
+    return seek (machine, cycle, [] (const std::uint64_t cycles, const std::uint64_t) {return cycles;});
+}
+
+void Checkpoints::clear ()
+{
+    std::lock_guard lock (mu);
+    states.clear ();
+    next_cycle = 0;
+    last_cycle = 0;
+    oldest.store (0, std::memory_order_relaxed);
+    furthest.store (0, std::memory_order_relaxed);
+}
+
+std::size_t Checkpoints::count () const
+{
+    std::lock_guard lock (mu);
+    return states.size ();
+}
+
+std::size_t Checkpoints::memory () const
+{
+    std::lock_guard lock (mu);
+    std::size_t total = 0;
+    for (const auto& state : states)
+        total += state.size ();
+    return total;
+}
@@ -0,0 +1,175 @@
+#include "hash_trace.h"
+#include "machine.h"
+#include <array>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    constexpr std::array <char, 8> magic = {'6', '5', '0', '2', 'H', 'S', 'H', '\0'};
+    constexpr std::uint32_t format_version = 1;
+
+    struct Header
+    {
+        std::array <char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t reserved;
+        std::uint64_t interval;
+        std::uint64_t sample_count;
+    };
+
+    void run_to (Machine& machine, const std::uint64_t instruction)
+    {
+        while (machine.instructions () < instruction)
+            machine.step ();
+    }
+}
+
+void Hash_Trace::set_interval (const std::uint64_t _interval)
+{
+    interval = _interval;
+    next = 0;
+}
+
+void Hash_Trace::update (Machine& machine)
+{
+    const std::uint64_t instruction = machine.instructions ();
+    if (interval == 0 || instruction < next)
+        return;
+    // a reset or a seek backwards starts a new history, the old samples don't describe it
+    if (!taken.empty() && taken.back().instruction >= instruction)
+        clear ();
+    if (instruction % interval == 0)
+    {
+        taken.push_back ({instruction, machine.state_hash ()});
+        sample_count.store (taken.size(), std::memory_order_relaxed);
+    }
+    next = (instruction / interval + 1) * interval;
+}
+
+void Hash_Trace::clear ()
+{
+    taken.clear ();
+    next = 0;
+    sample_count.store (0, std::memory_order_relaxed);
+}
+
+std::optional <std::uint64_t> Hash_Trace::first_mismatch (const Hash_Trace& a, const Hash_Trace& b)
+{
+    auto left = a.taken.begin();
+    auto right = b.taken.begin();
+    while (left != a.taken.end() && right != b.taken.end())
+    {
+        if (left->instruction < right->instruction)
+            ++left;
+        else if (right->instruction < left->instruction)
+            ++right;
+        else if (left->hash != right->hash)
+            return left->instruction;
+        else
+        {
+            ++left;
+            ++right;
+        }
+    }
+    return std::nullopt;
+}
+
+bool Hash_Trace::write (const std::filesystem::path& path) const
+{
+    const Header header {magic, format_version, 0, interval, taken.size()};
+
+    std::error_code error;
+    std::filesystem::create_directories (path.parent_path(), error);
+
+    // written beside and renamed like a save state, so a crash never leaves half a trace over a whole one
+    const auto temporary = std::filesystem::path(path).concat(".tmp");
+    {
+        std::ofstream output (temporary, std::ios::binary | std::ios::trunc);
+        output.write (reinterpret_cast <const char*> (&header), sizeof(header));
+        output.write (reinterpret_cast <const char*> (taken.data()), taken.size() * sizeof(Sample));
+        if (!output)
+        {
+            std::cerr << temporary << " could not be written" << std::endl;
+            return false;
+        }
+    }
+
+    std::filesystem::rename (temporary, path, error);
+    if (error)
+    {
+        std::cerr << path << ": " << error.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Hash_Trace::read (const std::filesystem::path& path)
+{
+    std::ifstream input (path, std::ios::binary);
+    Header header;
+    if (!input.read (reinterpret_cast <char*> (&header), sizeof(header)) || header.magic != magic || header.version != format_version)
+    {
+        std::cerr << path << " is not a hash trace" << std::endl;
+        return false;
+    }
+    // the header is checked against the file before it sizes anything
+    std::error_code error;
+    const std::uintmax_t file_size = std::filesystem::file_size (path, error);
+    if (error || header.sample_count > (file_size - sizeof(header)) / sizeof(Sample))
+    {
+        std::cerr << path << " is truncated" << std::endl;
+        return false;
+    }
+    std::vector <Sample> samples (header.sample_count);
+    if (!input.read (reinterpret_cast <char*> (samples.data()), samples.size() * sizeof(Sample)))
+    {
+        std::cerr << path << " is truncated" << std::endl;
+        return false;
+    }
+    interval = header.interval;
+    next = 0;
+    taken = std::move (samples);
+    sample_count.store (taken.size(), std::memory_order_relaxed);
+    return true;
+}
+
+std::optional <std::uint64_t> find_divergence (Machine& a, Machine& b, const std::uint64_t end)
+{
+    if (a.instructions () != b.instructions () || a.state_hash () != b.state_hash ())
+        return a.instructions ();
+
+    std::uint64_t low = a.instructions ();
+    Save_State low_a = a.save ();
+    Save_State low_b = b.save ();
+
+    run_to (a, end);
+    run_to (b, end);
+    if (a.state_hash () == b.state_hash ())
+        return std::nullopt;
+
+    // the hashes agree at low and differ at high
+    std::uint64_t high = end;
+    while (high - low > 1)
+    {
+        const std::uint64_t middle = low + (high - low) / 2;
+        a.load (low_a);
+        b.load (low_b);
+        run_to (a, middle);
+        run_to (b, middle);
+        if (a.state_hash () == b.state_hash ())
+        {
+            low = middle;
+            low_a = a.save ();
+            low_b = b.save ();
+        }
+        else
+            high = middle;
+    }
+
+    a.load (low_a);
+    b.load (low_b);
+    run_to (a, high);
+    run_to (b, high);
+    return high;
+}
@@ -0,0 +1,253 @@
+#include "input_log.h"
+#include "machine.h"
+#include <array>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    constexpr std::array <char, 8> magic = {'6', '5', '0', '2', 'I', 'N', 'P', '\0'};
+    constexpr std::uint32_t format_version = 1;
+
+    struct Header
+    {
+        std::array <char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t event_count;
+        std::uint64_t irq_period;
+        std::uint64_t end_instruction;
+        std::uint64_t end_cycle;
+        std::uint64_t events_size;
+    };
+
+    void put_varint (std::vector <std::uint8_t>& output, std::uint64_t value)
+    {
+        for (; value >= 0x80; value >>= 7)
+            output.push_back (static_cast <std::uint8_t> (value | 0x80));
+        output.push_back (static_cast <std::uint8_t> (value));
+    }
+
+    bool get_varint (const std::vector <std::uint8_t>& input, std::size_t& position, std::uint64_t& value)
+    {
+        value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            if (position >= input.size())
+                return false;
+            const std::uint8_t byte = input[position++];
+            value |= std::uint64_t {byte & 0x7Fu} << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool has_address (const Input_Log::Kind kind)
+    {
+        return kind == Input_Log::Kind::poke || kind == Input_Log::Kind::rom_patch;
+    }
+
+    // the most one event packs into: three 10 byte varints, the kind and the value
+    constexpr std::uint64_t max_event_size = 32;
+
+    // steps to the instruction, skipping whole turns of an idle loop on the way. the skip stays short of
+    // both counts so the last steps are real and the cycle check after still means something
+    void run_to (Machine& machine, const std::uint64_t instruction, const std::uint64_t cycle)
+    {
+        while (machine.instructions () < instruction)
+        {
+            machine.step ();
+            if (machine.idle ())
+                machine.skip_idle (cycle, instruction);
+        }
+    }
+}
+
+void Input_Log::begin (Machine& machine)
+{
+    start            = machine.save ();
+    irq_period       = machine.get_irq_period ();
+    last_instruction = start.instructions;
+    last_cycle       = start.cycles;
+    end_instruction  = start.instructions;
+    end_cycle        = start.cycles;
+    event_count      = 0;
+    events.clear ();
+    started  = true;
+    finished = false;
+}
+
+void Input_Log::finish (const Machine& machine)
+{
+    if (!recording())
+        return;
+    end_instruction = machine.instructions ();
+    end_cycle       = machine.cycles ();
+    finished = true;
+}
+
+void Input_Log::append (const Event& event)
+{
+    if (!recording())
+        return;
+    put_varint (events, event.instruction - last_instruction);
+    put_varint (events, event.cycle - last_cycle);
+    events.push_back (static_cast <std::uint8_t> (event.kind));
+    if (has_address (event.kind))
+    {
+        put_varint (events, event.address);
+        events.push_back (event.value);
+    }
+    last_instruction = event.instruction;
+    last_cycle       = event.cycle;
+    ++event_count;
+}
+
+bool Input_Log::replay (Machine& machine) const
+{
+    if (!started)
+        return false;
+
+    machine.record (nullptr);
+    machine.set_irq_period (irq_period);
+    if (!machine.load (start))
+        return false;
+
+    std::size_t position = 0;
+    std::uint64_t instruction = start.instructions;
+    std::uint64_t cycle = start.cycles;
+    for (std::size_t i = 0; i < event_count; ++i)
+    {
+        std::uint64_t instruction_delta;
+        std::uint64_t cycle_delta;
+        std::uint64_t address = 0;
+        if (!get_varint (events, position, instruction_delta) || !get_varint (events, position, cycle_delta) || position >= events.size())
+        {
+            std::cerr << "input log is truncated at event " << i << std::endl;
+            return false;
+        }
+        const Kind kind = static_cast <Kind> (events[position++]);
+        std::uint8_t value = 0;
+        if (has_address (kind))
+        {
+            if (!get_varint (events, position, address) || position >= events.size())
+            {
+                std::cerr << "input log is truncated at event " << i << std::endl;
+                return false;
+            }
+            value = events[position++];
+        }
+        instruction += instruction_delta;
+        cycle += cycle_delta;
+
+        run_to (machine, instruction, cycle);
+        if (machine.cycles () != cycle)
+        {
+            std::cerr << "replay diverged before instruction " << instruction << ": cycle " << machine.cycles ()
+                      << ", recorded " << cycle << std::endl;
+            return false;
+        }
+
+        switch (kind)
+        {
+            case Kind::irq:       machine.raise_irq (); break;
+            case Kind::nmi:       machine.raise_nmi (); break;
+            case Kind::poke:      machine.poke (static_cast <std::uint16_t> (address), value); break;
+            case Kind::rom_patch: machine.patch_rom (static_cast <std::uint32_t> (address), value); break;
+            default:
+                std::cerr << "input log has an unknown event at " << i << std::endl;
+                return false;
+        }
+    }
+
+    run_to (machine, end_instruction, end_cycle);
+    if (machine.cycles () != end_cycle)
+    {
+        std::cerr << "replay ended on cycle " << machine.cycles () << ", recorded " << end_cycle << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Input_Log::write (const std::filesystem::path& path) const
+{
+    const Header header {magic, format_version, static_cast <std::uint32_t> (event_count), irq_period,
+                         end_instruction, end_cycle, events.size()};
+
+    std::error_code error;
+    std::filesystem::create_directories (path.parent_path(), error);
+
+    // written beside and renamed like a save state, so a crash never leaves half a log over a whole one
+    const auto temporary = std::filesystem::path(path).concat(".tmp");
+    {
+        std::ofstream output (temporary, std::ios::binary | std::ios::trunc);
+        if (!output.is_open())
+        {
+            std::cerr << temporary << " could not be written" << std::endl;
+            return false;
+        }
+        output.write (reinterpret_cast <const char*> (&header), sizeof(header));
+        start.write (output);
+        output.write (reinterpret_cast <const char*> (events.data()), events.size());
+        if (!output)
+        {
+            std::cerr << temporary << " could not be written" << std::endl;
+            return false;
+        }
+    }
+
+    std::filesystem::rename (temporary, path, error);
+    if (error)
+    {
+        std::cerr << path << ": " << error.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Input_Log::read (const std::filesystem::path& path)
+{
+    std::ifstream input (path, std::ios::binary);
+    if (!input.is_open())
+    {
+        std::cerr << path << " could not be opened" << std::endl;
+        return false;
+    }
+
+    Header header;
+    Save_State state;
+    if (!input.read (reinterpret_cast <char*> (&header), sizeof(header)) || header.magic != magic
+        || header.version != format_version || !state.read (input))
+    {
+        std::cerr << path << " is not an input log" << std::endl;
+        return false;
+    }
+    // the header is checked against the file before it sizes anything
+    std::error_code error;
+    const std::uintmax_t file_size = std::filesystem::file_size (path, error);
+    const std::streamoff position = input.tellg ();
+    if (error || position < 0 || header.events_size > file_size - position
+        || header.events_size > header.event_count * max_event_size)
+    {
+        std::cerr << path << " is truncated or corrupt" << std::endl;
+        return false;
+    }
+    std::vector <std::uint8_t> bytes (header.events_size);
+    if (!input.read (reinterpret_cast <char*> (bytes.data()), bytes.size()))
+    {
+        std::cerr << path << " is truncated" << std::endl;
+        return false;
+    }
+
+    start            = std::move (state);
+    irq_period       = header.irq_period;
+    end_instruction  = header.end_instruction;
+    end_cycle        = header.end_cycle;
+    last_instruction = end_instruction;
+    last_cycle       = end_cycle;
+    event_count      = header.event_count;
+    events           = std::move (bytes);
+    started  = true;
+    finished = true;
+    return true;
+}
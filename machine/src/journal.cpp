@@ -0,0 +1,122 @@
+#include "journal.h"
+#include <algorithm>
+#include <bit>
+
+namespace
+{
+    constexpr std::uint8_t count_mask = 0x1F;
+    constexpr std::uint8_t irq_bit    = 1 << 5;
+    constexpr std::uint8_t nmi_bit    = 1 << 6;
+    constexpr std::uint8_t bank_bit   = 1 << 7;
+
+    constexpr std::size_t register_bytes = 7;
+    constexpr std::size_t max_entry      = 1 + Undo_Journal::max_writes * 3 + 1 + register_bytes + 1 + 1;
+}
+
+Undo_Journal::Undo_Journal (const std::size_t capacity)
+: ring (std::bit_ceil (std::max (capacity, max_entry)))
+, head {0}
+, used {0}
+, entries {0}
+{
+}
+
+std::size_t Undo_Journal::entry_size (const std::uint8_t tag)
+{
+    return 1 + (tag & count_mask) * 3 + ((tag & bank_bit) ? 1 : 0) + register_bytes + 1 + 1;
+}
+
+void Undo_Journal::drop_oldest ()
+{
+    const std::size_t tail = head + ring.size() - used;
+    used -= entry_size (at (tail));
+    entries.store (entries.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+}
+
+void Undo_Journal::push (const Entry& entry)
+{
+    if (entry.write_count > max_writes)
+    {
+        clear ();
+        return;
+    }
+
+    const std::uint8_t tag = static_cast <std::uint8_t> (entry.write_count | (entry.irq_pending ? irq_bit : 0)
+                                                         | (entry.nmi_pending ? nmi_bit : 0) | (entry.bank ? bank_bit : 0));
+
+    const std::size_t size = entry_size (tag);
+    while (ring.size() - used < size)
+        drop_oldest ();
+
+    // written straight into the ring, entries are a dozen bytes so there's nothing to gain from memcpy
+    const std::size_t mask = ring.size() - 1;
+    std::size_t offset = head;
+    const auto put = [this, mask, &offset] (const std::uint8_t value) {ring[offset++ & mask] = value;};
+
+    put (tag);
+    for (std::size_t i = 0; i < entry.write_count; ++i)
+    {
+        put (entry.writes[i].address & 0xFF);
+        put (entry.writes[i].address >> 8);
+        put (entry.writes[i].old_value);
+    }
+    if (entry.bank)
+        put (*entry.bank);
+    const auto& r = entry.registers;
+    put (r.PC & 0xFF);
+    put (r.PC >> 8);
+    put (r.AC);
+    put (r.XR);
+    put (r.YR);
+    put (r.SR);
+    put (r.SP);
+    put (entry.cycles);
+    put (tag);
+
+    head = (head + size) & (ring.size() - 1);
+    used += size;
+    entries.store (entries.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+bool Undo_Journal::pop (Entry& entry)
+{
+    if (used == 0)
+        return false;
+
+    // walk back from the trailing tag, head + ring.size() keeps the offsets positive
+    std::size_t offset = head + ring.size() - 1;
+    const std::uint8_t tag = at (offset);
+
+    entry.cycles = at (--offset);
+    auto& r = entry.registers;
+    r.SP = at (--offset);
+    r.SR = at (--offset);
+    r.YR = at (--offset);
+    r.XR = at (--offset);
+    r.AC = at (--offset);
+    r.PC = at (--offset) << 8;
+    r.PC |= at (--offset);
+    entry.bank = (tag & bank_bit) ? std::optional <std::uint8_t> (at (--offset)) : std::nullopt;
+    entry.write_count = tag & count_mask;
+    for (std::size_t i = entry.write_count; i-- > 0;)
+    {
+        entry.writes[i].old_value = at (--offset);
+        entry.writes[i].address   = at (--offset) << 8;
+        entry.writes[i].address  |= at (--offset);
+    }
+    entry.irq_pending = tag & irq_bit;
+    entry.nmi_pending = tag & nmi_bit;
+
+    const std::size_t size = entry_size (tag);
+    head = (head + ring.size() - size) & (ring.size() - 1);
+    used -= size;
+    entries.store (entries.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    return true;
+}
+
+void Undo_Journal::clear ()
+{
+    head = 0;
+    used = 0;
+    entries.store (0, std::memory_order_relaxed);
+}
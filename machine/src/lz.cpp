@@ -0,0 +1,153 @@
+#include "lz.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace
+{
+    constexpr std::size_t min_match   = 4;
+    constexpr std::size_t max_offset  = 0xFFFF;
+    // the table shrinks with the input so compressing a single page doesn't clear 16kb
+    constexpr std::size_t max_hash_bits = 12;
+    constexpr std::size_t min_hash_bits = 8;
+    // the last bytes are always literals so the match finder can read 4 bytes without checking
+    constexpr std::size_t end_literals = 5;
+
+    std::uint32_t load32 (const std::uint8_t* p)
+    {
+        std::uint32_t value;
+        std::memcpy (&value, p, sizeof(value));
+        return value;
+    }
+
+    std::uint32_t hash (const std::uint32_t value, const std::size_t bits)
+    {
+        return (value * 2654435761u) >> (32 - bits);
+    }
+
+    void put_length (std::vector <std::uint8_t>& output, std::size_t length)
+    {
+        for (; length >= 255; length -= 255)
+            output.push_back (255);
+        output.push_back (static_cast <std::uint8_t> (length));
+    }
+
+    void put_sequence (std::vector <std::uint8_t>& output, const std::uint8_t* literals, const std::size_t literal_count,
+                       const std::size_t match_length, const std::size_t offset)
+    {
+        const std::size_t match_code = match_length == 0 ? 0 : match_length - min_match;
+        output.push_back (static_cast <std::uint8_t> ((std::min <std::size_t> (literal_count, 15) << 4) | std::min <std::size_t> (match_code, 15)));
+        if (literal_count >= 15)
+            put_length (output, literal_count - 15);
+        output.insert (output.end(), literals, literals + literal_count);
+
+        if (match_length == 0)
+            return;
+        output.push_back (offset & 0xFF);
+        output.push_back (offset >> 8);
+        if (match_code >= 15)
+            put_length (output, match_code - 15);
+    }
+
+    bool get_length (std::span <const std::uint8_t> input, std::size_t& position, std::size_t& length)
+    {
+        for (;;)
+        {
+            if (position >= input.size())
+                return false;
+            const std::uint8_t extra = input[position++];
+            length += extra;
+            if (extra != 255)
+                return true;
+        }
+    }
+}
+
+std::size_t lz::compress (std::span <const std::uint8_t> input, std::vector <std::uint8_t>& output)
+{
+    const std::size_t start_size = output.size();
+    const std::uint8_t* const begin = input.data();
+    const std::size_t size = input.size();
+
+    std::size_t hash_bits = min_hash_bits;
+    while (hash_bits < max_hash_bits && (std::size_t {1} << hash_bits) < size)
+        ++hash_bits;
+    std::array <std::uint32_t, 1 << max_hash_bits> table; // position + 1, 0 is empty
+    std::fill_n (table.begin(), std::size_t {1} << hash_bits, 0);
+    std::size_t anchor = 0;
+    std::size_t position = 0;
+
+    if (size > end_literals + min_match)
+    {
+        const std::size_t limit = size - end_literals;
+        while (position < limit)
+        {
+            const std::uint32_t value = load32 (begin + position);
+            auto& slot = table[hash (value, hash_bits)];
+            const std::size_t candidate = slot;
+            slot = static_cast <std::uint32_t> (position + 1);
+
+            if (candidate == 0 || position - (candidate - 1) > max_offset || load32 (begin + candidate - 1) != value)
+            {
+                ++position;
+                continue;
+            }
+
+            const std::size_t match = candidate - 1;
+            std::size_t length = min_match;
+            while (position + length < limit && begin[match + length] == begin[position + length])
+                ++length;
+
+            put_sequence (output, begin + anchor, position - anchor, length, position - match);
+            position += length;
+            anchor = position;
+        }
+    }
+
+    put_sequence (output, begin + anchor, size - anchor, 0, 0);
+    return output.size() - start_size;
+}
+
+bool lz::decompress (std::span <const std::uint8_t> input, std::span <std::uint8_t> output)
+{
+    std::size_t in = 0;
+    std::size_t out = 0;
+
+    while (in < input.size())
+    {
+        const std::uint8_t token = input[in++];
+
+        std::size_t literals = token >> 4;
+        if (literals == 15 && !get_length (input, in, literals))
+            return false;
+        if (in + literals > input.size() || out + literals > output.size())
+            return false;
+        std::memcpy (output.data() + out, input.data() + in, literals);
+        in += literals;
+        out += literals;
+
+        // the last sequence stops after its literals
+        if (in == input.size())
+            break;
+
+        if (in + 2 > input.size())
+            return false;
+        const std::size_t offset = input[in] | (input[in + 1] << 8);
+        in += 2;
+
+        std::size_t length = token & 0x0F;
+        if (length == 15 && !get_length (input, in, length))
+            return false;
+        length += min_match;
+
+        if (offset == 0 || offset > out || out + length > output.size())
+            return false;
+
+        // byte at a time because the source can overlap what's being written, that's how runs are encoded
+        const std::uint8_t* source = output.data() + out - offset;
+        for (std::size_t i = 0; i < length; ++i)
+            output[out + i] = source[i];
+        out += length;
+    }
+    return out == output.size();
+}
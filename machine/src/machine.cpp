@@ -0,0 +1,503 @@
+#include "machine.h"
+#include "hash.h"
+#include "lz.h"
+#include <algorithm>
+#include <iostream>
+
+Machine::Machine ()
+: Machine {UINT16_MAX/2, UINT16_MAX}
+{
+}
+
+Machine::Machine (std::shared_ptr <const Rom_Image> image, std::shared_ptr <Page_Pool> pool)
+: Machine {0, 0}
+{
+    loaded_hash = image ? image->hash () : 0;
+    bus.map_shared (std::move (image), std::move (pool));
+    reset ();
+}
+
+Machine::Machine (const std::uint16_t rom_size, const std::uint16_t ram_size)
+: rom {rom_size}
+, ram {ram_size}
+, bus {rom, ram}
+, cpu {[this] (const auto address) {return bus.read(address);},
+       [this] (const auto address, const auto data) {
+           // rom writes only select a bank and the bank is saved whole, so only ram needs the old byte
+           if (journal && (address >> 8) < Bus::ram_pages && undo.write_count < Undo_Journal::max_writes + 1)
+           {
+               if (undo.write_count < Undo_Journal::max_writes)
+                   undo.writes[undo.write_count] = {address, bus.peek(address)};
+               ++undo.write_count;
+           }
+           ++write_count;
+           bus.write(address, data);
+       }}
+, cycle_count {0}
+, instruction_count {0}
+, loaded_hash {0}
+, irq_period {0}
+, irq_pending {false}
+, nmi_pending {false}
+, input_log {nullptr}
+, idle_search {false}
+, idle_loop {{}, 0, 0, 0, 1, 0, 0, 0}
+, write_count {0}
+, journal {}
+, undo {}
+, page_blocks {}
+, page_generations {}
+, page_cached {}
+, page_hashes {}
+, page_hash_generations {}
+, group_hashes {}
+, page_hashed {}
+{
+}
+
+bool Machine::load_rom (const std::string& path)
+{
+    unload ();
+    if (bus.shared ())
+        return map_image (Rom_Image::load (path, 0x8000));
+    return map_rom (rom.load (path, 0x8000));
+}
+
+bool Machine::load_rom (std::span <const std::uint8_t> image)
+{
+    unload ();
+    if (bus.shared ())
+        return map_image (Rom_Image::copy (image));
+    return map_rom (rom.assign (image));
+}
+
+bool Machine::map_image (std::shared_ptr <const Rom_Image> image)
+{
+    const bool loaded = image != nullptr;
+    loaded_hash = loaded ? image->hash () : 0;
+    bus.map_shared (std::move (image), bus.page_pool ());
+    reset ();
+    return loaded;
+}
+
+bool Machine::map_rom (const bool loaded)
+{
+    bus.map ();
+    if (loaded)
+        loaded_hash = content_hash::hash ({rom.data(), rom.size()});
+    reset ();
+    return loaded;
+}
+
+void Machine::unload ()
+{
+    rom.reset ();
+    ram.reset ();
+    if (bus.shared ())
+        bus.map_shared (nullptr, bus.page_pool ());
+    else
+        bus.map ();
+    loaded_hash = 0;
+    page_cached.reset ();
+    reset ();
+}
+
+void Machine::reset ()
+{
+    stop_recording ();
+    forget_idle ();
+    if (journal)
+        journal->clear ();
+    cycle_count = cpu.reset ();
+    instruction_count = 0;
+    irq_pending = false;
+    nmi_pending = false;
+}
+
+void Machine::restart ()
+{
+    ram.reset ();
+    bus.map ();
+    page_cached.reset ();
+    reset ();
+}
+
+std::unique_ptr <Machine> Machine::fork ()
+{
+    if (!bus.shared ())
+    {
+        std::cerr << "only a machine on shared memory can be forked" << std::endl;
+        return nullptr;
+    }
+
+    std::unique_ptr <Machine> child (new Machine {0, 0});
+    child->bus.fork_from (bus);
+    child->cpu.set_registers (cpu.get_registers ());
+    child->cycle_count       = cycle_count;
+    child->instruction_count = instruction_count;
+    child->loaded_hash       = loaded_hash;
+    child->irq_period        = irq_period;
+    child->irq_pending       = irq_pending;
+    child->nmi_pending       = nmi_pending;
+    child->idle_search       = idle_search;
+    child->forget_idle ();
+
+    // the generations came across with the pages so the parent's page hashes still hold
+    child->page_hashes           = page_hashes;
+    child->page_hash_generations = page_hash_generations;
+    child->group_hashes          = group_hashes;
+    child->page_hashed           = page_hashed;
+    return child;
+}
+
+int Machine::step ()
+{
+    if (journal)
+    {
+        undo.registers   = cpu.get_registers ();
+        undo.irq_pending = irq_pending;
+        undo.nmi_pending = nmi_pending;
+        undo.bank        = bus.bank_count () > 1 ? std::optional <std::uint8_t> (bus.bank ()) : std::nullopt;
+        undo.write_count = 0;
+    }
+
+    int cycles = 0;
+    if (nmi_pending || irq_pending)
+    {
+        if (nmi_pending)
+        {
+            nmi_pending = false;
+            cycles += cpu.NMI ();
+        }
+        if (irq_pending)
+        {
+            irq_pending = false;
+            cycles += cpu.IRQ ();
+        }
+        forget_idle ();
+    }
+
+    bus.count_execute (cpu.get_PC());
+    cycles += cpu.update ();
+
+    // the timer fires when the count crosses a multiple of the period, no state of its own to save
+    if (irq_period != 0 && cycle_count / irq_period != (cycle_count + cycles) / irq_period)
+        irq_pending = true;
+
+    cycle_count += cycles;
+    ++instruction_count;
+
+    if (journal)
+    {
+        undo.cycles = static_cast <std::uint8_t> (cycles);
+        journal->push (undo);
+    }
+    else if (idle_search)
+        watch_idle ();
+    return cycles;
+}
+
+void Machine::set_idle_skip (const bool enabled)
+{
+    idle_search = enabled;
+    forget_idle ();
+}
+
+bool Machine::idle () const
+{
+    return idle_search && !journal && idle_loop.turn_cycles != 0 && !irq_pending && !nmi_pending
+        && cpu.get_registers () == idle_loop.mark;
+}
+
+std::uint64_t Machine::next_event () const
+{
+    return irq_period != 0 ? (cycle_count / irq_period + 1) * irq_period : UINT64_MAX;
+}
+
+std::uint64_t Machine::skip_idle (const std::uint64_t limit, const std::uint64_t instruction_limit)
+{
+    // the timer fires on the step that reaches next_event, so every skipped turn has to end before it
+    const std::uint64_t end = std::min (limit, next_event ());
+    if (!idle () || end <= cycle_count || instruction_limit <= instruction_count)
+        return 0;
+    const std::uint64_t turns = std::min ((end - 1 - cycle_count) / idle_loop.turn_cycles,
+                                          (instruction_limit - 1 - instruction_count) / idle_loop.turn_instructions);
+    cycle_count       += turns * idle_loop.turn_cycles;
+    instruction_count += turns * idle_loop.turn_instructions;
+    return turns * idle_loop.turn_cycles;
+}
+
+void Machine::watch_idle ()
+{
+    // once found the loop holds until an interrupt or a change from outside calls forget_idle
+    if (idle_loop.turn_cycles != 0)
+        return;
+
+    const MOS_6502::Registers registers = cpu.get_registers ();
+    ++idle_loop.length;
+    if (registers == idle_loop.mark && write_count == idle_loop.mark_writes)
+    {
+        idle_loop.turn_cycles = cycle_count - idle_loop.mark_cycles;
+        idle_loop.turn_instructions = instruction_count - idle_loop.mark_instructions;
+        return;
+    }
+    if (idle_loop.length == idle_loop.power)
+    {
+        idle_loop.mark = registers;
+        idle_loop.mark_cycles = cycle_count;
+        idle_loop.mark_instructions = instruction_count;
+        idle_loop.mark_writes = write_count;
+        idle_loop.power *= 2;
+        idle_loop.length = 0;
+    }
+}
+
+void Machine::forget_idle ()
+{
+    idle_loop.mark = cpu.get_registers ();
+    idle_loop.mark_cycles = cycle_count;
+    idle_loop.mark_instructions = instruction_count;
+    idle_loop.mark_writes = write_count;
+    idle_loop.power = 1;
+    idle_loop.length = 0;
+    idle_loop.turn_cycles = 0;
+    idle_loop.turn_instructions = 0;
+}
+
+void Machine::raise_irq ()
+{
+    log_input (Input_Log::Kind::irq, 0, 0);
+    irq_pending = true;
+}
+
+void Machine::raise_nmi ()
+{
+    log_input (Input_Log::Kind::nmi, 0, 0);
+    nmi_pending = true;
+}
+
+void Machine::poke (const std::uint16_t address, const std::uint8_t value)
+{
+    log_input (Input_Log::Kind::poke, address, value);
+    bus.poke (address, value);
+    forget_idle ();
+}
+
+bool Machine::map (const std::uint16_t address, std::span <const std::uint8_t> image)
+{
+    bool mapped = true;
+    for (std::size_t done = 0; mapped && done < image.size();)
+    {
+        const std::size_t at = address + done;
+        const std::size_t offset = at % Bus::page_size;
+        const std::size_t count = std::min (Bus::page_size - offset, image.size() - done);
+        const auto page = static_cast <std::uint8_t> (at / Bus::page_size);
+
+        // bytes of the page outside the image stay as they are
+        std::array <std::uint8_t, Bus::page_size> contents;
+        std::ranges::copy (bus.page_data (page), contents.begin());
+        std::ranges::copy (image.subspan (done, count), contents.begin() + offset);
+        mapped = bus.load_page (page, contents);
+        for (std::size_t i = 0; mapped && i < count; ++i)
+            log_input (Input_Log::Kind::poke, at + i, contents[offset + i]);
+        done += count;
+    }
+    forget_idle ();
+    return mapped;
+}
+
+void Machine::set_registers (const MOS_6502::Registers& registers)
+{
+    cpu.set_registers (registers);
+    forget_idle ();
+}
+
+void Machine::patch_rom (const std::uint32_t offset, const std::uint8_t value)
+{
+    if (bus.shared ())
+    {
+        std::cerr << "the rom is shared with other machines and can't be patched" << std::endl;
+        return;
+    }
+    if (offset >= rom.size ())
+        return;
+    log_input (Input_Log::Kind::rom_patch, offset, value);
+    forget_idle ();
+
+    // through the bus when the byte is mapped so the page's generation moves and caches see it
+    const std::uint8_t* const byte = rom.data () + offset;
+    for (std::size_t page = Bus::ram_pages; page < Bus::page_count; ++page)
+    {
+        const auto mapped = bus.page_data (page);
+        if (byte >= mapped.data() && byte < mapped.data() + Bus::page_size)
+        {
+            bus.poke (static_cast <std::uint16_t> (page * Bus::page_size + (byte - mapped.data())), value);
+            return;
+        }
+    }
+    rom.data ()[offset] = value;
+}
+
+void Machine::log_input (const Input_Log::Kind kind, const std::uint32_t address, const std::uint8_t value)
+{
+    if (input_log)
+        input_log->append ({instruction_count, cycle_count, kind, address, value});
+}
+
+void Machine::stop_recording ()
+{
+    if (!input_log)
+        return;
+    std::cerr << "recording stopped, the machine was reset or loaded" << std::endl;
+    input_log->finish (*this);
+    input_log = nullptr;
+}
+
+std::uint64_t Machine::state_hash ()
+{
+    for (std::size_t group = 0; group < group_hashes.size(); ++group)
+    {
+        bool changed = false;
+        for (std::size_t i = group * hash_group; i < (group + 1) * hash_group; ++i)
+        {
+            const std::uint32_t generation = bus.generation (i);
+            if (page_hashed[i] && page_hash_generations[i] == generation)
+                continue;
+            page_hashes[i] = content_hash::hash (bus.page_data (i), i);
+            page_hash_generations[i] = generation;
+            page_hashed[i] = true;
+            changed = true;
+        }
+        if (changed)
+            group_hashes[group] = content_hash::hash ({reinterpret_cast <const std::uint8_t*> (page_hashes.data() + group * hash_group),
+                                                       hash_group * sizeof(std::uint64_t)});
+    }
+    const std::uint64_t memory = content_hash::hash ({reinterpret_cast <const std::uint8_t*> (group_hashes.data()),
+                                                      group_hashes.size() * sizeof(std::uint64_t)});
+
+    const MOS_6502::Registers r = cpu.get_registers ();
+    const std::array <std::uint64_t, 4> machine_state
+    {
+        std::uint64_t {r.PC} | std::uint64_t {r.AC} << 16 | std::uint64_t {r.XR} << 24 | std::uint64_t {r.YR} << 32
+            | std::uint64_t {r.SR} << 40 | std::uint64_t {r.SP} << 48 | std::uint64_t {irq_pending} << 56 | std::uint64_t {nmi_pending} << 57,
+        bus.bank (),
+        cycle_count,
+        instruction_count,
+    };
+    return content_hash::hash ({reinterpret_cast <const std::uint8_t*> (machine_state.data()), sizeof(machine_state)}, memory);
+}
+
+void Machine::set_journal (const std::size_t capacity)
+{
+    if (capacity == 0)
+        journal.reset ();
+    else if (!journal || journal->capacity () != capacity)
+        journal = std::make_unique <Undo_Journal> (capacity);
+}
+
+bool Machine::step_back ()
+{
+    Undo_Journal::Entry entry;
+    if (!journal || instruction_count == 0 || !journal->pop (entry))
+        return false;
+
+    // newest write first so a byte written twice ends up with its oldest value
+    for (std::size_t i = entry.write_count; i-- > 0;)
+        bus.poke (entry.writes[i].address, entry.writes[i].old_value);
+    if (entry.bank && *entry.bank != bus.bank ())
+        bus.select_bank (*entry.bank);
+
+    cpu.set_registers (entry.registers);
+    irq_pending = entry.irq_pending;
+    nmi_pending = entry.nmi_pending;
+    cycle_count -= entry.cycles;
+    --instruction_count;
+    forget_idle ();
+    return true;
+}
+
+Save_State Machine::save ()
+{
+    Save_State state;
+    state.registers    = cpu.get_registers ();
+    state.cycles       = cycle_count;
+    state.instructions = instruction_count;
+    state.rom_hash     = loaded_hash;
+    state.bank         = static_cast <std::uint32_t> (bus.bank ());
+    state.irq_pending  = irq_pending;
+    state.nmi_pending  = nmi_pending;
+
+    state.offsets.reserve (Bus::ram_pages + 1);
+    state.offsets.push_back (0);
+    for (std::size_t i = 0; i < Bus::ram_pages; ++i)
+    {
+        // the generation is read before the page so a write racing the copy only forces a recompress next time
+        const std::uint32_t generation = bus.generation (i);
+        if (!page_cached[i] || page_generations[i] != generation)
+        {
+            page_blocks[i].clear ();
+            lz::compress (bus.page_data (i), page_blocks[i]);
+            page_generations[i] = generation;
+            page_cached[i] = true;
+        }
+        state.pages.insert (state.pages.end(), page_blocks[i].begin(), page_blocks[i].end());
+        state.offsets.push_back (static_cast <std::uint32_t> (state.pages.size()));
+    }
+    return state;
+}
+
+bool Machine::load (const Save_State& state)
+{
+    if (state.rom_hash != loaded_hash)
+    {
+        std::cerr << "save state was made with a different rom" << std::endl;
+        return false;
+    }
+    if (state.page_count() != Bus::ram_pages)
+    {
+        std::cerr << "save state has " << state.page_count() << " pages, expected " << Bus::ram_pages << std::endl;
+        return false;
+    }
+
+    // decode everything first so a corrupt block leaves the machine untouched
+    std::vector <std::uint8_t> decoded (Bus::ram_pages * Bus::page_size);
+    std::bitset <Bus::ram_pages> unchanged;
+    for (std::size_t i = 0; i < Bus::ram_pages; ++i)
+    {
+        const auto block = state.page (i);
+        if (page_cached[i] && page_generations[i] == bus.generation (i) && std::ranges::equal (block, page_blocks[i]))
+        {
+            unchanged[i] = true;
+            continue;
+        }
+        if (!lz::decompress (block, std::span(decoded).subspan (i * Bus::page_size, Bus::page_size)))
+        {
+            std::cerr << "save state page " << i << " is corrupt" << std::endl;
+            return false;
+        }
+    }
+
+    for (std::size_t i = 0; i < Bus::ram_pages; ++i)
+    {
+        if (unchanged[i])
+            continue;
+        bus.load_page (i, std::span(decoded).subspan (i * Bus::page_size).first <Bus::page_size> ());
+        const auto block = state.page (i);
+        page_blocks[i].assign (block.begin(), block.end());
+        page_generations[i] = bus.generation (i);
+        page_cached[i] = true;
+    }
+
+    bus.select_bank (state.bank);
+    cpu.set_registers (state.registers);
+    // the journal and any recording describe how the machine got to where it was, not to this state
+    stop_recording ();
+    if (journal)
+        journal->clear ();
+    cycle_count       = state.cycles;
+    instruction_count = state.instructions;
+    irq_pending       = state.irq_pending;
+    nmi_pending       = state.nmi_pending;
+    forget_idle ();
+    return true;
+}
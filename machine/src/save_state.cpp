@@ -0,0 +1,124 @@
+#include "save_state.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    constexpr std::array <char, 8> magic = {'6', '5', '0', '2', 'S', 'T', 'A', '\0'};
+    constexpr std::uint32_t format_version = 1;
+
+    // a header is trusted with nothing bigger than the whole address space in 256 byte pages, each as an
+    // lz block that didn't compress at all: the literals, their extra length bytes and a token
+    constexpr std::uint32_t max_pages = 256;
+    constexpr std::uint32_t max_block = 256 + 256 / 255 + 16;
+
+    struct Header
+    {
+        std::array <char, 8> magic;
+        std::uint32_t version;
+        std::uint32_t page_count;
+        std::uint64_t cycles;
+        std::uint64_t instructions;
+        std::uint64_t rom_hash;
+        std::uint32_t bank;
+        std::uint32_t pages_size;
+        std::uint16_t PC;
+        std::uint8_t AC;
+        std::uint8_t XR;
+        std::uint8_t YR;
+        std::uint8_t SR;
+        std::uint8_t SP;
+        std::uint8_t interrupts; // bit 0 irq, bit 1 nmi
+    };
+}
+
+bool Save_State::write (std::ostream& output) const
+{
+    const Header header {magic, format_version, static_cast <std::uint32_t> (page_count()), cycles, instructions, rom_hash, bank,
+                         static_cast <std::uint32_t> (pages.size()), registers.PC, registers.AC, registers.XR, registers.YR,
+                         registers.SR, registers.SP, static_cast <std::uint8_t> (irq_pending | (nmi_pending << 1))};
+
+    output.write (reinterpret_cast <const char*> (&header), sizeof(header));
+    output.write (reinterpret_cast <const char*> (offsets.data()), offsets.size() * sizeof(std::uint32_t));
+    output.write (reinterpret_cast <const char*> (pages.data()), pages.size());
+    return static_cast <bool> (output);
+}
+
+bool Save_State::read (std::istream& input)
+{
+    Header header;
+    if (!input.read (reinterpret_cast <char*> (&header), sizeof(header)) || header.magic != magic || header.version != format_version)
+        return false;
+    // these size the buffers below, a corrupt header mustn't ask for gigabytes
+    if (header.page_count > max_pages || header.pages_size > header.page_count * max_block)
+        return false;
+
+    std::vector <std::uint32_t> page_offsets (std::size_t {header.page_count} + 1);
+    std::vector <std::uint8_t> page_bytes (header.pages_size);
+    input.read (reinterpret_cast <char*> (page_offsets.data()), page_offsets.size() * sizeof(std::uint32_t));
+    input.read (reinterpret_cast <char*> (page_bytes.data()), page_bytes.size());
+    if (!input || page_offsets.front() != 0 || page_offsets.back() != header.pages_size
+        || !std::ranges::is_sorted (page_offsets))
+        return false;
+
+    registers    = {header.PC, header.AC, header.XR, header.YR, header.SR, header.SP};
+    cycles       = header.cycles;
+    instructions = header.instructions;
+    rom_hash     = header.rom_hash;
+    bank         = header.bank;
+    irq_pending  = header.interrupts & 1;
+    nmi_pending  = header.interrupts & 2;
+    offsets      = std::move (page_offsets);
+    pages        = std::move (page_bytes);
+    return true;
+}
+
+bool Save_State::write (const std::filesystem::path& path) const
+{
+    std::error_code error;
+    std::filesystem::create_directories (path.parent_path(), error);
+
+    // same as the analysis cache, written beside and renamed so a crash never leaves half a state
+    const auto temporary = std::filesystem::path(path).concat(".tmp");
+    {
+        std::ofstream output (temporary, std::ios::binary | std::ios::trunc);
+        if (!output.is_open())
+        {
+            std::cerr << temporary << " could not be written" << std::endl;
+            return false;
+        }
+        if (!write (output))
+        {
+            std::cerr << temporary << " could not be written" << std::endl;
+            return false;
+        }
+    }
+
+    std::filesystem::rename (temporary, path, error);
+    if (error)
+    {
+        std::cerr << path << ": " << error.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Save_State::read (const std::filesystem::path& path)
+{
+    std::ifstream input (path, std::ios::binary);
+    if (!input.is_open())
+    {
+        std::cerr << path << " could not be opened" << std::endl;
+        return false;
+    }
+
+    if (!read (input))
+    {
+        std::cerr << path << " is not a save state or is truncated" << std::endl;
+        return false;
+    }
+    return true;
+}
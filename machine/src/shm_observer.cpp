@@ -0,0 +1,190 @@
+#include "shm_observer.h"
+#include "machine.h"
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    // the pid of a live emulator writing the segment, 0 if it's gone or never got as far as the magic
+    pid_t live_owner (const std::string& name)
+    {
+        const int fd = ::shm_open (name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            return 0;
+        struct stat info {};
+        void* view = MAP_FAILED;
+        if (::fstat (fd, &info) == 0 && static_cast <std::size_t> (info.st_size) >= Shm_Observer::header_size)
+            view = ::mmap (nullptr, Shm_Observer::header_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close (fd);
+        if (view == MAP_FAILED)
+            return 0;
+
+        const auto* header = static_cast <const Shm_Observer::Header*> (view);
+        const bool valid = std::memcmp (header->magic, "6502OBS", 8) == 0;
+        const auto owner = static_cast <pid_t> (header->owner);
+        ::munmap (view, Shm_Observer::header_size);
+        if (!valid || owner <= 0)
+            return 0;
+        // EPERM still means there's a process with that pid
+        return ::kill (owner, 0) == 0 || errno == EPERM ? owner : 0;
+    }
+}
+
+Shm_Observer::Shm_Observer ()
+: name {}
+, size {0}
+, header {nullptr}
+, ram {nullptr}
+, trace {nullptr}
+, trace_mask {0}
+, trace_head {0}
+, interval {default_interval}
+, next {0}
+, page_generations {}
+, page_copied {}
+{
+}
+
+Shm_Observer::~Shm_Observer ()
+{
+    close ();
+}
+
+bool Shm_Observer::open (std::string _name, const std::size_t trace_capacity)
+{
+    close ();
+    if (!_name.starts_with ('/'))
+        _name.insert (0, 1, '/');
+
+    const std::size_t capacity = trace_capacity != 0 ? std::bit_ceil (trace_capacity) : 0;
+    const std::size_t ram_size = Bus::ram_pages * Bus::page_size;
+    const std::size_t trace_offset = header_size + ram_size;
+    const std::size_t total = trace_offset + capacity * sizeof(Trace_Entry);
+    if (total > UINT32_MAX)
+    {
+        std::cerr << _name << ": trace of " << capacity << " entries is too big" << std::endl;
+        return false;
+    }
+
+    int fd = ::shm_open (_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST)
+    {
+        if (const pid_t owner = live_owner (_name); owner != 0)
+        {
+            std::cerr << _name << " is in use by process " << owner << std::endl;
+            return false;
+        }
+        // left behind by a run that died without closing it
+        ::shm_unlink (_name.c_str());
+        fd = ::shm_open (_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0)
+    {
+        std::cerr << _name << " could not be created" << std::endl;
+        return false;
+    }
+    void* view = MAP_FAILED;
+    if (::ftruncate (fd, static_cast <off_t> (total)) == 0)
+        view = ::mmap (nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close (fd);
+    if (view == MAP_FAILED)
+    {
+        std::cerr << _name << " could not be mapped" << std::endl;
+        ::shm_unlink (_name.c_str());
+        return false;
+    }
+
+    name = std::move (_name);
+    size = total;
+    header = static_cast <Header*> (view);
+    ram = static_cast <std::uint8_t*> (view) + header_size;
+    trace = capacity != 0 ? reinterpret_cast <Trace_Entry*> (static_cast <std::uint8_t*> (view) + trace_offset) : nullptr;
+    trace_mask = capacity != 0 ? capacity - 1 : 0;
+    trace_head = 0;
+    next = 0;
+    page_copied.reset ();
+
+    // a fresh segment reads as zero, so the magic going in last tells a reader the layout fields are there
+    header->version          = layout_version;
+    header->ram_offset       = header_size;
+    header->ram_size         = ram_size;
+    header->trace_offset     = trace_offset;
+    header->trace_capacity   = capacity;
+    header->trace_entry_size = sizeof(Trace_Entry);
+    header->owner            = static_cast <std::uint32_t> (::getpid ());
+    std::atomic_thread_fence (std::memory_order_release);
+    std::memcpy (header->magic, "6502OBS", 8);
+    return true;
+}
+
+void Shm_Observer::close ()
+{
+    if (header == nullptr)
+        return;
+    ::munmap (header, size);
+    ::shm_unlink (name.c_str());
+    header = nullptr;
+    ram = nullptr;
+    trace = nullptr;
+    size = 0;
+}
+
+void Shm_Observer::update (const Machine& machine)
+{
+    if (header == nullptr)
+        return;
+
+    if (trace != nullptr)
+    {
+        const MOS_6502::Registers r = machine.cpu.get_registers ();
+        trace[trace_head & trace_mask] = {machine.cycles (), machine.cpu.old_PC, machine.bus.peek (machine.cpu.old_PC), r.AC, r.XR, r.YR, r.SR, r.SP};
+        std::atomic_ref <std::uint64_t> (header->trace_head).store(++trace_head, std::memory_order_release);
+    }
+
+    if (machine.instructions () >= next)
+        publish (machine);
+}
+
+void Shm_Observer::publish (const Machine& machine)
+{
+    if (header == nullptr)
+        return;
+
+    std::atomic_ref <std::uint32_t> sequence (header->sequence);
+    const std::uint32_t start = sequence.load(std::memory_order_relaxed);
+    sequence.store(start + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_release);
+
+    for (std::size_t i = 0; i < Bus::ram_pages; ++i)
+    {
+        const std::uint32_t generation = machine.bus.generation (i);
+        if (page_copied[i] && page_generations[i] == generation)
+            continue;
+        std::memcpy (ram + i * Bus::page_size, machine.bus.page_data (i).data(), Bus::page_size);
+        page_generations[i] = generation;
+        page_copied[i] = true;
+    }
+
+    const MOS_6502::Registers r = machine.cpu.get_registers ();
+    header->bank         = static_cast <std::uint32_t> (machine.bus.bank ());
+    header->cycles       = machine.cycles ();
+    header->instructions = machine.instructions ();
+    header->rom_hash     = machine.rom_hash ();
+    header->pc           = r.PC;
+    header->a            = r.AC;
+    header->x            = r.XR;
+    header->y            = r.YR;
+    header->sr           = r.SR;
+    header->sp           = r.SP;
+
+    sequence.store(start + 2, std::memory_order_release);
+    next = machine.instructions () + interval;
+}
@@ -1,40 +1,64 @@
 
+#include "breakpoints.h"
 #include "bus.h"
+#include "checkpoints.h"
+#include "debug_client.h"
+#include "debug_mirror.h"
 #include "mos6502.h"
 #include "debugger.h"
+#include "disassembler.h"
+#include "hash_trace.h"
+#include "machine.h"
+#include "shm_observer.h"
+#include "watchpoints.h"
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <cstdint>
 #include <iostream>
 #include <mutex>
+#include <string_view>
 #include <thread>
-#include "mem.h"
-#include <chrono>
-#include <thread>
+#include <vector>
 
-void cpu_thread_handler (MOS_6502::CPU& cpu, GUI& gui, MOS_6502::trace_type& traces, const MOS_6502::code_map_type& map);
+void cpu_thread_handler (Machine& machine, Checkpoints& checkpoints, Hash_Trace& hashes, GUI& gui, MOS_6502::trace_type& traces, const MOS_6502::Disassembler& disassembler, Breakpoints& breakpoints, Watchpoints& watchpoints, Shm_Observer& observer);
+void remote_thread_handler (Machine& machine, GUI& gui, MOS_6502::trace_type& traces, const MOS_6502::Disassembler& disassembler, Breakpoints& breakpoints, Debug_Client& client);
 
-int main()
+int main(int argc, char* argv[])
 {
+    Machine machine;
+    Checkpoints checkpoints;
+    Hash_Trace hashes;
 
-    /* change this eventually to have a static size of 16kb always */
-    Memory rom {UINT16_MAX/2};
-    Memory ram {UINT16_MAX};
-
+    // the old once a second interrupt, 559ns a cycle
+    machine.set_irq_period(1'000'000'000 / 559);
+    machine.set_idle_skip(true);
 
     MOS_6502::trace_type traces;
-    MOS_6502::code_map_type code_map;
-
-    Bus bus (rom, ram);
-
-    MOS_6502::CPU cpu (
-        [&bus] (const auto address) {return bus.read(address);},
-        [&bus] (const auto address, const auto data) {bus.write(address, data);}
-    );
+    MOS_6502::Disassembler disassembler;
+    Breakpoints breakpoints;
+
+    Watchpoints watchpoints (machine.bus, breakpoints);
+
+    // --shm NAME puts ram, registers and a trace where other processes can watch them, see shm_observer.h
+    Shm_Observer observer;
+    // --attach ADDRESS debugs a machine behind a debug server (farm --serve) instead of running one here
+    Debug_Client client;
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::string_view(argv[i]) == "--shm" && observer.open(argv[i + 1], 1 << 16))
+            observer.publish(machine);
+        if (std::string_view(argv[i]) == "--attach" && !client.connect(argv[i + 1]))
+            return 1;
+    }
 
-    GUI gui (cpu, rom, ram, traces, code_map);
+    GUI gui (machine, checkpoints, hashes, traces, disassembler, breakpoints, watchpoints);
 
-    std::thread cpu_thread (cpu_thread_handler, std::ref(cpu), std::ref(gui), std::ref(traces), std::cref(code_map));
+    std::thread cpu_thread;
+    if (client.connected())
+        cpu_thread = std::thread (remote_thread_handler, std::ref(machine), std::ref(gui), std::ref(traces), std::cref(disassembler), std::ref(breakpoints), std::ref(client));
+    else
+        cpu_thread = std::thread (cpu_thread_handler, std::ref(machine), std::ref(checkpoints), std::ref(hashes), std::ref(gui), std::ref(traces), std::cref(disassembler), std::ref(breakpoints), std::ref(watchpoints), std::ref(observer));
 
     gui.run();
     cpu_thread.join();
@@ -42,22 +66,40 @@ int main()
     return 0;
 }
 
-void cpu_thread_handler (MOS_6502::CPU& cpu, GUI& gui, MOS_6502::trace_type& traces, const MOS_6502::code_map_type& map)
+void cpu_thread_handler (Machine& machine, Checkpoints& checkpoints, Hash_Trace& hashes, GUI& gui, MOS_6502::trace_type& traces, const MOS_6502::Disassembler& disassembler, Breakpoints& breakpoints, Watchpoints& watchpoints, Shm_Observer& observer)
 {
-    auto timer = std::chrono::high_resolution_clock::now ();
+    MOS_6502::CPU& cpu = machine.cpu;
+    Bus& bus = machine.bus;
+    std::vector <GUI::command_type> commands;
+    const Condition::peek_cb peek = [&bus] (const auto address) {return bus.peek(address);};
+    auto listing = disassembler.listing();
+    auto listing_version = disassembler.version();
     int cycles = 0;
     while (gui.is_running())
     {   
+        bool run = false;
         {
             std::unique_lock <std::mutex> lock (gui.mu);
-            gui.cv.wait(lock, [&gui](){return !gui.is_paused || gui.step;});
+            gui.cv.wait(lock, [&gui](){return !gui.is_paused || gui.step || !gui.commands.empty();});
+            commands.swap(gui.commands);
+            run = !gui.is_paused || gui.step;
         }
 
-
+        // anything that touches the whole machine (save states and so on) runs here between instructions
+        for (auto& command : commands)
+            command();
+        if (!commands.empty())
+            observer.publish(machine);
+        commands.clear();
+        if (!run)
+            continue;
 
         auto begin = std::chrono::high_resolution_clock::now();
 
-        cycles = cpu.update();
+        cycles = machine.step();
+        checkpoints.update(machine);
+        hashes.update(machine);
+        observer.update(machine);
 
         // idk if this is how you actually emulate cpu time
         auto end = std::chrono::high_resolution_clock::now();
@@ -68,16 +110,14 @@ void cpu_thread_handler (MOS_6502::CPU& cpu, GUI& gui, MOS_6502::trace_type& tra
             std::this_thread::sleep_for(target - (end - begin));
         }
 
-        /* INTERRUPT */
-        auto end_timer = std::chrono::high_resolution_clock::now();
-        if (end_timer - timer > std::chrono::seconds(1))
+        // pick up whatever the disassembler has published since the last instruction
+        if (disassembler.version() != listing_version)
         {
-            cycles = cpu.IRQ();
-            timer = std::chrono::high_resolution_clock::now();
+            listing_version = disassembler.version();
+            listing = disassembler.listing();
         }
-        
-        if(!MOS_6502::trace(traces, map, cpu))
-            std::cerr << map.size() << " " << "did not trace" << std::endl;
+
+        MOS_6502::trace(traces, listing->map, cpu, peek);
 
         {
             std::lock_guard <std::mutex> lock(gui.mu);
@@ -86,13 +126,118 @@ void cpu_thread_handler (MOS_6502::CPU& cpu, GUI& gui, MOS_6502::trace_type& tra
         gui.cv.notify_all();
 
 
-        if (map.contains(cpu.get_PC() & 0x7FFF) &&  std::get<2>(map.at(cpu.get_PC() & 0x7FFF)))
+        // the condition is only evaluated when the bit for this address is set
+        if (breakpoints.test(Breakpoints::Kind::execute, cpu.get_PC()) && breakpoints.should_break(cpu.get_PC(), cpu, peek))
         {
            std::lock_guard lock (gui.mu);
            gui.is_paused = true;
         }
+
+        // a watched address was accessed by the instruction that just ran
+        if (watchpoints.triggered())
+        {
+            watchpoints.acknowledge(cpu.old_PC);
+            std::lock_guard lock (gui.mu);
+            gui.is_paused = true;
+        }
         gui.cv.notify_all();
+
+        // the program is only waiting for an interrupt, sleep until it's due or the gui wants something
+        // and then count the cycles that went by instead of running them
+        if (machine.idle())
+        {
+            static constexpr std::uint64_t idle_slice = 100'000; // cycles, about 56ms
+            const auto idle_begin = std::chrono::high_resolution_clock::now();
+            const auto due = std::chrono::nanoseconds(std::min(machine.next_event() - machine.cycles(), idle_slice) * 559);
+            {
+                std::unique_lock <std::mutex> lock (gui.mu);
+                gui.cv.wait_for(lock, due, [&gui](){return gui.is_paused || !gui.commands.empty();});
+            }
+            const auto slept = std::chrono::high_resolution_clock::now() - idle_begin;
+            // stopping short of the next checkpoint and hash sample, so both are still taken where they're due
+            machine.skip_idle(std::min(machine.cycles() + slept / std::chrono::nanoseconds(559), checkpoints.next_cycle_due()), hashes.next_sample());
+            observer.publish(machine);
+        }
     }
 }
 
 
+
+// the gui's machine is a mirror of the remote one, select the same rom and press reset to get the listing.
+// breakpoint conditions are checked here after the server stops at the address, watchpoints and the
+// rewind tools only see the mirror
+void remote_thread_handler (Machine& machine, GUI& gui, MOS_6502::trace_type& traces, const MOS_6502::Disassembler& disassembler, Breakpoints& breakpoints, Debug_Client& client)
+{
+    static constexpr std::uint64_t run_slice = 30'000; // cycles a round trip while running, about 17ms
+
+    MOS_6502::CPU& cpu = machine.cpu;
+    Bus& bus = machine.bus;
+    Debug_Mirror mirror (machine, breakpoints, client);
+    std::vector <GUI::command_type> commands;
+    std::vector <Debug_Protocol::Trace_Entry> ran;
+    Debug_Protocol::Stop stop;
+    const Condition::peek_cb peek = [&bus] (const auto address) {return bus.peek(address);};
+    auto listing = disassembler.listing();
+    auto listing_version = disassembler.version();
+
+    mirror.sync(Debug_Mirror::Motion::none, 0, stop, ran);
+    while (gui.is_running())
+    {
+        bool run = false;
+        bool stepping = false;
+        {
+            std::unique_lock <std::mutex> lock (gui.mu);
+            gui.cv.wait(lock, [&gui](){return !gui.is_paused || gui.step || !gui.commands.empty();});
+            commands.swap(gui.commands);
+            stepping = gui.is_paused && gui.step;
+            run = !gui.is_paused || gui.step;
+        }
+
+        // edits to the mirror, sent along with the next sync
+        for (auto& command : commands)
+            command();
+        commands.clear();
+
+        auto begin = std::chrono::high_resolution_clock::now();
+        const std::uint64_t before = mirror.cycles();
+        const auto motion = !run ? Debug_Mirror::Motion::none : stepping ? Debug_Mirror::Motion::step : Debug_Mirror::Motion::run;
+        const bool synced = client.connected() && mirror.sync(motion, stepping ? 1 : run_slice, stop, ran);
+
+        if (disassembler.version() != listing_version)
+        {
+            listing_version = disassembler.version();
+            listing = disassembler.listing();
+        }
+
+        // the trace lines are made the same way as for a local run, from the registers after each instruction
+        if (!ran.empty())
+        {
+            const MOS_6502::Registers now = cpu.get_registers();
+            for (const auto& entry : ran)
+            {
+                cpu.set_registers(entry.after);
+                cpu.old_PC = entry.pc;
+                MOS_6502::trace(traces, listing->map, cpu, peek);
+            }
+            cpu.set_registers(now);
+        }
+
+        const bool hit = stop == Debug_Protocol::Stop::breakpoint && breakpoints.should_break(cpu.get_PC(), cpu, peek);
+        if (!run)
+            continue;
+
+        // waiting on an interrupt that won't come, or the time the slice took on the remote clock
+        auto end = std::chrono::high_resolution_clock::now();
+        auto target = std::chrono::nanoseconds((stop == Debug_Protocol::Stop::idle ? run_slice : mirror.cycles() - before) * 559);
+        if (target > (end - begin))
+            std::this_thread::sleep_for(target - (end - begin));
+
+        {
+            std::lock_guard <std::mutex> lock(gui.mu);
+            gui.step = false;
+            if (hit || !synced)
+                gui.is_paused = true;
+        }
+        gui.cv.notify_all();
+    }
+}
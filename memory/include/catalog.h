@@ -0,0 +1,75 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include "rom_format.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    keeps a list of the roms in a directory up to date on a background thread
+    every file is hashed and its format detected once, the results go into an index file keyed by
+    path, size and modification time so later runs only read files that changed, with no index path
+    every run hashes everything
+    the directory is rescanned every rescan_interval and a new list is published when anything changed
+*/
+class Rom_Catalog
+{
+public:
+    struct Entry
+    {
+        std::string name;
+        std::string path;
+        std::uintmax_t size;
+        std::int64_t modified; // file clock ticks since its epoch, only ever compared
+        std::uint64_t hash;
+        Rom_Format format;
+        std::string duplicate_of; // name of the first rom with the same contents, empty if unique
+
+        bool operator == (const Entry&) const = default;
+    };
+
+    static constexpr auto rescan_interval = std::chrono::seconds(2);
+
+    Rom_Catalog (std::filesystem::path _directory, std::filesystem::path _index_path);
+    ~Rom_Catalog ();
+
+    /* sorted by name, never null */
+    std::shared_ptr <const std::vector <Entry>> entries () const;
+
+    /* bumped every time a new list is published */
+    std::uint32_t version () const {return published_version.load(std::memory_order_acquire);}
+
+    /* true until the first full scan is done */
+    bool scanning () const {return !scanned.load(std::memory_order_acquire);}
+
+private:
+    std::filesystem::path directory;
+    std::filesystem::path index_path;
+
+    std::thread worker;
+    std::mutex wait_mu;
+    std::condition_variable wake;
+    bool stopping;
+    std::atomic <bool> scanned;
+
+    mutable std::mutex mu;
+    std::shared_ptr <const std::vector <Entry>> published;
+    std::atomic <std::uint32_t> published_version;
+
+    void run ();
+    std::vector <Entry> scan (const std::vector <Entry>& known) const;
+    void publish (std::vector <Entry> list);
+
+    std::vector <Entry> read_index () const;
+    void write_index (const std::vector <Entry>& list) const;
+};
+
+#endif
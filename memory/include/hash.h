@@ -0,0 +1,50 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+/*
+    fast 64 bit non-cryptographic hash for rom contents and machine state
+    16 bytes per step folded with a 64x64 -> 128 bit multiply, good enough to key caches and spot
+    duplicates, not for anything an attacker controls
+*/
+namespace content_hash
+{
+    inline constexpr std::uint64_t p0 = 0xa0761d6478bd642full;
+    inline constexpr std::uint64_t p1 = 0xe7037ed1a0b428dbull;
+    inline constexpr std::uint64_t p2 = 0x8ebc6af09c88c6e3ull;
+
+    inline std::uint64_t mix (const std::uint64_t a, const std::uint64_t b)
+    {
+        const unsigned __int128 product = static_cast <unsigned __int128> (a) * b;
+        return static_cast <std::uint64_t> (product) ^ static_cast <std::uint64_t> (product >> 64);
+    }
+
+    inline std::uint64_t load (const std::uint8_t* p, const std::size_t size)
+    {
+        std::uint64_t value = 0;
+        std::memcpy (&value, p, size);
+        return value;
+    }
+
+    inline std::uint64_t hash (std::span <const std::uint8_t> data, const std::uint64_t seed = 0)
+    {
+        const std::uint8_t* p = data.data();
+        std::size_t left = data.size();
+        std::uint64_t h = seed ^ mix (seed ^ p0, data.size() ^ p1);
+
+        for (; left >= 16; left -= 16, p += 16)
+            h = mix (load (p, 8) ^ p1 ^ h, load (p + 8, 8) ^ p2);
+
+        if (left > 0)
+        {
+            const std::size_t low = left < 8 ? left : 8;
+            h = mix (load (p, low) ^ p1 ^ h, load (p + low, left - low) ^ p2);
+        }
+        return mix (h ^ p0, data.size() ^ p2);
+    }
+}
+
+#endif
@@ -2,37 +2,67 @@
 #define MEM_H
 
 #include <cstdint>
+#include <span>
 #include <string>
 #include <vector>
 
+/*
+    a block of memory, either owned or a rom file read into a private anonymous mapping
+    edits never reach the file, and the file changing on disk never reaches the machine
+*/
 class Memory
 {
 public:
     using mem_type = std::vector <std::uint8_t>;
 
+    static constexpr std::size_t max_size = 0x400000; // 256 banks of 16kb
+
     Memory (const std::uint16_t size);
     ~Memory();
 
-    bool load (const std::string& path, const std::size_t size);
+    Memory (const Memory&) = delete;
+    Memory& operator = (const Memory&) = delete;
+
+    /*
+        raw binaries are mapped as they are, intel hex and s-record files are parsed and
+        each record is placed at its address minus origin, records below origin are dropped
+    */
+    bool load (const std::string& path, const std::uint32_t origin = 0);
+
+    /* an owned copy of data padded with zeros to whole pages, for images that never were a file */
+    bool assign (std::span <const std::uint8_t> data);
 
     std::uint8_t read (const std::uint16_t address) const;
     void write (const std::uint16_t address, const std::uint8_t data);
+
+    /* drops any mapping and goes back to owned zeroed memory */
     void reset ();
 
     std::uint8_t* data ();
 
-    mem_type::iterator begin();
-    mem_type::iterator end  ();
+    std::uint8_t* begin();
+    std::uint8_t* end  ();
 
+    /* always whole 256 byte pages so the bus never maps a partial page */
     std::size_t size ();
 
     bool is_loaded () const;
+    bool is_mapped () const {return mapping != nullptr;}
 
 private:
     mem_type mem;
+    std::size_t initial_size;
+    std::uint8_t* base;
+    std::size_t length;
+    void* mapping;
+    std::size_t mapping_size;
     bool loaded;
+
+    bool map_file (const std::string& path);
+    bool parse_file (const std::string& path, const std::uint32_t origin);
+    void unmap ();
 };
 
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,54 @@
+#ifndef PAGE_POOL_H
+#define PAGE_POOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/*
+    256 byte pages carved out of big blocks, for buses that only copy a page once it's written
+    pages are reference counted so forked machines can hold the same one. the counts sit in a header at
+    the start of each block and blocks are aligned to their size, so a page finds its count with a mask
+
+    one pool can serve any number of machines on any number of threads. a page goes on a free list once its
+    last holder releases it, blocks are only handed back to the os when the pool goes away
+*/
+class Page_Pool
+{
+public:
+    static constexpr std::size_t page_size  = 0x100;
+    static constexpr std::size_t block_size = 0x10000;
+
+    Page_Pool ();
+    ~Page_Pool ();
+
+    Page_Pool (const Page_Pool&) = delete;
+    Page_Pool& operator = (const Page_Pool&) = delete;
+
+    /* one reference, contents are left over from whoever had the page last */
+    std::uint8_t* allocate ();
+
+    /* another reference to a page that's already held */
+    void share (std::uint8_t* page);
+    void release (std::uint8_t* page);
+
+    /* the caller holds the only reference, nobody else can be reading it so it may be written in place */
+    bool unique (const std::uint8_t* page) const;
+
+    std::size_t pages_in_use () const;
+    std::size_t reserved_bytes () const;
+
+private:
+    using counter = std::atomic <std::uint32_t>;
+
+    static counter& references (const std::uint8_t* page);
+
+    mutable std::mutex mu;
+    std::vector <std::uint8_t*> blocks;
+    std::vector <std::uint8_t*> free_pages;
+    std::size_t next; // next page of the newest block to hand out
+    std::size_t in_use;
+};
+
+#endif
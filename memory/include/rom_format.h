@@ -0,0 +1,33 @@
+#ifndef ROM_FORMAT_H
+#define ROM_FORMAT_H
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <span>
+#include <string>
+#include <string_view>
+
+enum class Rom_Format : std::uint8_t
+{
+    binary,
+    intel_hex,
+    srecord,
+};
+
+/* looks at the start of a file, anything that isn't a text record format is a raw binary */
+Rom_Format detect_format (std::string_view head);
+
+const char* format_name (const Rom_Format format);
+
+/* called once per data record in file order, address is the full load address of the first byte */
+using record_cb = std::function <void(const std::uint32_t address, std::span <const std::uint8_t> data)>;
+
+/*
+    streaming parsers, one line is decoded at a time so the whole file is never held in memory
+    checksums are verified, error gets the line number and reason on failure
+*/
+bool parse_intel_hex (std::istream& input, const record_cb& record, std::string& error);
+bool parse_srecord   (std::istream& input, const record_cb& record, std::string& error);
+
+#endif
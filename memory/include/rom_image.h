@@ -0,0 +1,36 @@
+#ifndef ROM_IMAGE_H
+#define ROM_IMAGE_H
+
+#include "mem.h"
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+
+/*
+    a rom loaded and hashed once and then only read, so every machine running it can map the same bytes
+    raw binaries are read into an anonymous mapping rather than the heap, see Memory
+*/
+class Rom_Image
+{
+public:
+    /* nullptr if the file can't be loaded, origin works as it does for Memory::load */
+    static std::shared_ptr <const Rom_Image> load (const std::string& path, const std::uint32_t origin = 0);
+
+    /* an image of bytes that are already in memory, copied */
+    static std::shared_ptr <const Rom_Image> copy (std::span <const std::uint8_t> bytes);
+
+    std::span <const std::uint8_t> bytes () const {return contents;}
+    std::uint64_t hash () const {return digest;}
+
+private:
+    Rom_Image ();
+
+    static std::shared_ptr <const Rom_Image> finish (std::shared_ptr <Rom_Image> image, const bool loaded);
+
+    Memory memory;
+    std::span <const std::uint8_t> contents;
+    std::uint64_t digest;
+};
+
+#endif
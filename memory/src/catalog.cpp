@@ -0,0 +1,191 @@
+#include "catalog.h"
+#include "hash.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+namespace
+{
+    // sorted by name with duplicates pointing at the first copy
+    void finish (std::vector <Rom_Catalog::Entry>& list)
+    {
+        std::ranges::sort (list, [] (const auto& a, const auto& b) {return a.name != b.name ? a.name < b.name : a.path < b.path;});
+
+        std::unordered_map <std::uint64_t, const std::string*> first;
+        for (auto& entry : list)
+        {
+            const auto [it, inserted] = first.try_emplace (entry.hash, &entry.name);
+            entry.duplicate_of = inserted ? std::string {} : *it->second;
+        }
+    }
+}
+
+Rom_Catalog::Rom_Catalog (std::filesystem::path _directory, std::filesystem::path _index_path)
+: directory {std::move (_directory)}
+, index_path {std::move (_index_path)}
+, worker {}
+, stopping {false}
+, scanned {false}
+, published {std::make_shared <std::vector <Entry>> ()}
+, published_version {0}
+{
+    worker = std::thread (&Rom_Catalog::run, this);
+}
+
+Rom_Catalog::~Rom_Catalog ()
+{
+    {
+        std::lock_guard lock (wait_mu);
+        stopping = true;
+    }
+    wake.notify_all ();
+    if (worker.joinable())
+        worker.join ();
+}
+
+std::shared_ptr <const std::vector <Rom_Catalog::Entry>> Rom_Catalog::entries () const
+{
+    std::lock_guard lock (mu);
+    return published;
+}
+
+void Rom_Catalog::run ()
+{
+    // whatever the last run saw is good enough to show until the first scan finishes
+    auto list = read_index ();
+    if (!list.empty())
+    {
+        finish (list);
+        publish (list);
+    }
+
+    for (;;)
+    {
+        auto fresh = scan (*entries());
+        if (fresh != *entries())
+        {
+            write_index (fresh);
+            publish (std::move (fresh));
+        }
+        scanned.store(true, std::memory_order_release);
+
+        std::unique_lock lock (wait_mu);
+        if (wake.wait_for (lock, rescan_interval, [this] {return stopping;}))
+            return;
+    }
+}
+
+std::vector <Rom_Catalog::Entry> Rom_Catalog::scan (const std::vector <Entry>& known) const
+{
+    std::unordered_map <std::string, const Entry*> by_path;
+    for (const auto& entry : known)
+        by_path.emplace (entry.path, &entry);
+
+    std::vector <Entry> list;
+    std::error_code error;
+    for (auto it = std::filesystem::recursive_directory_iterator (directory, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment (error))
+    {
+        const auto& file = *it;
+        const std::string name = file.path().filename().string();
+        std::error_code file_error;
+        if (!file.is_regular_file(file_error) || name.starts_with('.') || file.path() == index_path)
+            continue;
+
+        Entry entry {};
+        entry.name = name;
+        entry.path = file.path().string();
+        entry.size = file.file_size(file_error);
+        entry.modified = file.last_write_time(file_error).time_since_epoch().count();
+        if (file_error)
+            continue;
+
+        // unchanged files keep what the last scan or the index worked out
+        if (const auto cached = by_path.find (entry.path); cached != by_path.end() && cached->second->size == entry.size && cached->second->modified == entry.modified)
+        {
+            entry.hash = cached->second->hash;
+            entry.format = cached->second->format;
+        }
+        else
+        {
+            std::ifstream input (entry.path, std::ios::binary);
+            std::vector <std::uint8_t> contents (entry.size);
+            input.read (reinterpret_cast <char*> (contents.data()), contents.size());
+            contents.resize (input.gcount());
+
+            entry.hash = content_hash::hash (contents);
+            const std::size_t head = std::min <std::size_t> (contents.size(), 64);
+            entry.format = detect_format ({reinterpret_cast <const char*> (contents.data()), head});
+        }
+        list.push_back (std::move (entry));
+    }
+
+    if (error)
+        std::cerr << directory << ": " << error.message() << std::endl;
+
+    finish (list);
+    return list;
+}
+
+void Rom_Catalog::publish (std::vector <Entry> list)
+{
+    auto next = std::make_shared <const std::vector <Entry>> (std::move (list));
+    {
+        std::lock_guard lock (mu);
+        published = std::move (next);
+    }
+    published_version.fetch_add(1, std::memory_order_release);
+}
+
+std::vector <Rom_Catalog::Entry> Rom_Catalog::read_index () const
+{
+    // hash format size modified path, tab separated, one rom per line
+    std::vector <Entry> list;
+    std::ifstream input (index_path);
+    std::string line;
+    while (std::getline (input, line))
+    {
+        std::istringstream fields (line);
+        Entry entry {};
+        int format = 0;
+        fields >> std::hex >> entry.hash >> std::dec >> format >> entry.size >> entry.modified;
+        fields.ignore (1);
+        std::getline (fields, entry.path);
+        if (fields.fail() || entry.path.empty() || format < 0 || format > static_cast <int> (Rom_Format::srecord))
+            continue;
+
+        entry.format = static_cast <Rom_Format> (format);
+        entry.name = std::filesystem::path(entry.path).filename().string();
+        list.push_back (std::move (entry));
+    }
+    return list;
+}
+
+void Rom_Catalog::write_index (const std::vector <Entry>& list) const
+{
+    if (index_path.empty())
+        return;
+    std::error_code error;
+    std::filesystem::create_directories (index_path.parent_path(), error);
+
+    // written next to the index and renamed over it so a crash never leaves half a file
+    const auto temporary = std::filesystem::path(index_path).concat(".tmp");
+    {
+        std::ofstream output (temporary, std::ios::trunc);
+        if (!output.is_open())
+        {
+            std::cerr << index_path << " could not be written" << std::endl;
+            return;
+        }
+        for (const auto& entry : list)
+        {
+            output << std::hex << entry.hash << std::dec << '\t' << static_cast <int> (entry.format) << '\t'
+                   << entry.size << '\t' << entry.modified << '\t' << entry.path << '\n';
+        }
+    }
+
+    std::filesystem::rename (temporary, index_path, error);
+    if (error)
+        std::cerr << index_path << ": " << error.message() << std::endl;
+}
@@ -1,77 +1,245 @@
 #include "mem.h"
+#include "rom_format.h"
+#include <algorithm>
+#include <cerrno>
 #include <fstream>
 #include <iostream>
 #include <print>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    std::size_t whole_pages (const std::size_t size)
+    {
+        return (size + 0xFF) & ~std::size_t {0xFF};
+    }
+}
 
 Memory::Memory (const std::uint16_t size)
 : mem (size, 0)
+, initial_size {size}
+, base {mem.data()}
+, length {mem.size()}
+, mapping {nullptr}
+, mapping_size {0}
 , loaded {false}
 {
 }
 
 Memory::~Memory()
 {
+    unmap ();
 }
 
-bool Memory::load (const std::string& path, const std::size_t size)
+bool Memory::load (const std::string& path, const std::uint32_t origin)
 {
     loaded = false;
-    std::fstream file (path);
+    std::ifstream file (path, std::ios::binary);
     if (!file.is_open())
     {
         std::cerr << path << " could not be opened" << std::endl;
-        loaded = false;
         return false;
     }
 
-    if (size > UINT16_MAX+1)
+    std::string head (64, '\0');
+    file.read (head.data(), head.size());
+    head.resize (file.gcount());
+    file.close();
+
+    if (detect_format (head) == Rom_Format::binary)
+        loaded = map_file (path);
+    else
+        loaded = parse_file (path, origin);
+
+    return loaded;
+}
+
+bool Memory::map_file (const std::string& path)
+{
+    const int fd = ::open (path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << path << " could not be opened" << std::endl;
+        return false;
+    }
+
+    struct stat info {};
+    if (::fstat (fd, &info) != 0 || info.st_size == 0)
+    {
+        std::cerr << path << " is empty" << std::endl;
+        ::close (fd);
+        return false;
+    }
+
+    const auto file_size = static_cast <std::size_t> (info.st_size);
+    if (file_size > max_size)
     {
         std::cerr << path << " is larger that max rom size" << std::endl;
-        loaded = false;
+        ::close (fd);
         return false;
     }
-    mem.resize (size);
-    file.read (reinterpret_cast<char*> (mem.data()), mem.size());
 
-    file.close();
-    loaded = true;
+    // a snapshot in anonymous memory rather than a mapping of the file: roms get rebuilt in place while
+    // the catalog watches them, and a mapped file that shrinks kills the cpu thread with SIGBUS on the
+    // next read. zero filled, so rounding up to whole 256 byte pages reads as zero past the end
+    const std::size_t size = whole_pages (file_size);
+    void* const view = ::mmap (nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (view == MAP_FAILED)
+    {
+        std::cerr << path << " could not be mapped" << std::endl;
+        ::close (fd);
+        return false;
+    }
+
+    std::size_t done = 0;
+    while (done < file_size)
+    {
+        const ssize_t got = ::pread (fd, static_cast <std::uint8_t*> (view) + done, file_size - done, done);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+        done += got;
+    }
+    ::close (fd);
+    if (done != file_size)
+    {
+        std::cerr << path << " changed while it was read" << std::endl;
+        ::munmap (view, size);
+        return false;
+    }
 
+    unmap ();
+    mapping = view;
+    mapping_size = size;
+    base = static_cast <std::uint8_t*> (view);
+    length = size;
     return true;
 }
 
+bool Memory::parse_file (const std::string& path, const std::uint32_t origin)
+{
+    std::ifstream file (path);
+    std::string head;
+    std::getline (file, head);
+    const Rom_Format format = detect_format (head);
+    file.seekg (0);
+
+    unmap ();
+    mem.clear ();
+
+    std::size_t dropped = 0;
+    bool too_large = false;
+    const auto place = [&] (const std::uint32_t address, std::span <const std::uint8_t> data)
+    {
+        if (address < origin)
+        {
+            dropped += data.size();
+            return;
+        }
+        const std::size_t index = address - origin;
+        if (index + data.size() > max_size)
+        {
+            too_large = true;
+            return;
+        }
+        if (index + data.size() > mem.size())
+            mem.resize (whole_pages (index + data.size()), 0);
+        std::ranges::copy (data, mem.begin() + index);
+    };
+
+    std::string error;
+    const bool parsed = format == Rom_Format::intel_hex ? parse_intel_hex (file, place, error) : parse_srecord (file, place, error);
+
+    base = mem.data();
+    length = mem.size();
+
+    if (!parsed)
+    {
+        std::cerr << path << ": " << error << std::endl;
+        return false;
+    }
+    if (too_large)
+    {
+        std::cerr << path << " is larger that max rom size" << std::endl;
+        return false;
+    }
+    if (dropped != 0)
+        std::cerr << path << ": " << dropped << " bytes below the load address were skipped" << std::endl;
+    return !mem.empty();
+}
+
+bool Memory::assign (std::span <const std::uint8_t> data)
+{
+    loaded = false;
+    if (data.size() > max_size)
+    {
+        std::cerr << "image is larger that max rom size" << std::endl;
+        return false;
+    }
+
+    unmap ();
+    mem.assign (data.begin(), data.end());
+    mem.resize (whole_pages (data.size()), 0);
+    base = mem.data();
+    length = mem.size();
+    loaded = !mem.empty();
+    return loaded;
+}
+
+void Memory::unmap ()
+{
+    if (mapping == nullptr)
+        return;
+    ::munmap (mapping, mapping_size);
+    mapping = nullptr;
+    mapping_size = 0;
+}
+
 std::uint8_t Memory::read (const std::uint16_t address) const
 {
-    return mem[address];
+    return base[address];
 }
 
 void Memory::write (const std::uint16_t address, const std::uint8_t data)
 {
-    mem[address] = data;
+    base[address] = data;
 }
 
 void Memory::reset ()
 {
+    if (mapping != nullptr || mem.size() != initial_size)
+    {
+        unmap ();
+        mem.assign (initial_size, 0);
+        base = mem.data();
+        length = mem.size();
+        return;
+    }
     std::ranges::fill (mem, 0);
 }
 
 std::uint8_t* Memory::data ()
 {
-    return mem.data();
+    return base;
 }
 
-Memory::mem_type::iterator Memory::begin ()
+std::uint8_t* Memory::begin ()
 {
-    return mem.begin();
+    return base;
 }
 
-Memory::mem_type::iterator Memory::end ()
+std::uint8_t* Memory::end ()
 {
-    return mem.end();
+    return base + length;
 }
 
 std::size_t Memory::size ()
 {
-    return mem.size();
+    return length;
 }
 
 bool Memory::is_loaded () const
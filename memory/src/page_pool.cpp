@@ -0,0 +1,93 @@
+#include "page_pool.h"
+#include <memory>
+#include <new>
+
+namespace
+{
+    constexpr std::size_t pages_per_block = Page_Pool::block_size / Page_Pool::page_size;
+
+    // a count for every page in the block, the header's own pages never get handed out
+    constexpr std::size_t header_pages = pages_per_block * sizeof(std::atomic <std::uint32_t>) / Page_Pool::page_size;
+}
+
+Page_Pool::Page_Pool ()
+: mu {}
+, blocks {}
+, free_pages {}
+, next {pages_per_block}
+, in_use {0}
+{
+}
+
+Page_Pool::~Page_Pool ()
+{
+    for (std::uint8_t* block : blocks)
+        ::operator delete (block, std::align_val_t {block_size});
+}
+
+Page_Pool::counter& Page_Pool::references (const std::uint8_t* page)
+{
+    const auto address = reinterpret_cast <std::uintptr_t> (page);
+    counter* const header = reinterpret_cast <counter*> (address & ~(block_size - 1));
+    return header[(address & (block_size - 1)) / page_size];
+}
+
+std::uint8_t* Page_Pool::allocate ()
+{
+    std::uint8_t* page = nullptr;
+    {
+        std::lock_guard lock (mu);
+        ++in_use;
+        if (!free_pages.empty())
+        {
+            page = free_pages.back();
+            free_pages.pop_back ();
+        }
+        else
+        {
+            if (next == pages_per_block)
+            {
+                // not zeroed, so the os only backs the parts of a block that actually get used
+                auto* const block = static_cast <std::uint8_t*> (::operator new (block_size, std::align_val_t {block_size}));
+                std::uninitialized_value_construct_n (reinterpret_cast <counter*> (block), pages_per_block);
+                blocks.push_back (block);
+                next = header_pages;
+            }
+            page = blocks.back() + page_size * next++;
+        }
+    }
+    references (page).store(1, std::memory_order_relaxed);
+    return page;
+}
+
+void Page_Pool::share (std::uint8_t* page)
+{
+    references (page).fetch_add(1, std::memory_order_relaxed);
+}
+
+void Page_Pool::release (std::uint8_t* page)
+{
+    // the last holder's reads of the page are done before anyone gets it from the free list
+    if (references (page).fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    std::lock_guard lock (mu);
+    --in_use;
+    free_pages.push_back (page);
+}
+
+bool Page_Pool::unique (const std::uint8_t* page) const
+{
+    return references (page).load(std::memory_order_acquire) == 1;
+}
+
+std::size_t Page_Pool::pages_in_use () const
+{
+    std::lock_guard lock (mu);
+    return in_use;
+}
+
+std::size_t Page_Pool::reserved_bytes () const
+{
+    std::lock_guard lock (mu);
+    return blocks.size() * block_size;
+}
@@ -0,0 +1,201 @@
+#include "rom_format.h"
+#include <array>
+#include <cctype>
+#include <optional>
+
+namespace
+{
+    std::optional <std::uint8_t> hex_byte (std::string_view text, const std::size_t index)
+    {
+        if (index + 2 > text.size())
+            return std::nullopt;
+
+        std::uint8_t value = 0;
+        for (std::size_t i = index; i < index + 2; ++i)
+        {
+            const char c = text[i];
+            value <<= 4;
+            if (c >= '0' && c <= '9')
+                value |= c - '0';
+            else if (c >= 'A' && c <= 'F')
+                value |= c - 'A' + 10;
+            else if (c >= 'a' && c <= 'f')
+                value |= c - 'a' + 10;
+            else
+                return std::nullopt;
+        }
+        return value;
+    }
+
+    // decodes the hex pairs after the first skip characters, count is the number of bytes wanted
+    bool decode (std::string_view text, const std::size_t skip, std::span <std::uint8_t> bytes)
+    {
+        for (std::size_t i = 0; i < bytes.size(); ++i)
+        {
+            const auto value = hex_byte (text, skip + i * 2);
+            if (!value)
+                return false;
+            bytes[i] = *value;
+        }
+        return true;
+    }
+
+    std::string_view trim (std::string_view line)
+    {
+        while (!line.empty() && std::isspace(static_cast <unsigned char> (line.back())))
+            line.remove_suffix (1);
+        while (!line.empty() && std::isspace(static_cast <unsigned char> (line.front())))
+            line.remove_prefix (1);
+        return line;
+    }
+
+    bool fail (std::string& error, const std::size_t line_number, const char* reason)
+    {
+        error = "line " + std::to_string (line_number) + ": " + reason;
+        return false;
+    }
+}
+
+Rom_Format detect_format (std::string_view head)
+{
+    head = trim (head);
+    if (head.size() >= 11 && head[0] == ':' && hex_byte (head, 1))
+        return Rom_Format::intel_hex;
+    if (head.size() >= 4 && head[0] == 'S' && head[1] >= '0' && head[1] <= '9' && hex_byte (head, 2))
+        return Rom_Format::srecord;
+    return Rom_Format::binary;
+}
+
+const char* format_name (const Rom_Format format)
+{
+    switch (format)
+    {
+        case Rom_Format::binary:    return "binary";
+        case Rom_Format::intel_hex: return "intel hex";
+        case Rom_Format::srecord:   return "s-record";
+    }
+    return "";
+}
+
+bool parse_intel_hex (std::istream& input, const record_cb& record, std::string& error)
+{
+    // :LLAAAATT data CC, the longest record is 255 data bytes plus 5 bytes of header and checksum
+    std::array <std::uint8_t, 260> bytes;
+    std::uint32_t upper = 0;
+    std::size_t line_number = 0;
+    std::string line;
+
+    while (std::getline (input, line))
+    {
+        ++line_number;
+        const std::string_view text = trim (line);
+        if (text.empty())
+            continue;
+        if (text[0] != ':')
+            return fail (error, line_number, "record doesn't start with ':'");
+
+        const auto count = hex_byte (text, 1);
+        if (!count || text.size() < 11u + *count * 2u)
+            return fail (error, line_number, "record is too short");
+
+        const std::span <std::uint8_t> all (bytes.data(), *count + 5u);
+        if (!decode (text, 1, all))
+            return fail (error, line_number, "bad hex digit");
+
+        std::uint8_t sum = 0;
+        for (const auto b : all)
+            sum += b;
+        if (sum != 0)
+            return fail (error, line_number, "checksum mismatch");
+
+        const std::uint16_t offset = (all[1] << 8) | all[2];
+        const std::span <const std::uint8_t> data = all.subspan (4, *count);
+
+        switch (all[3])
+        {
+            case 0x00:
+                record (upper + offset, data);
+                break;
+            case 0x01:
+                return true;
+            case 0x02: // extended segment address, paragraphs
+                if (*count != 2)
+                    return fail (error, line_number, "bad extended segment address");
+                upper = ((data[0] << 8) | data[1]) << 4;
+                break;
+            case 0x04: // extended linear address, upper 16 bits
+                if (*count != 2)
+                    return fail (error, line_number, "bad extended linear address");
+                upper = ((data[0] << 8) | data[1]) << 16;
+                break;
+            case 0x03:
+            case 0x05: // start address, nothing to do for a rom image
+                break;
+            default:
+                return fail (error, line_number, "unknown record type");
+        }
+    }
+    // a missing end of file record is common enough to let through
+    return true;
+}
+
+bool parse_srecord (std::istream& input, const record_cb& record, std::string& error)
+{
+    // Stcc address data checksum, count covers address, data and checksum
+    std::array <std::uint8_t, 256> bytes;
+    std::size_t line_number = 0;
+    std::string line;
+
+    while (std::getline (input, line))
+    {
+        ++line_number;
+        const std::string_view text = trim (line);
+        if (text.empty())
+            continue;
+        if (text.size() < 4 || text[0] != 'S')
+            return fail (error, line_number, "record doesn't start with 'S'");
+
+        const char type = text[1];
+        const auto count = hex_byte (text, 2);
+        if (!count || text.size() < 4u + *count * 2u || *count < 3)
+            return fail (error, line_number, "record is too short");
+
+        const std::span <std::uint8_t> all (bytes.data(), *count + 1u);
+        if (!decode (text, 2, all))
+            return fail (error, line_number, "bad hex digit");
+
+        std::uint8_t sum = 0;
+        for (std::size_t i = 0; i + 1 < all.size(); ++i)
+            sum += all[i];
+        if (static_cast <std::uint8_t> (~sum) != all.back())
+            return fail (error, line_number, "checksum mismatch");
+
+        std::size_t address_size = 0;
+        switch (type)
+        {
+            case '1': address_size = 2; break;
+            case '2': address_size = 3; break;
+            case '3': address_size = 4; break;
+            case '0': // header
+            case '5': // record counts
+            case '6':
+                continue;
+            case '7':
+            case '8':
+            case '9': // start address, ends the file
+                return true;
+            default:
+                return fail (error, line_number, "unknown record type");
+        }
+
+        if (*count < address_size + 1)
+            return fail (error, line_number, "record is too short");
+
+        std::uint32_t address = 0;
+        for (std::size_t i = 0; i < address_size; ++i)
+            address = (address << 8) | all[1 + i];
+
+        record (address, all.subspan (1 + address_size, *count - address_size - 1));
+    }
+    return true;
+}
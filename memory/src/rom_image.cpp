@@ -0,0 +1,32 @@
+#include "rom_image.h"
+#include "hash.h"
+
+Rom_Image::Rom_Image ()
+: memory {0}
+, contents {}
+, digest {0}
+{
+}
+
+std::shared_ptr <const Rom_Image> Rom_Image::load (const std::string& path, const std::uint32_t origin)
+{
+    std::shared_ptr <Rom_Image> image (new Rom_Image);
+    const bool loaded = image->memory.load (path, origin);
+    return finish (std::move (image), loaded);
+}
+
+std::shared_ptr <const Rom_Image> Rom_Image::copy (std::span <const std::uint8_t> bytes)
+{
+    std::shared_ptr <Rom_Image> image (new Rom_Image);
+    const bool loaded = image->memory.assign (bytes);
+    return finish (std::move (image), loaded);
+}
+
+std::shared_ptr <const Rom_Image> Rom_Image::finish (std::shared_ptr <Rom_Image> image, const bool loaded)
+{
+    if (!loaded)
+        return nullptr;
+    image->contents = {image->memory.data(), image->memory.size()};
+    image->digest = content_hash::hash (image->contents);
+    return image;
+}
@@ -0,0 +1,86 @@
+#ifndef DEBUG_CLIENT_H
+#define DEBUG_CLIENT_H
+
+#include "debug_protocol.h"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+    talks to a Debug_Server. ops are queued on a Batch and go out together, send waits for the one reply
+    that answers all of them
+*/
+class Debug_Client
+{
+public:
+    class Batch
+    {
+    public:
+        Batch ();
+
+        void hello ();
+        void read (const std::uint16_t address, const std::uint32_t size);
+        void write (const std::uint16_t address, std::span <const std::uint8_t> data);
+        void get_state ();
+        void set_registers (const MOS_6502::Registers& registers);
+        void breakpoint (const std::uint16_t address, const bool enabled);
+        void clear_breakpoints ();
+        void step (const std::uint32_t instructions);
+        void run (const std::uint64_t cycles);
+        void reset ();
+        void irq ();
+        void nmi ();
+        void trace (const bool enabled);
+        void drain_trace (const std::uint32_t most);
+        void quit ();
+
+        void clear ();
+        bool empty () const {return ops.empty();}
+
+    private:
+        friend class Debug_Client;
+        std::vector <std::uint8_t> frame;
+        std::vector <Debug_Protocol::Op> ops;
+        std::vector <std::uint32_t> read_sizes; // replies don't repeat them
+    };
+
+    /* what came back for one op, only the fields its op has a payload for are filled in */
+    struct Result
+    {
+        Debug_Protocol::Op op;
+        bool ok = false;
+        std::uint32_t version = 0;               // hello
+        std::uint64_t rom_hash = 0;              // hello
+        std::vector <std::uint8_t> data;         // read
+        Debug_Protocol::Stop stop = Debug_Protocol::Stop::done; // step, run
+        Debug_Protocol::State state {};          // get_state, step, run
+        std::uint32_t dropped = 0;               // drain_trace
+        std::vector <Debug_Protocol::Trace_Entry> trace; // drain_trace
+    };
+
+    Debug_Client ();
+    ~Debug_Client ();
+
+    Debug_Client (const Debug_Client&) = delete;
+    Debug_Client& operator = (const Debug_Client&) = delete;
+
+    /* connects and checks the server speaks the same version */
+    bool connect (const std::string& address);
+    void close ();
+    bool connected () const {return socket >= 0;}
+    std::uint64_t remote_rom_hash () const {return rom_hash;}
+
+    /*
+        one round trip, results has one entry per op in the batch. false if the connection broke, which
+        closes it. ops the server refused or dropped come back with ok false
+    */
+    bool send (Batch& batch, std::vector <Result>& results);
+
+private:
+    int socket;
+    std::uint64_t rom_hash;
+    std::vector <std::uint8_t> reply;
+};
+
+#endif
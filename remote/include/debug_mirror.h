@@ -0,0 +1,54 @@
+#ifndef DEBUG_MIRROR_H
+#define DEBUG_MIRROR_H
+
+#include "breakpoints.h"
+#include "debug_client.h"
+#include "machine.h"
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+/*
+    keeps a local machine looking like one behind a debug server so the gui can debug it without changes.
+    the local machine never runs: ram and registers are copied in after every exchange, and edits made to
+    it in between (pokes, register changes, reloading the rom) go out ahead of the next step or run along
+    with the execute breakpoints. everything for one sync is a single round trip
+*/
+class Debug_Mirror
+{
+public:
+    enum class Motion : std::uint8_t
+    {
+        none,
+        step, // amount instructions
+        run,  // amount cycles
+    };
+
+    Debug_Mirror (Machine& _machine, Breakpoints& _breakpoints, Debug_Client& _client);
+
+    /* pushes local changes, moves the remote machine and pulls it back. trace gets what it ran on the way */
+    bool sync (const Motion motion, const std::uint64_t amount, Debug_Protocol::Stop& stop, std::vector <Debug_Protocol::Trace_Entry>& trace);
+
+    /* the remote counters as of the last sync */
+    std::uint64_t cycles () const {return remote.cycles;}
+    std::uint64_t instructions () const {return remote.instructions;}
+
+private:
+    void push ();
+    void pull (const std::vector <std::uint8_t>& ram);
+
+    Machine& machine;
+    Breakpoints& breakpoints;
+    Debug_Client& client;
+    Debug_Client::Batch batch;
+    std::vector <Debug_Client::Result> results;
+    bool pulled;
+    Debug_Protocol::State remote;
+    std::array <std::uint8_t, Bus::ram_pages * Bus::page_size> remote_ram;
+    std::array <std::uint32_t, Bus::ram_pages> generations; // of the local pages right after the last pull
+    std::uint64_t rom_hash;
+    std::bitset <0x10000> remote_breakpoints;
+};
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef DEBUG_PROTOCOL_H
+#define DEBUG_PROTOCOL_H
+
+#include "mos6502.h"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+    wire format between a debug server and its clients. every message is a frame: u32 length then that many
+    bytes. all integers are little endian. a request frame is any number of ops back to back, each an op byte
+    followed by its arguments, and the reply frame has one result per op in the same order: a status byte
+    (0 ok, 1 failed) followed by the op's payload when it's ok. a request that stops making sense part way
+    through is answered up to that op, which fails, and the ops after it are dropped. so is one whose reply
+    would grow past max_frame, except that drain_trace hands over only as many entries as still fit
+
+    so a client can step, read registers, dump the zero page and collect the trace in one round trip
+
+        op                  arguments                           payload
+        hello               -                                   u32 version, u64 rom hash
+        read                u16 address, u32 size               size bytes, address + size <= $10000
+        write               u16 address, u32 size, bytes        -
+        get_state           -                                   state
+        set_registers       u16 pc, u8 a, x, y, sr, sp          -
+        breakpoint          u16 address, u8 enabled             -
+        clear_breakpoints   -                                   -
+        step                u32 instructions                    u8 stop, state
+        run                 u64 cycles                          u8 stop, state
+        reset               -                                   -
+        irq                 -                                   -
+        nmi                 -                                   -
+        trace               u8 enabled                          -
+        drain_trace         u32 most                            u32 dropped, u32 count, count trace entries
+        quit                -                                   -
+
+    state is u16 pc, u8 a, x, y, sr, sp, u64 cycles, u64 instructions
+    a trace entry is u16 pc of the instruction, u16 pc after it, u8 a, x, y, sr, sp after it, u64 cycles
+*/
+namespace Debug_Protocol
+{
+    static constexpr std::uint32_t version = 1;
+    static constexpr std::uint32_t max_frame = 1 << 24;
+
+    enum class Op : std::uint8_t
+    {
+        hello,
+        read,
+        write,
+        get_state,
+        set_registers,
+        breakpoint,
+        clear_breakpoints,
+        step,
+        run,
+        reset,
+        irq,
+        nmi,
+        trace,
+        drain_trace,
+        quit,
+    };
+
+    enum class Stop : std::uint8_t
+    {
+        done,       // ran everything it was asked to
+        breakpoint, // pc reached a breakpoint
+        idle,       // waiting on an interrupt nothing is going to raise
+    };
+
+    struct State
+    {
+        MOS_6502::Registers registers;
+        std::uint64_t cycles;
+        std::uint64_t instructions;
+    };
+
+    struct Trace_Entry
+    {
+        std::uint16_t pc;
+        MOS_6502::Registers after;
+        std::uint64_t cycles;
+    };
+    static constexpr std::size_t trace_entry_bytes = 17; // on the wire
+
+    /* appends to a frame, the first four bytes are left for the length */
+    class Writer
+    {
+    public:
+        explicit Writer (std::vector <std::uint8_t>& _frame) : frame {_frame} {}
+
+        void u8  (const std::uint8_t value) {frame.push_back (value);}
+        void u16 (const std::uint16_t value) {put (value, 2);}
+        void u32 (const std::uint32_t value) {put (value, 4);}
+        void u64 (const std::uint64_t value) {put (value, 8);}
+        void op  (const Op value) {u8 (static_cast <std::uint8_t> (value));}
+        void bytes (std::span <const std::uint8_t> data) {frame.insert (frame.end(), data.begin(), data.end());}
+        void registers (const MOS_6502::Registers& r);
+        void state (const State& state);
+        void trace_entry (const Trace_Entry& entry);
+
+    private:
+        void put (std::uint64_t value, const int size);
+        std::vector <std::uint8_t>& frame;
+    };
+
+    /* reads a frame body, once anything runs past the end every read returns 0 and ok() stays false */
+    class Reader
+    {
+    public:
+        explicit Reader (std::span <const std::uint8_t> _data) : data {_data}, position {0}, valid {true} {}
+
+        std::uint8_t  u8  () {return static_cast <std::uint8_t> (get (1));}
+        std::uint16_t u16 () {return static_cast <std::uint16_t> (get (2));}
+        std::uint32_t u32 () {return static_cast <std::uint32_t> (get (4));}
+        std::uint64_t u64 () {return get (8);}
+        std::span <const std::uint8_t> bytes (const std::size_t size);
+        MOS_6502::Registers registers ();
+        State state ();
+        Trace_Entry trace_entry ();
+
+        bool ok () const {return valid;}
+        bool done () const {return position == data.size();}
+
+    private:
+        std::uint64_t get (const int size);
+        std::span <const std::uint8_t> data;
+        std::size_t position;
+        bool valid;
+    };
+
+    /*
+        "unix:PATH" or anything with a slash in it is a unix socket, otherwise "[HOST:]PORT" over tcp with
+        HOST defaulting to 127.0.0.1. both return a socket or -1 after saying why on stderr
+    */
+    int listen_to (const std::string& address);
+    int connect_to (const std::string& address);
+
+    /* the file a unix address names, empty for tcp */
+    std::string socket_path (const std::string& address);
+
+    /* frame with four bytes reserved at the front for the length, filled in here */
+    bool send_frame (const int socket, std::vector <std::uint8_t>& frame);
+
+    /* the body of the next frame, false on a closed connection or a frame over max_frame */
+    bool receive_frame (const int socket, std::vector <std::uint8_t>& body);
+
+    /* a frame ready for Writer, the length still to be filled in */
+    inline void start_frame (std::vector <std::uint8_t>& frame) {frame.assign (4, 0);}
+}
+
+#endif
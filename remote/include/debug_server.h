@@ -0,0 +1,55 @@
+#ifndef DEBUG_SERVER_H
+#define DEBUG_SERVER_H
+
+#include "debug_protocol.h"
+#include <bitset>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Machine;
+
+/*
+    serves one machine to debuggers in other processes over a unix socket or localhost tcp, see
+    debug_protocol.h for the wire format. one client at a time, the machine is only touched from the thread
+    calling serve, between requests it sits still
+*/
+class Debug_Server
+{
+public:
+    explicit Debug_Server (Machine& _machine);
+    ~Debug_Server ();
+
+    Debug_Server (const Debug_Server&) = delete;
+    Debug_Server& operator = (const Debug_Server&) = delete;
+
+    bool listen (const std::string& address);
+
+    /* takes clients one after another until one sends quit, false if accepting fails */
+    bool serve ();
+
+    /* trace entries kept for drain_trace, the oldest are dropped past this */
+    void set_trace_capacity (const std::size_t entries);
+
+    /* answers every op in request, reply is a frame ready to send */
+    void handle (std::span <const std::uint8_t> request, std::vector <std::uint8_t>& reply);
+
+private:
+    bool handle_op (Debug_Protocol::Op op, Debug_Protocol::Reader& request, Debug_Protocol::Writer& reply, const std::size_t room);
+    Debug_Protocol::Stop run (const std::uint64_t max_instructions, const std::uint64_t max_cycles);
+    Debug_Protocol::State state () const;
+    void close ();
+
+    Machine& machine;
+    int listener;
+    std::string path;
+    std::bitset <0x10000> breakpoints;
+    bool tracing;
+    std::vector <Debug_Protocol::Trace_Entry> trace; // ring, trace_start is the oldest of trace_count
+    std::size_t trace_start;
+    std::size_t trace_count;
+    std::uint32_t trace_dropped;
+    bool quit;
+};
+
+#endif
@@ -0,0 +1,229 @@
+#include "debug_client.h"
+#include <iostream>
+#include <unistd.h>
+
+using Debug_Protocol::Op;
+
+Debug_Client::Batch::Batch ()
+: frame {}
+, ops {}
+, read_sizes {}
+{
+    clear ();
+}
+
+void Debug_Client::Batch::clear ()
+{
+    Debug_Protocol::start_frame (frame);
+    ops.clear ();
+    read_sizes.clear ();
+}
+
+void Debug_Client::Batch::hello ()
+{
+    Debug_Protocol::Writer (frame).op (Op::hello);
+    ops.push_back (Op::hello);
+}
+
+void Debug_Client::Batch::read (const std::uint16_t address, const std::uint32_t size)
+{
+    Debug_Protocol::Writer out (frame);
+    out.op (Op::read);
+    out.u16 (address);
+    out.u32 (size);
+    ops.push_back (Op::read);
+    read_sizes.push_back (size);
+}
+
+void Debug_Client::Batch::write (const std::uint16_t address, std::span <const std::uint8_t> data)
+{
+    Debug_Protocol::Writer out (frame);
+    out.op (Op::write);
+    out.u16 (address);
+    out.u32 (static_cast <std::uint32_t> (data.size()));
+    out.bytes (data);
+    ops.push_back (Op::write);
+}
+
+void Debug_Client::Batch::get_state ()
+{
+    Debug_Protocol::Writer (frame).op (Op::get_state);
+    ops.push_back (Op::get_state);
+}
+
+void Debug_Client::Batch::set_registers (const MOS_6502::Registers& registers)
+{
+    Debug_Protocol::Writer out (frame);
+    out.op (Op::set_registers);
+    out.registers (registers);
+    ops.push_back (Op::set_registers);
+}
+
+void Debug_Client::Batch::breakpoint (const std::uint16_t address, const bool enabled)
+{
+    Debug_Protocol::Writer out (frame);
+    out.op (Op::breakpoint);
+    out.u16 (address);
+    out.u8 (enabled);
+    ops.push_back (Op::breakpoint);
+}
+
+void Debug_Client::Batch::clear_breakpoints ()
+{
+    Debug_Protocol::Writer (frame).op (Op::clear_breakpoints);
+    ops.push_back (Op::clear_breakpoints);
+}
+
+void Debug_Client::Batch::step (const std::uint32_t instructions)
+{
+    Debug_Protocol::Writer out (frame);
+    out.op (Op::step);
+    out.u32 (instructions);
+    ops.push_back (Op::step);
+}
+
+void Debug_Client::Batch::run (const std::uint64_t cycles)
+{
+    Debug_Protocol::Writer out (frame);
+    out.op (Op::run);
+    out.u64 (cycles);
+    ops.push_back (Op::run);
+}
+
+void Debug_Client::Batch::reset ()
+{
+    Debug_Protocol::Writer (frame).op (Op::reset);
+    ops.push_back (Op::reset);
+}
+
+void Debug_Client::Batch::irq ()
+{
+    Debug_Protocol::Writer (frame).op (Op::irq);
+    ops.push_back (Op::irq);
+}
+
+void Debug_Client::Batch::nmi ()
+{
+    Debug_Protocol::Writer (frame).op (Op::nmi);
+    ops.push_back (Op::nmi);
+}
+
+void Debug_Client::Batch::trace (const bool enabled)
+{
+    Debug_Protocol::Writer out (frame);
+    out.op (Op::trace);
+    out.u8 (enabled);
+    ops.push_back (Op::trace);
+}
+
+void Debug_Client::Batch::drain_trace (const std::uint32_t most)
+{
+    Debug_Protocol::Writer out (frame);
+    out.op (Op::drain_trace);
+    out.u32 (most);
+    ops.push_back (Op::drain_trace);
+}
+
+void Debug_Client::Batch::quit ()
+{
+    Debug_Protocol::Writer (frame).op (Op::quit);
+    ops.push_back (Op::quit);
+}
+
+Debug_Client::Debug_Client ()
+: socket {-1}
+, rom_hash {0}
+, reply {}
+{
+}
+
+Debug_Client::~Debug_Client ()
+{
+    close ();
+}
+
+bool Debug_Client::connect (const std::string& address)
+{
+    close ();
+    socket = Debug_Protocol::connect_to (address);
+    if (socket < 0)
+        return false;
+
+    Batch batch;
+    batch.hello ();
+    std::vector <Result> results;
+    if (!send (batch, results) || !results.front().ok || results.front().version != Debug_Protocol::version)
+    {
+        std::cerr << address << " isn't a debug server speaking version " << Debug_Protocol::version << std::endl;
+        close ();
+        return false;
+    }
+    rom_hash = results.front().rom_hash;
+    return true;
+}
+
+void Debug_Client::close ()
+{
+    if (socket < 0)
+        return;
+    ::close (socket);
+    socket = -1;
+}
+
+bool Debug_Client::send (Batch& batch, std::vector <Result>& results)
+{
+    results.assign (batch.ops.size(), {});
+    for (std::size_t i = 0; i < batch.ops.size(); ++i)
+        results[i].op = batch.ops[i];
+    if (socket < 0)
+        return false;
+    if (!Debug_Protocol::send_frame (socket, batch.frame) || !Debug_Protocol::receive_frame (socket, reply))
+    {
+        std::cerr << "lost the connection to the debug server" << std::endl;
+        close ();
+        return false;
+    }
+
+    Debug_Protocol::Reader in (reply);
+    auto read_size = batch.read_sizes.begin();
+    for (auto& result : results)
+    {
+        if (in.u8 () != 0 || !in.ok())
+            break;
+        switch (result.op)
+        {
+            case Op::hello:
+                result.version = in.u32 ();
+                result.rom_hash = in.u64 ();
+                break;
+            case Op::read:
+            {
+                const auto data = in.bytes (*read_size++);
+                result.data.assign (data.begin(), data.end());
+                break;
+            }
+            case Op::get_state:
+                result.state = in.state ();
+                break;
+            case Op::step:
+            case Op::run:
+                result.stop = static_cast <Debug_Protocol::Stop> (in.u8 ());
+                result.state = in.state ();
+                break;
+            case Op::drain_trace:
+            {
+                result.dropped = in.u32 ();
+                const std::uint32_t count = in.u32 ();
+                for (std::uint32_t i = 0; i < count && in.ok(); ++i)
+                    result.trace.push_back (in.trace_entry ());
+                break;
+            }
+            default:
+                break;
+        }
+        if (!in.ok())
+            break;
+        result.ok = true;
+    }
+    return true;
+}
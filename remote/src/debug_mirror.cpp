@@ -0,0 +1,116 @@
+#include "debug_mirror.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+Debug_Mirror::Debug_Mirror (Machine& _machine, Breakpoints& _breakpoints, Debug_Client& _client)
+: machine {_machine}
+, breakpoints {_breakpoints}
+, client {_client}
+, batch {}
+, results {}
+, pulled {false}
+, remote {}
+, remote_ram {}
+, generations {}
+, rom_hash {0}
+, remote_breakpoints {}
+{
+}
+
+bool Debug_Mirror::sync (const Motion motion, const std::uint64_t amount, Debug_Protocol::Stop& stop, std::vector <Debug_Protocol::Trace_Entry>& trace)
+{
+    batch.clear ();
+    push ();
+    if (motion == Motion::step)
+        batch.step (static_cast <std::uint32_t> (std::min <std::uint64_t> (amount, UINT32_MAX)));
+    else if (motion == Motion::run)
+        batch.run (amount);
+    batch.get_state ();
+    batch.read (0, remote_ram.size());
+    batch.drain_trace (UINT32_MAX);
+
+    stop = Debug_Protocol::Stop::done;
+    trace.clear ();
+    if (!client.send (batch, results))
+        return false;
+    for (const auto& result : results)
+    {
+        if (!result.ok)
+        {
+            std::cerr << "the debug server refused a request" << std::endl;
+            return false;
+        }
+    }
+
+    if (motion != Motion::none)
+        stop = results[results.size() - 4].stop;
+    remote = results[results.size() - 3].state;
+    pull (results[results.size() - 2].data);
+    trace = std::move (results.back().trace);
+    return true;
+}
+
+void Debug_Mirror::push ()
+{
+    if (!pulled)
+    {
+        // whatever an earlier client left behind
+        batch.clear_breakpoints ();
+        batch.trace (true);
+        remote_breakpoints.reset ();
+    }
+    else
+    {
+        // a reset in the gui reloads the rom, which clears ram and resets the cpu
+        const bool reloaded = machine.rom_hash () != rom_hash;
+        if (reloaded)
+            batch.reset ();
+
+        for (std::size_t page = 0; page < Bus::ram_pages; ++page)
+        {
+            if (!reloaded && machine.bus.generation (page) == generations[page])
+                continue;
+            // one write from the first byte that differs to the last
+            const auto local = machine.bus.page_data (page);
+            const std::uint8_t* const old = remote_ram.data() + page * Bus::page_size;
+            std::size_t first = 0;
+            std::size_t last = Bus::page_size;
+            while (first < last && local[first] == old[first])
+                ++first;
+            while (last > first && local[last - 1] == old[last - 1])
+                --last;
+            if (first < last)
+                batch.write (static_cast <std::uint16_t> (page * Bus::page_size + first), local.subspan (first, last - first));
+        }
+
+        if (!reloaded && machine.cpu.get_registers () != remote.registers)
+            batch.set_registers (machine.cpu.get_registers ());
+    }
+
+    std::bitset <0x10000> wanted;
+    breakpoints.for_each (Breakpoints::Kind::execute, [&wanted] (const std::uint16_t address) {wanted.set (address);});
+    const std::bitset <0x10000> changed = wanted ^ remote_breakpoints;
+    for (std::size_t address = changed._Find_first(); address < changed.size(); address = changed._Find_next (address))
+        batch.breakpoint (static_cast <std::uint16_t> (address), wanted[address]);
+    remote_breakpoints = wanted;
+}
+
+void Debug_Mirror::pull (const std::vector <std::uint8_t>& ram)
+{
+    // only pages that changed are loaded, so the hex editors redraw just those
+    for (std::size_t page = 0; page < Bus::ram_pages; ++page)
+    {
+        const std::span <const std::uint8_t, Bus::page_size> data (ram.data() + page * Bus::page_size, Bus::page_size);
+        if (std::memcmp (machine.bus.page_data (page).data(), data.data(), Bus::page_size) != 0)
+            machine.bus.load_page (page, data);
+        generations[page] = machine.bus.generation (page);
+    }
+    std::memcpy (remote_ram.data(), ram.data(), remote_ram.size());
+    machine.set_registers (remote.registers);
+
+    if (machine.rom_hash () != client.remote_rom_hash () && machine.rom_hash () != rom_hash)
+        std::cerr << "the rom loaded here isn't the one the debug server is running" << std::endl;
+    rom_hash = machine.rom_hash ();
+    pulled = true;
+}
@@ -0,0 +1,267 @@
+#include "debug_protocol.h"
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+void Debug_Protocol::Writer::put (std::uint64_t value, const int size)
+{
+    for (int i = 0; i < size; ++i, value >>= 8)
+        frame.push_back (static_cast <std::uint8_t> (value));
+}
+
+void Debug_Protocol::Writer::registers (const MOS_6502::Registers& r)
+{
+    u16 (r.PC);
+    u8 (r.AC);
+    u8 (r.XR);
+    u8 (r.YR);
+    u8 (r.SR);
+    u8 (r.SP);
+}
+
+void Debug_Protocol::Writer::state (const State& state)
+{
+    registers (state.registers);
+    u64 (state.cycles);
+    u64 (state.instructions);
+}
+
+void Debug_Protocol::Writer::trace_entry (const Trace_Entry& entry)
+{
+    u16 (entry.pc);
+    registers (entry.after);
+    u64 (entry.cycles);
+}
+
+std::uint64_t Debug_Protocol::Reader::get (const int size)
+{
+    if (!valid || data.size() - position < static_cast <std::size_t> (size))
+    {
+        valid = false;
+        return 0;
+    }
+    std::uint64_t value = 0;
+    for (int i = 0; i < size; ++i)
+        value |= static_cast <std::uint64_t> (data[position + i]) << (8 * i);
+    position += size;
+    return value;
+}
+
+std::span <const std::uint8_t> Debug_Protocol::Reader::bytes (const std::size_t size)
+{
+    if (!valid || data.size() - position < size)
+    {
+        valid = false;
+        return {};
+    }
+    position += size;
+    return data.subspan (position - size, size);
+}
+
+MOS_6502::Registers Debug_Protocol::Reader::registers ()
+{
+    MOS_6502::Registers r {};
+    r.PC = u16 ();
+    r.AC = u8 ();
+    r.XR = u8 ();
+    r.YR = u8 ();
+    r.SR = u8 ();
+    r.SP = u8 ();
+    return r;
+}
+
+Debug_Protocol::State Debug_Protocol::Reader::state ()
+{
+    State state {};
+    state.registers = registers ();
+    state.cycles = u64 ();
+    state.instructions = u64 ();
+    return state;
+}
+
+Debug_Protocol::Trace_Entry Debug_Protocol::Reader::trace_entry ()
+{
+    Trace_Entry entry {};
+    entry.pc = u16 ();
+    entry.after = registers ();
+    entry.cycles = u64 ();
+    return entry;
+}
+
+namespace
+{
+    // fills in a tcp address from "[HOST:]PORT"
+    bool tcp_address (const std::string& address, sockaddr_in& result)
+    {
+        const auto colon = address.rfind (':');
+        const std::string host = colon == std::string::npos ? "127.0.0.1" : address.substr (0, colon);
+        const std::string port = colon == std::string::npos ? address : address.substr (colon + 1);
+
+        std::uint16_t number = 0;
+        const auto [end, error] = std::from_chars (port.data(), port.data() + port.size(), number);
+        result = {};
+        result.sin_family = AF_INET;
+        result.sin_port = htons (number);
+        if (error != std::errc {} || end != port.data() + port.size() || inet_pton (AF_INET, host.c_str(), &result.sin_addr) != 1)
+        {
+            std::cerr << address << " isn't a unix socket path or [host:]port" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool unix_address (const std::string& path, sockaddr_un& result)
+    {
+        result = {};
+        result.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(result.sun_path))
+        {
+            std::cerr << "socket path " << path << " is empty or too long" << std::endl;
+            return false;
+        }
+        std::memcpy (result.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    // requests are small and every one waits on its reply, so nagle would only add latency
+    void no_delay (const int socket)
+    {
+        const int on = 1;
+        ::setsockopt (socket, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+
+    // a socket file nobody is listening on any more, the connection to it is refused
+    bool stale_socket (const std::string& path, const sockaddr* name, const socklen_t length)
+    {
+        struct stat info {};
+        if (::lstat (path.c_str(), &info) != 0 || !S_ISSOCK (info.st_mode))
+            return false;
+        const int probe = ::socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (probe < 0)
+            return false;
+        const bool refused = ::connect (probe, name, length) != 0 && errno == ECONNREFUSED;
+        ::close (probe);
+        return refused;
+    }
+
+    int open_socket (const std::string& address, const bool listening)
+    {
+        const std::string path = Debug_Protocol::socket_path (address);
+        sockaddr_un local {};
+        sockaddr_in remote {};
+        if (path.empty() ? !tcp_address (address, remote) : !unix_address (path, local))
+            return -1;
+
+        const int fd = ::socket (path.empty() ? AF_INET : AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            std::cerr << "no socket for " << address << ": " << std::strerror (errno) << std::endl;
+            return -1;
+        }
+        const sockaddr* name = path.empty() ? reinterpret_cast <const sockaddr*> (&remote) : reinterpret_cast <const sockaddr*> (&local);
+        const socklen_t length = path.empty() ? sizeof(remote) : sizeof(local);
+
+        bool opened = false;
+        if (listening)
+        {
+            // a socket file left by a server that died would make bind fail. a live server's socket or
+            // anything else there isn't ours to delete, bind fails with address in use instead
+            const int on = 1;
+            if (path.empty())
+                ::setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            else if (stale_socket (path, name, length))
+                ::unlink (path.c_str());
+            opened = ::bind (fd, name, length) == 0 && ::listen (fd, 1) == 0;
+        }
+        else
+            opened = ::connect (fd, name, length) == 0;
+
+        if (!opened)
+        {
+            std::cerr << (listening ? "can't listen on " : "can't connect to ") << address << ": " << std::strerror (errno) << std::endl;
+            ::close (fd);
+            return -1;
+        }
+        if (path.empty() && !listening)
+            no_delay (fd);
+        return fd;
+    }
+
+    bool send_all (const int socket, const std::uint8_t* data, std::size_t size)
+    {
+        while (size > 0)
+        {
+            const ssize_t sent = ::send (socket, data, size, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent <= 0)
+                return false;
+            data += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    bool receive_all (const int socket, std::uint8_t* data, std::size_t size)
+    {
+        while (size > 0)
+        {
+            const ssize_t received = ::recv (socket, data, size, 0);
+            if (received < 0 && errno == EINTR)
+                continue;
+            if (received <= 0)
+                return false;
+            data += received;
+            size -= received;
+        }
+        return true;
+    }
+}
+
+std::string Debug_Protocol::socket_path (const std::string& address)
+{
+    if (address.starts_with ("unix:"))
+        return address.substr (5);
+    return address.find ('/') != std::string::npos ? address : std::string {};
+}
+
+int Debug_Protocol::listen_to (const std::string& address)
+{
+    return open_socket (address, true);
+}
+
+int Debug_Protocol::connect_to (const std::string& address)
+{
+    return open_socket (address, false);
+}
+
+bool Debug_Protocol::send_frame (const int socket, std::vector <std::uint8_t>& frame)
+{
+    const std::uint32_t length = static_cast <std::uint32_t> (frame.size() - 4);
+    for (int i = 0; i < 4; ++i)
+        frame[i] = static_cast <std::uint8_t> (length >> (8 * i));
+    return send_all (socket, frame.data(), frame.size());
+}
+
+bool Debug_Protocol::receive_frame (const int socket, std::vector <std::uint8_t>& body)
+{
+    std::uint8_t prefix[4];
+    if (!receive_all (socket, prefix, sizeof(prefix)))
+        return false;
+    const std::uint32_t length = prefix[0] | prefix[1] << 8 | prefix[2] << 16 | static_cast <std::uint32_t> (prefix[3]) << 24;
+    if (length > max_frame)
+    {
+        std::cerr << "debug frame of " << length << " bytes is over the limit" << std::endl;
+        return false;
+    }
+    body.resize (length);
+    return receive_all (socket, body.data(), length);
+}
@@ -0,0 +1,271 @@
+#include "debug_server.h"
+#include "machine.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using Debug_Protocol::Op;
+using Debug_Protocol::Stop;
+
+Debug_Server::Debug_Server (Machine& _machine)
+: machine {_machine}
+, listener {-1}
+, path {}
+, breakpoints {}
+, tracing {false}
+, trace (0x10000)
+, trace_start {0}
+, trace_count {0}
+, trace_dropped {0}
+, quit {false}
+{
+}
+
+Debug_Server::~Debug_Server ()
+{
+    close ();
+}
+
+bool Debug_Server::listen (const std::string& address)
+{
+    close ();
+    listener = Debug_Protocol::listen_to (address);
+    if (listener < 0)
+        return false;
+    path = Debug_Protocol::socket_path (address);
+    return true;
+}
+
+void Debug_Server::close ()
+{
+    if (listener < 0)
+        return;
+    ::close (listener);
+    if (!path.empty())
+        ::unlink (path.c_str());
+    listener = -1;
+    path.clear ();
+}
+
+void Debug_Server::set_trace_capacity (const std::size_t entries)
+{
+    trace.assign (std::max <std::size_t> (entries, 1), {});
+    trace_start = 0;
+    trace_count = 0;
+}
+
+bool Debug_Server::serve ()
+{
+    quit = false;
+    std::vector <std::uint8_t> request;
+    std::vector <std::uint8_t> reply;
+    while (!quit)
+    {
+        const int client = ::accept4 (listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0 && errno == EINTR)
+            continue;
+        if (client < 0)
+        {
+            std::cerr << "debug server stopped accepting: " << std::strerror (errno) << std::endl;
+            return false;
+        }
+        // fails harmlessly on a unix socket
+        const int on = 1;
+        ::setsockopt (client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        while (!quit && Debug_Protocol::receive_frame (client, request))
+        {
+            handle (request, reply);
+            if (!Debug_Protocol::send_frame (client, reply))
+                break;
+        }
+        ::close (client);
+    }
+    return true;
+}
+
+void Debug_Server::handle (std::span <const std::uint8_t> request, std::vector <std::uint8_t>& reply)
+{
+    Debug_Protocol::start_frame (reply);
+    Debug_Protocol::Reader input (request);
+    Debug_Protocol::Writer output (reply);
+    while (!input.done())
+    {
+        // a full reply has no space left even for a status, the ops still to come are dropped
+        if (reply.size() - 4 >= Debug_Protocol::max_frame)
+            break;
+        const Op op = static_cast <Op> (input.u8 ());
+        const std::size_t status = reply.size();
+        output.u8 (0);
+        // bytes the payload may take before the client would refuse the frame
+        const std::size_t room = Debug_Protocol::max_frame - (reply.size() - 4);
+        if (!handle_op (op, input, output, room) || !input.ok() || reply.size() - 4 > Debug_Protocol::max_frame)
+        {
+            reply.resize (status);
+            output.u8 (1);
+            break;
+        }
+    }
+}
+
+bool Debug_Server::handle_op (const Op op, Debug_Protocol::Reader& request, Debug_Protocol::Writer& reply, const std::size_t room)
+{
+    switch (op)
+    {
+        case Op::hello:
+            reply.u32 (Debug_Protocol::version);
+            reply.u64 (machine.rom_hash ());
+            return true;
+
+        case Op::read:
+        {
+            const std::uint16_t address = request.u16 ();
+            const std::uint32_t size = request.u32 ();
+            if (!request.ok() || size > 0x10000u - address || size > room)
+                return false;
+            for (std::uint32_t i = 0; i < size; ++i)
+                reply.u8 (machine.bus.peek (address + i));
+            return true;
+        }
+
+        case Op::write:
+        {
+            const std::uint16_t address = request.u16 ();
+            const std::uint32_t size = request.u32 ();
+            if (size > 0x10000u - address)
+                return false;
+            const auto data = request.bytes (size);
+            if (!request.ok())
+                return false;
+            for (std::uint32_t i = 0; i < size; ++i)
+                machine.poke (address + i, data[i]);
+            return true;
+        }
+
+        case Op::get_state:
+            reply.state (state ());
+            return true;
+
+        case Op::set_registers:
+        {
+            const MOS_6502::Registers registers = request.registers ();
+            if (!request.ok())
+                return false;
+            machine.set_registers (registers);
+            return true;
+        }
+
+        case Op::breakpoint:
+        {
+            const std::uint16_t address = request.u16 ();
+            const bool enabled = request.u8 () != 0;
+            if (!request.ok())
+                return false;
+            breakpoints[address] = enabled;
+            return true;
+        }
+
+        case Op::clear_breakpoints:
+            breakpoints.reset ();
+            return true;
+
+        case Op::step:
+        case Op::run:
+        {
+            const std::uint64_t amount = op == Op::step ? request.u32 () : request.u64 ();
+            if (!request.ok())
+                return false;
+            const Stop stop = op == Op::step ? run (amount, UINT64_MAX) : run (UINT64_MAX, amount);
+            reply.u8 (static_cast <std::uint8_t> (stop));
+            reply.state (state ());
+            return true;
+        }
+
+        case Op::reset:
+            machine.reset ();
+            return true;
+
+        case Op::irq:
+            machine.raise_irq ();
+            return true;
+
+        case Op::nmi:
+            machine.raise_nmi ();
+            return true;
+
+        case Op::trace:
+        {
+            const bool enabled = request.u8 () != 0;
+            if (!request.ok())
+                return false;
+            tracing = enabled;
+            trace_start = 0;
+            trace_count = 0;
+            trace_dropped = 0;
+            return true;
+        }
+
+        case Op::drain_trace:
+        {
+            const std::uint32_t most = request.u32 ();
+            if (!request.ok() || room < 8)
+                return false;
+            const std::size_t fits = (room - 8) / Debug_Protocol::trace_entry_bytes;
+            const std::size_t count = std::min ({std::size_t {most}, trace_count, fits});
+            reply.u32 (trace_dropped);
+            reply.u32 (static_cast <std::uint32_t> (count));
+            for (std::size_t i = 0; i < count; ++i)
+                reply.trace_entry (trace[(trace_start + i) % trace.size()]);
+            trace_start = (trace_start + count) % trace.size();
+            trace_count -= count;
+            trace_dropped = 0;
+            return true;
+        }
+
+        case Op::quit:
+            quit = true;
+            return true;
+    }
+    return false;
+}
+
+Stop Debug_Server::run (const std::uint64_t max_instructions, const std::uint64_t max_cycles)
+{
+    const std::uint64_t limit = max_cycles > UINT64_MAX - machine.cycles () ? UINT64_MAX : machine.cycles () + max_cycles;
+    // counted steps stay exact, only a run by cycles skips idle loops
+    const bool skipping = max_instructions == UINT64_MAX;
+    for (std::uint64_t done = 0; done < max_instructions && machine.cycles () < limit; ++done)
+    {
+        machine.step ();
+        if (tracing)
+        {
+            if (trace_count == trace.size())
+            {
+                trace_start = (trace_start + 1) % trace.size();
+                --trace_count;
+                ++trace_dropped;
+            }
+            trace[(trace_start + trace_count++) % trace.size()] = {machine.cpu.old_PC, machine.cpu.get_registers (), machine.cycles ()};
+        }
+
+        if (breakpoints[machine.cpu.get_PC ()])
+            return Stop::breakpoint;
+        if (skipping && machine.idle ())
+        {
+            if (machine.next_event () == UINT64_MAX)
+                return Stop::idle;
+            machine.skip_idle (limit);
+        }
+    }
+    return Stop::done;
+}
+
+Debug_Protocol::State Debug_Server::state () const
+{
+    return {machine.cpu.get_registers (), machine.cycles (), machine.instructions ()};
+}
@@ -1,9 +1,22 @@
 #ifndef DEBUGGER_H
 #define DEBUGGER_H
 
+#include "analysis_cache.h"
+#include "breakpoints.h"
+#include "catalog.h"
+#include "checkpoints.h"
+#include "disassembler.h"
+#include "hash_trace.h"
+#include "machine.h"
 #include "mos6502.h"
+#include "search.h"
+#include "watchpoints.h"
 #include "window.h"
+#include <atomic>
 #include <condition_variable>
+#include <functional>
+#include <optional>
+#include <vector>
 
 
 namespace MOS_6502
@@ -12,15 +25,9 @@ namespace MOS_6502
     class CPU_Trace;
 }
 
+class Bus;
 class Memory;
 
-struct File_info
-{
-    std::string file_name;
-    std::string file_path;
-    std::size_t file_size;
-};
-
 class GUI
 {
 
@@ -31,8 +38,12 @@ public:
     bool is_paused = true;
     bool step = false;
 
+    /* work for the cpu thread, run between instructions even while paused, guarded by mu */
+    using command_type = std::function <void(void)>;
+    std::vector <command_type> commands;
+
     // GUI (Emulator_state& data);
-    GUI (MOS_6502::CPU& _cpu, Memory& _rom, Memory& _ram, MOS_6502::trace_type& _traces, MOS_6502::code_map_type& _code_map);
+    GUI (Machine& _machine, Checkpoints& _checkpoints, Hash_Trace& _hashes, MOS_6502::trace_type& _traces, MOS_6502::Disassembler& _disassembler, Breakpoints& _breakpoints, Watchpoints& _watchpoints);
     void run ();
     bool is_running() {return window.is_running();}
 
@@ -43,17 +54,59 @@ private:
     void trace_window (void);
     void rom_select_box (void);
     void action_bar (void);
+    void breakpoints_window (void);
+    void watchpoints_window (void);
+    void search_window (void);
+    void heatmap_window (void);
+    void post (command_type command);
+    void seek (const bool by_cycle, const std::uint64_t target);
+    void step_back (const bool to_breakpoint);
 
     Window window;
+    Machine& machine;
+    Checkpoints& checkpoints;
+    Hash_Trace& hashes;
     MOS_6502::CPU& cpu;
+    Bus& bus;
     Memory& rom;
     Memory& ram;
     MOS_6502::trace_type& traces;
-    MOS_6502::code_map_type& code_map;
-    std::vector <MOS_6502::line_type> code;
-    File_info* current_rom;
-    std::vector <File_info> roms;
+    MOS_6502::Disassembler& disassembler;
+    Breakpoints& breakpoints;
+    Watchpoints& watchpoints;
+    std::shared_ptr <const MOS_6502::Disassembler::Listing> listing;
+    Rom_Catalog catalog;
+    std::optional <Rom_Catalog::Entry> current_rom;
+    Analysis_Cache analysis_cache;
+    std::optional <std::uint64_t> loaded_hash; // content hash of the rom that's running
     std::array <std::function<std::uint16_t(void)>, 14> register_callbacks;
+    std::array <char, 5> breakpoint_address;
+    std::array <char, 128> breakpoint_condition;
+    std::string breakpoint_error;
+    std::array <char, 5> watch_begin;
+    std::array <char, 5> watch_end;
+    int watch_kind;
+    Memory_Search search;
+    int search_region;
+    int search_width;
+    int search_value;
+    double search_time;
+    std::array <char, 64> search_pattern;
+    std::vector <std::size_t> pattern_hits;
+    unsigned int heat_texture;
+    std::vector <std::uint32_t> heat_pixels;
+    std::atomic <float> state_time; // ms the last save or load took, negative when it failed
+    std::uint64_t scrub_position;
+    bool scrubbing;
+    std::uint64_t seek_target;
+    int seek_by_cycle;
+    std::atomic <bool> seeking;
+    std::atomic <bool> seek_failed;
+    bool journal_enabled;
+    Input_Log input_log; // only touched on the cpu thread
+    bool recording;
+    std::uint64_t hash_interval;
+    std::atomic <std::int64_t> hash_mismatch; // -1 none found, -2 nothing to compare against, -3 not compared yet
 };
 
 
@@ -3,8 +3,10 @@
 
 
 
+#include <array>
 #include <span>
 #include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -22,10 +24,25 @@ public:
                 const std::size_t type_size,
                 void * const buffer);
 
+    /* index is into the whole buffer, not the view */
+    using write_cb = std::function <void(const std::size_t index, const std::uint8_t value)>;
+
+    /* edits go through here when set instead of straight into the buffer */
+    void on_write (write_cb callback);
+
+    /* page is index / page_size into the whole buffer, returns a number that moves whenever the page is written */
+    using generation_cb = std::function <std::uint32_t(const std::size_t page)>;
+
+    /* without this every byte is compared every frame */
+    void track (generation_cb callback);
+
     void present (void);
     static int input_callback (ImGuiInputTextCallbackData* data);
 
 private:
+    static constexpr std::size_t  page_size        = 0x100;
+    static constexpr std::uint32_t highlight_frames = 60;
+    static constexpr std::uint32_t stale            = UINT32_MAX;
 
     struct Sizes
     {
@@ -64,9 +81,20 @@ private:
     std::uint16_t selected_index;
 
     std::vector <char> lookup_buffer;
+    write_cb write;
+    generation_cb generation;
+
+    // what was drawn last frame, only pages whose generation moved are copied and reformatted
+    std::vector <std::uint8_t>           shown;
+    std::vector <std::array <char, 3>>   text;
+    std::vector <std::uint32_t>          changed_at; // frame each byte last changed
+    std::vector <std::uint32_t>          seen;       // generation per page of the view
+    std::uint32_t                        frame;
 
 
     void calc (void);
+    void sync (void);
+    void format (const std::size_t index);
     void draw_column_labels (void);
 
 };
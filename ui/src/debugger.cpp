@@ -1,4 +1,8 @@
 #include "debugger.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -10,7 +14,9 @@
 #include <immintrin.h>
 #include <iostream>
 #include <mutex>
+#include <optional>
 #include <stdexcept>
+#include "bus.h"
 #include "hex_editor.h"
 #include "imgui_internal.h"
 #include "mos6502.h"
@@ -25,6 +31,7 @@
 namespace
 {
     // idk how else to do this...
+    constexpr std::size_t journal_capacity = 0x400000; // around 400k instructions
     static auto roms_path = std::filesystem::path(__FILE__).parent_path().parent_path().parent_path().string() + "/roms/";
     static auto font_path = std::filesystem::path(__FILE__).parent_path().parent_path().parent_path().string() + "/imgui/misc/fonts/Cousine-Regular.ttf";
 
@@ -33,6 +40,21 @@ namespace
     static Hex_Editor ram_data ("RAM",  UINT16_MAX, 0, UINT16_MAX, sizeof(std::uint8_t), temp.data());
     static Hex_Editor stack_page ("Stack page", UINT16_MAX, 0, UINT16_MAX, sizeof(std::uint8_t), temp.data());
     static Hex_Editor zero_page  ("Zero page",  UINT16_MAX, 0, UINT16_MAX, sizeof(std::uint8_t), temp.data());
+
+    // beside the analysis cache, keyed the same way so states and recordings follow their rom around
+    std::filesystem::path rom_file (const std::uint64_t hash, const char* extension)
+    {
+        char name[48];
+        std::snprintf (name, sizeof(name), "%016llx.%s", static_cast <unsigned long long> (hash), extension);
+        return Analysis_Cache::default_directory() / name;
+    }
+
+    // the hashed rom list goes with the other caches too, not into the source tree. none without a cache directory
+    std::filesystem::path catalog_index ()
+    {
+        const auto directory = Analysis_Cache::default_directory();
+        return directory.empty() ? directory : directory / "roms.catalog";
+    }
 }
 
 void GUI::registers ()
@@ -70,7 +92,24 @@ void GUI::registers ()
 
 void GUI::code_window ()
 {
+    // pick up code that was written since the last frame, and code the cpu reached that the flow never found
+    disassembler.refresh([this] (const auto address) {return bus.peek(address);}, [this] (const auto page) {return bus.generation(page);});
+    listing = disassembler.listing();
+    if (listing->complete)
+    {
+        const auto* line = listing->map.find(cpu.get_PC());
+        if (line == nullptr || line->has(MOS_6502::Line_Flag::data))
+        {
+            disassembler.add_entry(cpu.get_PC());
+            listing = disassembler.listing();
+        }
+    }
+    const auto& code = listing->lines;
+
     ImGui::Begin("Code", 0);
+    if (!listing->complete)
+        ImGui::TextDisabled("disassembling...");
+
     if (ImGui::BeginTable("##code table", 2,  ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg))
     {
         ImGui::TableSetupColumn("BRK", ImGuiTableColumnFlags_WidthFixed);
@@ -81,22 +120,29 @@ void GUI::code_window ()
         {
             for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
             {
+                const bool is_data = code[row].has(MOS_6502::Line_Flag::data);
                 ImGui::TableNextRow();
                 ImGui::TableSetColumnIndex(0);
-                ImGui::PushID(row);
-                ImGui::PushStyleColor(ImGuiCol_CheckMark, IM_COL32(255, 0, 0, 255));
-                if (ImGui::RadioButton("##xx", std::get<2>(code[row])))
+                if (!is_data)
                 {
-                    auto& brk = std::get<2>(code[row]);
-                    brk = !brk;
+                    ImGui::PushID(row);
+                    ImGui::PushStyleColor(ImGuiCol_CheckMark, IM_COL32(255, 0, 0, 255));
+                    if (ImGui::RadioButton("##xx", breakpoints.test(Breakpoints::Kind::execute, code[row].address)))
+                        breakpoints.toggle(Breakpoints::Kind::execute, code[row].address);
+                    ImGui::PopStyleColor();
+                    ImGui::PopID();
                 }
-                ImGui::PopStyleColor();
-                ImGui::PopID();
                 ImGui::TableSetColumnIndex(1);
 
-                if (std::get<0>(code[row]) == (0x7FFF & cpu.get_PC())) // TODO let user set entry point of 0x7000
+                if (code[row].address == cpu.get_PC())
                     ImGui::TableSetBgColor(ImGuiTableBgTarget_CellBg, IM_COL32(0, 255, 0, 100));
-                ImGui::Text("%s", std::get<1>(code[row]).c_str());
+
+                MOS_6502::line_text text;
+                MOS_6502::format_line(text.data(), text.size(), code[row]);
+                if (is_data || code[row].has(MOS_6502::Line_Flag::illegal))
+                    ImGui::TextDisabled("%s", text.data());
+                else
+                    ImGui::TextUnformatted(text.data());
             }
         }
         ImGui::EndTable();
@@ -111,7 +157,70 @@ void GUI::trace_window ()
 
 
     ImGui::Begin("Trace", 0, ImGuiWindowFlags_NoScrollWithMouse | ImGuiWindowFlags_NoScrollbar);
-    
+
+    // scrubber over the part of the run the checkpoints can reach, dragging seeks as fast as the cpu thread keeps up
+    const std::uint64_t first = checkpoints.first();
+    const std::uint64_t last  = std::max(checkpoints.last(), checkpoints.current());
+    ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
+    if (!scrubbing && !seeking)
+        scrub_position = checkpoints.current();
+    ImGui::BeginDisabled(first >= last);
+    ImGui::SliderScalar("##scrub", ImGuiDataType_U64, &scrub_position, &first, &last, "instruction %llu");
+    scrubbing = ImGui::IsItemActive();
+    if ((ImGui::IsItemEdited() && !seeking) || ImGui::IsItemDeactivatedAfterEdit())
+        seek(false, scrub_position);
+    ImGui::EndDisabled();
+
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(ImGui::CalcTextSize("000000000000").x);
+    ImGui::InputScalar("##seek target", ImGuiDataType_U64, &seek_target);
+    ImGui::SameLine();
+    ImGui::RadioButton("instruction", &seek_by_cycle, 0);
+    ImGui::SameLine();
+    ImGui::RadioButton("cycle", &seek_by_cycle, 1);
+    ImGui::SameLine();
+    if (ImGui::Button("Go to"))
+        seek(seek_by_cycle, seek_target);
+    if (seek_failed)
+    {
+        ImGui::SameLine();
+        ImGui::Text("out of reach, checkpoints cover instructions %llu to %llu", static_cast <unsigned long long> (first), static_cast <unsigned long long> (last));
+    }
+
+    // state hashes every n instructions, saved and compared against an earlier run of the same rom
+    ImGui::SetNextItemWidth(ImGui::CalcTextSize("000000000000").x);
+    ImGui::InputScalar("hash every", ImGuiDataType_U64, &hash_interval);
+    ImGui::SameLine();
+    if (ImGui::Button("Apply"))
+        post([this, interval = hash_interval] () {hashes.set_interval(interval);});
+    ImGui::SameLine();
+    ImGui::Text("%zu hashes", hashes.count());
+    ImGui::SameLine();
+    if (ImGui::Button("Save hashes"))
+        post([this] () {hashes.write(rom_file(machine.rom_hash(), "hashes"));});
+    ImGui::SameLine();
+    if (ImGui::Button("Compare"))
+    {
+        post([this] ()
+        {
+            Hash_Trace saved;
+            if (!saved.read(rom_file(machine.rom_hash(), "hashes")))
+            {
+                hash_mismatch = -2;
+                return;
+            }
+            const auto mismatch = Hash_Trace::first_mismatch(saved, hashes);
+            hash_mismatch = mismatch ? static_cast <std::int64_t> (*mismatch) : -1;
+        });
+    }
+    ImGui::SameLine();
+    if (hash_mismatch >= 0)
+        ImGui::Text("runs differ by instruction %lld", static_cast <long long> (hash_mismatch.load()));
+    else if (hash_mismatch == -2)
+        ImGui::TextUnformatted("no saved hashes");
+    else if (hash_mismatch == -1)
+        ImGui::TextUnformatted("no difference");
+
     if (ImGui::BeginTable("##trace table", 14, ImGuiTableFlags_ScrollY | ImGuiTableFlags_SizingFixedFit | ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
     {
     
@@ -157,20 +266,345 @@ void GUI::trace_window ()
 }
 
 
+void GUI::breakpoints_window ()
+{
+    static constexpr ImGuiInputTextFlags input_flags = ImGuiInputTextFlags_EnterReturnsTrue;
+    static constexpr int table_flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+
+    ImGui::Begin("Breakpoints");
+
+    ImGui::SetNextItemWidth(ImGui::CalcTextSize("FFFF").x * 2);
+    bool add = ImGui::InputText("##bp address", breakpoint_address.data(), breakpoint_address.size(), input_flags | ImGuiInputTextFlags_CharsHexadecimal);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(ImGui::CalcTextSize("F").x * 40);
+    add |= ImGui::InputText("##bp condition", breakpoint_condition.data(), breakpoint_condition.size(), input_flags);
+    ImGui::SameLine();
+    add |= ImGui::Button("Add");
+
+    if (add && breakpoint_address[0] != '\0')
+    {
+        const auto address = static_cast <std::uint16_t> (std::strtol(breakpoint_address.data(), nullptr, 16));
+        if (breakpoints.set_condition(address, breakpoint_condition.data(), breakpoint_error))
+            breakpoint_error.clear();
+    }
+
+    if (!breakpoint_error.empty())
+        ImGui::TextColored({1, 0.3f, 0.3f, 1}, "%s", breakpoint_error.c_str());
+
+    if (ImGui::BeginTable("##breakpoint table", 4, table_flags))
+    {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Address", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("Hits", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("Condition");
+        ImGui::TableSetupColumn("##remove", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableHeadersRow();
+
+        std::vector <std::uint16_t> removed;
+        breakpoints.for_each(Breakpoints::Kind::execute, [&] (const std::uint16_t address)
+        {
+            const auto status = breakpoints.status(address);
+            ImGui::PushID(address);
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%04X", address);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%llu", static_cast <unsigned long long> (status.hits));
+            ImGui::TableSetColumnIndex(2);
+            ImGui::TextUnformatted(status.condition.empty() ? "always" : status.condition.c_str());
+            ImGui::TableSetColumnIndex(3);
+            if (ImGui::SmallButton("X"))
+                removed.push_back(address);
+            ImGui::PopID();
+        });
+
+        for (const auto address : removed)
+            breakpoints.set(Breakpoints::Kind::execute, address, false);
+
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
+void GUI::watchpoints_window ()
+{
+    static constexpr std::array <const char*, 3> kind_names = {"Read", "Write", "Change"};
+    static constexpr ImGuiInputTextFlags input_flags = ImGuiInputTextFlags_EnterReturnsTrue | ImGuiInputTextFlags_CharsHexadecimal;
+    static constexpr int table_flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+
+    ImGui::Begin("Watchpoints");
+
+    const float address_width = ImGui::CalcTextSize("FFFF").x * 2;
+    ImGui::SetNextItemWidth(address_width);
+    bool add = ImGui::InputText("##watch begin", watch_begin.data(), watch_begin.size(), input_flags);
+    ImGui::SameLine();
+    ImGui::TextUnformatted("-");
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(address_width);
+    add |= ImGui::InputText("##watch end", watch_end.data(), watch_end.size(), input_flags);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(ImGui::CalcTextSize("Change").x * 2);
+    ImGui::Combo("##watch kind", &watch_kind, kind_names.data(), kind_names.size());
+    ImGui::SameLine();
+    add |= ImGui::Button("Add");
+
+    if (add && watch_begin[0] != '\0')
+    {
+        const auto begin = static_cast <std::uint16_t> (std::strtol(watch_begin.data(), nullptr, 16));
+        const auto end   = watch_end[0] != '\0' ? static_cast <std::uint16_t> (std::strtol(watch_end.data(), nullptr, 16)) : begin;
+        watchpoints.add({begin, end, static_cast <Watchpoints::Kind> (watch_kind)});
+    }
+
+    if (const auto hit = watchpoints.last_hit())
+    {
+        ImGui::Text("%s $%04X by instruction at $%04X: %02X -> %02X",
+                    kind_names[static_cast <std::size_t> (hit->kind)], hit->address, hit->pc, hit->old_value, hit->new_value);
+    }
+
+    if (ImGui::BeginTable("##watch table", 3, table_flags))
+    {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Range");
+        ImGui::TableSetupColumn("Kind", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableSetupColumn("##remove", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableHeadersRow();
+
+        const auto ranges = watchpoints.ranges();
+        std::optional <std::size_t> removed;
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+        {
+            ImGui::PushID(i);
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            if (ranges[i].begin == ranges[i].end)
+                ImGui::Text("%04X", ranges[i].begin);
+            else
+                ImGui::Text("%04X - %04X", ranges[i].begin, ranges[i].end);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::TextUnformatted(kind_names[static_cast <std::size_t> (ranges[i].kind)]);
+            ImGui::TableSetColumnIndex(2);
+            if (ImGui::SmallButton("X"))
+                removed = i;
+            ImGui::PopID();
+        }
+
+        if (removed)
+            watchpoints.remove(*removed);
+
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
+void GUI::search_window ()
+{
+    static constexpr std::array <const char*, 2> region_names = {"RAM", "ROM"};
+    static constexpr std::array <const char*, 2> width_names  = {"Byte", "Word"};
+    static constexpr std::array <std::uint16_t, 2> region_base = {0x0000, 0x8000};
+    static constexpr std::size_t shown_results = 512;
+    static constexpr int table_flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg;
+
+    // ram above $7FFF isn't on the bus
+    const std::span <const std::uint8_t> block = search_region == 0
+        ? std::span <const std::uint8_t> (ram.data(), std::min <std::size_t> (ram.size(), 0x8000))
+        : std::span <const std::uint8_t> (rom.data(), rom.size());
+    const std::uint16_t base = region_base[search_region];
+
+    ImGui::Begin("Search");
+
+    ImGui::SetNextItemWidth(ImGui::CalcTextSize("RAM").x * 3);
+    bool restart = ImGui::Combo("##search region", &search_region, region_names.data(), region_names.size());
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(ImGui::CalcTextSize("Word").x * 3);
+    restart |= ImGui::Combo("##search width", &search_width, width_names.data(), width_names.size());
+    if (restart)
+    {
+        search = {};
+        pattern_hits.clear();
+    }
+
+    ImGui::SameLine();
+    if (ImGui::Button("New search"))
+        search.start(block, static_cast <Memory_Search::Width> (search_width));
+
+    ImGui::SetNextItemWidth(ImGui::CalcTextSize("F").x * 12);
+    ImGui::InputInt("value", &search_value);
+
+    std::optional <Memory_Search::Filter> filter;
+    if (ImGui::Button("= value"))   filter = Memory_Search::Filter::equal;
+    ImGui::SameLine();
+    if (ImGui::Button("+= value"))  filter = Memory_Search::Filter::increased_by;
+    ImGui::SameLine();
+    if (ImGui::Button("Changed"))   filter = Memory_Search::Filter::changed;
+    ImGui::SameLine();
+    if (ImGui::Button("Unchanged")) filter = Memory_Search::Filter::unchanged;
+    ImGui::SameLine();
+    if (ImGui::Button("Increased")) filter = Memory_Search::Filter::increased;
+    ImGui::SameLine();
+    if (ImGui::Button("Decreased")) filter = Memory_Search::Filter::decreased;
+
+    if (filter)
+    {
+        if (!search.started())
+            search.start(block, static_cast <Memory_Search::Width> (search_width));
+        const auto start = std::chrono::steady_clock::now();
+        search.narrow(block, *filter, static_cast <std::uint16_t> (search_value));
+        search_time = std::chrono::duration <double, std::micro> (std::chrono::steady_clock::now() - start).count();
+    }
+
+    if (search.started())
+    {
+        ImGui::Text("%zu candidates, last pass %.1f us", search.count(), search_time);
+
+        if (ImGui::BeginTable("##search table", 2, table_flags, {0, ImGui::GetTextLineHeightWithSpacing() * 12}))
+        {
+            ImGui::TableSetupScrollFreeze(0, 1);
+            ImGui::TableSetupColumn("Address", ImGuiTableColumnFlags_WidthFixed);
+            ImGui::TableSetupColumn("Value");
+            ImGui::TableHeadersRow();
+
+            for (const auto index : search.results(shown_results))
+            {
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::Text("%04zX", base + index);
+                ImGui::TableSetColumnIndex(1);
+                const auto value = search.value(index);
+                ImGui::Text(search.width() == Memory_Search::Width::word ? "%04X (%u)" : "%02X (%u)", value, value);
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    ImGui::Separator();
+
+    // hex bytes, spaces optional
+    ImGui::SetNextItemWidth(ImGui::CalcTextSize("F").x * 32);
+    bool find = ImGui::InputText("##search pattern", search_pattern.data(), search_pattern.size(), ImGuiInputTextFlags_EnterReturnsTrue);
+    ImGui::SameLine();
+    find |= ImGui::Button("Find");
+
+    if (find)
+    {
+        std::vector <std::uint8_t> pattern;
+        std::string digits;
+        for (const char c : std::string_view(search_pattern.data()))
+        {
+            if (std::isxdigit(static_cast <unsigned char> (c)))
+                digits += c;
+        }
+        for (std::size_t i = 0; i + 1 < digits.size(); i += 2)
+            pattern.push_back(static_cast <std::uint8_t> (std::stoi(digits.substr(i, 2), nullptr, 16)));
+        pattern_hits = Memory_Search::find(block, pattern, shown_results);
+    }
+
+    if (!pattern_hits.empty())
+    {
+        ImGui::Text("%zu matches", pattern_hits.size());
+        for (const auto index : pattern_hits)
+            ImGui::Text("%04zX", base + index);
+    }
+
+    ImGui::End();
+}
+
+void GUI::heatmap_window ()
+{
+    static constexpr int side = 256;
+    static constexpr float scale = 2.f;
+    static constexpr unsigned decay_shift = 4; // per frame
+
+    if (!ImGui::Begin("Heatmap"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    bool counting = bus.heat_enabled();
+    if (ImGui::Checkbox("Count accesses", &counting))
+        bus.set_heat(counting);
+    ImGui::SameLine();
+    if (ImGui::Button("Clear"))
+        bus.heat().clear();
+    ImGui::TextDisabled("red: write  green: read  blue: execute, one row per page");
+
+    if (heat_texture == 0)
+    {
+        glGenTextures(1, &heat_texture);
+        glBindTexture(GL_TEXTURE_2D, heat_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, side, side, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    // counters are 16 bit, the top bits are plenty for brightness and keep faint traffic visible
+    const auto intensity = [] (const std::uint16_t count) -> std::uint32_t
+    {
+        return count == 0 ? 0 : std::min <std::uint32_t> (255, 64 + count);
+    };
+
+    Heat_Map& heat = bus.heat();
+    for (std::size_t address = 0; address < Heat_Map::size; ++address)
+    {
+        const auto r = intensity(heat.get(Heat_Map::Kind::write, address));
+        const auto g = intensity(heat.get(Heat_Map::Kind::read, address));
+        const auto b = intensity(heat.get(Heat_Map::Kind::execute, address));
+        heat_pixels[address] = r | (g << 8) | (b << 16) | 0xFF000000;
+    }
+    if (counting)
+        heat.decay(decay_shift);
+
+    glBindTexture(GL_TEXTURE_2D, heat_texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, side, side, GL_RGBA, GL_UNSIGNED_BYTE, heat_pixels.data());
+
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImGui::Image((ImTextureID)(std::intptr_t)heat_texture, {side * scale, side * scale});
+
+    if (ImGui::IsItemHovered())
+    {
+        const ImVec2 mouse = ImGui::GetIO().MousePos;
+        const int x = std::clamp(static_cast <int> ((mouse.x - origin.x) / scale), 0, side - 1);
+        const int y = std::clamp(static_cast <int> ((mouse.y - origin.y) / scale), 0, side - 1);
+        const auto address = static_cast <std::uint16_t> (y * side + x);
+        ImGui::SetTooltip("$%04X\nread    %u\nwrite   %u\nexecute %u", address,
+                          heat.get(Heat_Map::Kind::read, address), heat.get(Heat_Map::Kind::write, address), heat.get(Heat_Map::Kind::execute, address));
+    }
+
+    ImGui::End();
+}
+
 void GUI::rom_select_box ()
 {
-    const std::string preview_value = !current_rom ? "" : current_rom->file_name;
+    const auto entries = catalog.entries();
+    const std::string preview_value = !current_rom ? (catalog.scanning() && entries->empty() ? "scanning..." : "") : current_rom->name;
     if (ImGui::BeginCombo("##", preview_value.c_str(), ImGuiComboFlags_PopupAlignLeft))
     {
-        for (auto& entry : roms)
+        for (const auto& entry : *entries)
         {
-            if (ImGui::Selectable(entry.file_name.c_str(), &entry == current_rom))
+            const bool selected = current_rom && current_rom->path == entry.path;
+            ImGui::PushID(entry.path.c_str());
+            if (ImGui::Selectable(entry.name.c_str(), selected))
+            {
+                current_rom = entry;
+            }
+
+            if (ImGui::IsItemHovered())
+            {
+                if (entry.duplicate_of.empty())
+                    ImGui::SetTooltip("%s\n%s, %ju bytes\n%016llX", entry.path.c_str(), format_name(entry.format), entry.size, static_cast <unsigned long long> (entry.hash));
+                else
+                    ImGui::SetTooltip("%s\n%s, %ju bytes\n%016llX\nsame contents as %s", entry.path.c_str(), format_name(entry.format), entry.size, static_cast <unsigned long long> (entry.hash), entry.duplicate_of.c_str());
+            }
+
+            if (!entry.duplicate_of.empty())
             {
-                current_rom = &entry;
+                ImGui::SameLine();
+                ImGui::TextDisabled("(duplicate)");
             }
 
-            if (&entry == current_rom)
+            if (selected)
                 ImGui::SetItemDefaultFocus();
+            ImGui::PopID();
         }
         ImGui::EndCombo();
     }
@@ -190,19 +624,41 @@ void GUI::action_bar ()
     ImGui::SameLine();
 
 
-    // TODO: probably make this thread safe
     if (ImGui::Button("Reset"))
     {
-        rom.reset();
-        ram.reset();
-        rom.load(current_rom->file_path, current_rom->file_size);
-        cpu.reset();
-        if (rom.is_loaded())
+        // keep what was worked out about the outgoing rom, breakpoints included
+        if (loaded_hash)
+            analysis_cache.save(*loaded_hash, disassembler, breakpoints);
+        loaded_hash.reset();
+
+        // the old image is unmapped while the bus still points into it, so the swap happens between
+        // instructions on the cpu thread and this thread waits for it rather than reading the bus meanwhile
+        bool reloaded = false;
+        post([this, &reloaded, rom_path = current_rom ? std::optional(current_rom->path) : std::nullopt] ()
         {
-
-            code = MOS_6502::disassemble(rom, 0x7000);  // TODO let user select offset
-            code_map = MOS_6502::code_mapper(code);
+            if (rom_path)
+                machine.load_rom(*rom_path);
+            else
+                machine.unload();
             traces = {};
+            {
+                std::lock_guard <std::mutex> lock (mu);
+                reloaded = true;
+            }
+            cv.notify_all();
+        });
+        {
+            std::unique_lock <std::mutex> lock (mu);
+            cv.wait(lock, [&reloaded] () {return reloaded;});
+        }
+
+        if (rom.is_loaded())
+        {
+            const auto peek = [this] (const auto address) {return bus.peek(address);};
+            const auto generation = [this] (const auto page) {return bus.generation(page);};
+            loaded_hash = current_rom->hash;
+            if (!analysis_cache.load(*loaded_hash, disassembler, breakpoints, peek, generation))
+                disassembler.start(peek);
         }
         else
             printf("ERROR\n");
@@ -213,6 +669,33 @@ void GUI::action_bar ()
         stack_page = Hex_Editor("Stack page", ram.size(), 0x0100, 256, sizeof(std::uint8_t), ram.data());
         zero_page  = Hex_Editor("Zero page",  ram.size(), 0x0, 256, sizeof(std::uint8_t), ram.data());
 
+        // edits go through the bus so the disassembler sees them, ram above $7FFF isn't mapped
+        // banked images don't line up with the address space, edit those in place
+        // either way they're applied between instructions on the cpu thread so a recording catches them
+        rom_data.on_write([this] (const std::size_t index, const std::uint8_t value)
+        {
+            if (bus.bank_count() == 1)
+                post([this, index, value] () {machine.poke(0x8000 + index, value);});
+            else
+                post([this, index, value] () {machine.patch_rom(index, value);});
+        });
+        const auto ram_write = [this] (const std::size_t index, const std::uint8_t value)
+        {
+            if (index < 0x8000)
+                post([this, index, value] () {machine.poke(index, value);});
+            else
+                ram.data()[index] = value;
+        };
+        ram_data.on_write(ram_write);
+        stack_page.on_write(ram_write);
+        zero_page.on_write(ram_write);
+
+        // only pages the bus reports as written get copied and redrawn
+        rom_data.track([this] (const std::size_t page) -> std::uint32_t {return bus.bank_count() == 1 ? bus.generation(0x80 + page) : 0;});
+        const auto ram_generation = [this] (const std::size_t page) -> std::uint32_t {return page < 0x80 ? bus.generation(page) : 0;};
+        ram_data.track(ram_generation);
+        stack_page.track(ram_generation);
+        zero_page.track(ram_generation);
     }
 
     ImGui::SameLine();
@@ -238,33 +721,141 @@ void GUI::action_bar ()
 
     cv.notify_all();
 
+    // stepping backwards undoes journaled instructions, the journal only fills while it's switched on
+    ImGui::SameLine();
+    if (ImGui::Checkbox("Journal", &journal_enabled))
+        post([this, enabled = journal_enabled] () {machine.set_journal(enabled ? journal_capacity : 0);});
+    ImGui::SameLine();
+    ImGui::BeginDisabled(!journal_enabled || !is_paused);
+    if (ImGui::Button("<"))
+        post([this] () {step_back(false);});
+    ImGui::SameLine();
+    if (ImGui::Button("<<"))
+        post([this] () {step_back(true);});
+    ImGui::EndDisabled();
+    if (journal_enabled)
+    {
+        ImGui::SameLine();
+        ImGui::Text("%zu back", machine.journal_depth());
+    }
+
+    // one slot per rom, taken on the cpu thread so the state is always between two instructions
+    ImGui::SameLine();
+    ImGui::BeginDisabled(!rom.is_loaded());
+    if (ImGui::Button("Save state"))
+    {
+        post([this] ()
+        {
+            const auto begin = std::chrono::steady_clock::now();
+            const Save_State state = machine.save();
+            const bool saved = state.write(rom_file(machine.rom_hash(), "state"));
+            state_time = saved ? std::chrono::duration <float, std::milli> (std::chrono::steady_clock::now() - begin).count() : -1;
+        });
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Load state"))
+    {
+        post([this] ()
+        {
+            const auto begin = std::chrono::steady_clock::now();
+            Save_State state;
+            const bool loaded = state.read(rom_file(machine.rom_hash(), "state")) && machine.load(state);
+            state_time = loaded ? std::chrono::duration <float, std::milli> (std::chrono::steady_clock::now() - begin).count() : -1;
+        });
+    }
+
+    // inputs from here on are logged against the state at the start, replay runs the whole thing back unthrottled
+    ImGui::SameLine();
+    if (ImGui::Checkbox("Record", &recording))
+    {
+        post([this, start = recording] ()
+        {
+            if (start)
+            {
+                input_log.begin(machine);
+                machine.record(&input_log);
+                return;
+            }
+            machine.record(nullptr);
+            input_log.finish(machine);
+            if (!input_log.empty())
+                input_log.write(rom_file(machine.rom_hash(), "inputs"));
+        });
+    }
+    ImGui::SameLine();
+    ImGui::BeginDisabled(recording);
+    if (ImGui::Button("Replay"))
+    {
+        post([this] ()
+        {
+            const auto begin = std::chrono::steady_clock::now();
+            Input_Log log;
+            const bool replayed = log.read(rom_file(machine.rom_hash(), "inputs")) && log.replay(machine);
+            state_time = replayed ? std::chrono::duration <float, std::milli> (std::chrono::steady_clock::now() - begin).count() : -1;
+            traces = {};
+        });
+    }
+    ImGui::EndDisabled();
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    if (state_time < 0)
+        ImGui::TextUnformatted("state failed");
+    else if (state_time > 0)
+        ImGui::Text("%.3f ms", state_time.load());
+
     ImGui::End();
 }
 
-GUI::GUI (MOS_6502::CPU& _cpu, Memory& _rom, Memory& _ram, MOS_6502::trace_type& _traces, MOS_6502::code_map_type& _code_map)
+GUI::GUI (Machine& _machine, Checkpoints& _checkpoints, Hash_Trace& _hashes, MOS_6502::trace_type& _traces, MOS_6502::Disassembler& _disassembler, Breakpoints& _breakpoints, Watchpoints& _watchpoints)
 : window {"6502 Emulator", 1920, 1080}
-, cpu {_cpu}
-, rom {_rom}
-, ram {_ram}
+, machine {_machine}
+, checkpoints {_checkpoints}
+, hashes {_hashes}
+, cpu {_machine.cpu}
+, bus {_machine.bus}
+, rom {_machine.rom}
+, ram {_machine.ram}
 , traces {_traces}
-, code_map {_code_map}
-, code {}
-, current_rom {nullptr}
-, roms {}
+, disassembler {_disassembler}
+, breakpoints {_breakpoints}
+, watchpoints {_watchpoints}
+, listing {_disassembler.listing()}
+, catalog {roms_path, catalog_index()}
+, current_rom {}
+, analysis_cache {Analysis_Cache::default_directory()}
+, loaded_hash {}
+, breakpoint_address {}
+, breakpoint_condition {}
+, breakpoint_error {}
+, watch_begin {}
+, watch_end {}
+, watch_kind {static_cast <int> (Watchpoints::Kind::write)}
+, search {}
+, search_region {0}
+, search_width {0}
+, search_value {0}
+, search_time {0}
+, search_pattern {}
+, pattern_hits {}
+, heat_texture {0}
+, heat_pixels (Heat_Map::size)
+, state_time {0}
+, scrub_position {0}
+, scrubbing {false}
+, seek_target {0}
+, seek_by_cycle {0}
+, seeking {false}
+, seek_failed {false}
+, journal_enabled {false}
+, input_log {}
+, recording {false}
+, hash_interval {0}
+, hash_mismatch {-3}
 {
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
 
-    for (const auto& entry : std::filesystem::recursive_directory_iterator(roms_path))
-    {
-        roms.emplace_back (
-                            entry.path().filename().string(), 
-                            entry.path().string(), 
-                            entry.file_size()
-                          );
-    }
- 
     register_callbacks =
     {
         [&](){return cpu.get_XR();},
@@ -284,6 +875,48 @@ GUI::GUI (MOS_6502::CPU& _cpu, Memory& _rom, Memory& _ram, MOS_6502::trace_type&
     };
 }
 
+void GUI::post (command_type command)
+{
+    {
+        std::lock_guard <std::mutex> lock (mu);
+        commands.push_back(std::move(command));
+    }
+    cv.notify_all();
+}
+
+void GUI::seek (const bool by_cycle, const std::uint64_t target)
+{
+    seeking = true;
+    post([this, by_cycle, target] ()
+    {
+        const bool found = by_cycle ? checkpoints.seek_cycle(machine, target) : checkpoints.seek_instruction(machine, target);
+        seek_failed = !found;
+        if (found)
+        {
+            // the trace is from the history that was left, and any watch hits on the way were replays
+            traces = {};
+            if (watchpoints.triggered())
+                watchpoints.acknowledge(cpu.old_PC);
+        }
+        seeking = false;
+    });
+}
+
+void GUI::step_back (const bool to_breakpoint)
+{
+    const Condition::peek_cb peek = [this] (const auto address) {return bus.peek(address);};
+    while (machine.step_back())
+    {
+        if (!traces.empty())
+            traces.pop_back();
+        // same test the cpu thread makes going forwards, so this stops where a run would have
+        if (!to_breakpoint || (breakpoints.test(Breakpoints::Kind::execute, cpu.get_PC()) && breakpoints.should_break(cpu.get_PC(), cpu, peek)))
+            break;
+    }
+    if (watchpoints.triggered())
+        watchpoints.acknowledge(cpu.old_PC);
+}
+
 void GUI::run ()
 {
     auto& io = ImGui::GetIO(); (void)io;
@@ -325,6 +958,10 @@ void GUI::run ()
         code_window();
         registers();
         trace_window();
+        breakpoints_window();
+        watchpoints_window();
+        search_window();
+        heatmap_window();
 
         // Rendering
         ImGui::Render();
@@ -335,6 +972,9 @@ void GUI::run ()
         SDL_GL_SwapWindow(window.get_window ());
     }
 
+    if (loaded_hash)
+        analysis_cache.save(*loaded_hash, disassembler, breakpoints);
+
     {
         std::lock_guard<std::mutex> lock (mu);
         is_paused = false;
@@ -1,5 +1,6 @@
 #include "hex_editor.h"
 #include "imgui.h"
+#include <algorithm>
 #include <cmath>
 #include <cstdint>
 #include <format>
@@ -37,6 +38,58 @@ Hex_Editor::Hex_Editor (const char* window_name, const std::size_t total_mem_siz
     this->sizes.row_width = 16;
     this->sizes.scroll_bar_width = 20.f;
     selected_value = 0;
+
+    shown.assign (view.begin(), view.end());
+    text.resize (view.size());
+    for (std::size_t i = 0; i < view.size(); ++i)
+        format (i);
+    changed_at.assign (view.size(), 0);
+    seen.assign (view.empty() ? 0 : (offset + view.size() - 1) / page_size - offset / page_size + 1, stale);
+    frame = highlight_frames;
+}
+
+void Hex_Editor::track (generation_cb callback)
+{
+    generation = std::move (callback);
+    seen.assign (seen.size(), stale);
+}
+
+void Hex_Editor::format (const std::size_t index)
+{
+    static constexpr char digits[] = "0123456789ABCDEF";
+    text[index] = {digits[shown[index] >> 4], digits[shown[index] & 0xF], '\0'};
+}
+
+void Hex_Editor::sync (void)
+{
+    ++frame;
+    const std::size_t first = offset / page_size;
+
+    for (std::size_t i = 0; i < seen.size(); ++i)
+    {
+        const std::size_t page = first + i;
+        const std::uint32_t current = generation ? generation(page) : frame;
+        if (current == seen[i])
+            continue;
+        seen[i] = current;
+
+        const std::size_t begin = std::max (page * page_size, offset) - offset;
+        const std::size_t end   = std::min ((page + 1) * page_size, offset + view.size()) - offset;
+        for (std::size_t index = begin; index < end; ++index)
+        {
+            const std::uint8_t value = view[index];
+            if (value == shown[index])
+                continue;
+            shown[index] = value;
+            changed_at[index] = frame;
+            format (index);
+        }
+    }
+}
+
+void Hex_Editor::on_write (write_cb callback)
+{
+    write = std::move (callback);
 }
 
 // this took a looooooong time of messing around with to figure out
@@ -84,6 +137,7 @@ void Hex_Editor::present (void)
     [[maybe_unused]] static float scrollY = 0.0f;
     
     calc();
+    sync();
 
     // ImGui::SetNextWindowSize({this->sizes.min_window_width, 0});
     ImGui::Begin(name.c_str(), nullptr, window_flags);
@@ -118,19 +172,26 @@ void Hex_Editor::present (void)
                     byte_pos_x += this->sizes.glyph_width;
 
                 ImGui::PushID(index);
-                auto value = this->view[index];
                 ImGui::SameLine(byte_pos_x);
                 ImGui::SetNextItemWidth(this->sizes.byte_text_width);
                 ImGui::PushStyleVar(ImGuiStyleVar_FramePadding, {0,0});
-                ImGui::PushStyleColor(ImGuiCol_FrameBg, ImVec4(0,0,0,0));
+
+                // recently changed bytes fade out over highlight_frames
+                const std::uint32_t age = frame - changed_at[index];
+                const float highlight = age < highlight_frames ? 0.6f * (1.f - static_cast <float> (age) / highlight_frames) : 0.f;
+                ImGui::PushStyleColor(ImGuiCol_FrameBg, ImVec4(0.9f, 0.6f, 0.f, highlight));
 
                 User_Data user_data{};
-                snprintf(user_data.buffer, sizeof(user_data.buffer), "%02X", value);
-                ImGui::PushStyleColor(ImGuiCol_Text, this->view[index] == 0x00 ? ImGui::GetStyleColorVec4(ImGuiCol_TextDisabled) : white);
+                std::copy(text[index].begin(), text[index].end(), user_data.buffer);
+                ImGui::PushStyleColor(ImGuiCol_Text, shown[index] == 0x00 ? ImGui::GetStyleColorVec4(ImGuiCol_TextDisabled) : white);
                 if(ImGui::InputText("##input", user_data.buffer, sizeof(user_data.buffer), input_text_flags, Hex_Editor::input_callback, &user_data))
                 {
                     auto value = std::strtol(user_data.buffer, NULL, 16);
-                    this->view[row * this->sizes.row_width + col] = value;
+                    if (write)
+                        write(offset + index, value);
+                    else
+                        this->view[index] = value;
+                    seen[(offset + index) / page_size - offset / page_size] = stale;
                 }
                 if(user_data.set)
                 {
@@ -148,7 +209,7 @@ void Hex_Editor::present (void)
             
             for (std::size_t i = 0; i < (std::size_t)this->sizes.row_width; i++)
             {
-                char value = this->view[row * this->sizes.row_width + i];
+                char value = shown[row * this->sizes.row_width + i];
                 if (value >= 32)
                     ImGui::Text ("%c", value);
                 else